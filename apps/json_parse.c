@@ -2,6 +2,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,6 +14,9 @@
 /* XXX for a regular program, these should be <json-c/foo.h>
  * but that's inconvenient when building in the json-c source tree.
  */
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+#include "json_alloc.h"
+#endif
 #include "json_object.h"
 #include "json_tokener.h"
 #include "json_util.h"
@@ -21,6 +25,9 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #endif
+#ifdef HAVE_CLOCK_GETTIME
+#include <time.h>
+#endif
 
 #ifndef JSON_NORETURN
 #if defined(_MSC_VER)
@@ -40,6 +47,9 @@ static int show_output = 1;
 static int strict_mode = 0;
 static int color = 0;
 static const char *fname = NULL;
+static int bench_iterations = 0;
+static int bench_serialize = 0;
+static int show_stats = 0;
 
 #ifndef HAVE_JSON_TOKENER_GET_PARSE_END
 #define json_tokener_get_parse_end(tok) ((tok)->char_offset)
@@ -49,6 +59,7 @@ JSON_NORETURN static void usage(const char *argv0, int exitval, const char *errm
 static void showmem(void);
 static int parseit(int fd, int (*callback)(struct json_object *));
 static int showobj(struct json_object *new_obj);
+static int benchit(int fd);
 
 static void showmem(void)
 {
@@ -153,6 +164,301 @@ static int showobj(struct json_object *new_obj)
 	return 0;
 }
 
+/*
+ * Benchmark mode, for -B
+ */
+
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+static struct
+{
+	size_t mallocs;
+	size_t reallocs;
+	size_t frees;
+} alloc_counts;
+
+static void *count_malloc(size_t size)
+{
+	alloc_counts.mallocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	alloc_counts.reallocs++;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *ptr)
+{
+	if (ptr != NULL)
+		alloc_counts.frees++;
+	free(ptr);
+}
+#endif
+
+#ifdef HAVE_CLOCK_GETTIME
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return (da > db) - (da < db);
+}
+
+/* Read all of fd, so that I/O isn't part of what's measured */
+static char *read_all(int fd, size_t *len)
+{
+	size_t size = 65536;
+	char *buf = malloc(size);
+	ssize_t ret;
+
+	*len = 0;
+	while (buf != NULL && (ret = read(fd, buf + *len, size - *len)) > 0)
+	{
+		*len += (size_t)ret;
+		if (*len == size)
+		{
+			char *newbuf = realloc(buf, size * 2);
+			if (newbuf == NULL)
+				free(buf);
+			buf = newbuf;
+			size *= 2;
+		}
+	}
+	if (buf == NULL)
+		fprintf(stderr, "unable to allocate memory for %s\n", fname);
+	else if (ret < 0)
+	{
+		fprintf(stderr, "error reading fd %d: %s\n", fd, strerror(errno));
+		free(buf);
+		buf = NULL;
+	}
+	return buf;
+}
+
+#ifdef HAVE_JSON_TOKENER_GET_STATS
+static void show_tokener_stats(const struct json_tokener_stats *stats)
+{
+	static const char *state_names[] = {
+	    "eatws",
+	    "start",
+	    "finish",
+	    "null",
+	    "comment_start",
+	    "comment",
+	    "comment_eol",
+	    "comment_end",
+	    "string",
+	    "string_escape",
+	    "escape_unicode",
+	    "escape_unicode_need_escape",
+	    "escape_unicode_need_u",
+	    "boolean",
+	    "number",
+	    "array",
+	    "array_add",
+	    "array_sep",
+	    "object_field_start",
+	    "object_field",
+	    "object_field_end",
+	    "object_value",
+	    "object_value_add",
+	    "object_sep",
+	    "array_after_sep",
+	    "object_field_start_after_sep",
+	    "inf",
+	};
+	int ii;
+
+	printf("tokener stats, for one pass:\n");
+	printf("  values:");
+	for (ii = json_type_null; ii <= json_type_string; ii++)
+		printf(" %s=%lu", json_type_to_name((enum json_type)ii),
+		       (unsigned long)stats->values[ii]);
+	printf("\n");
+	printf("  strings: clean=%lu escaped=%lu, keys=%lu, max_depth=%d\n",
+	       (unsigned long)stats->strings_clean, (unsigned long)stats->strings_escaped,
+	       (unsigned long)stats->keys, stats->max_depth);
+	printf("  printbuf_grows=%lu container_resizes=%lu allocs>=%lu\n",
+	       (unsigned long)stats->printbuf_grows, (unsigned long)stats->container_resizes,
+	       (unsigned long)stats->allocs);
+	for (ii = 0; ii < (int)(sizeof(state_names) / sizeof(state_names[0])); ii++)
+	{
+		if (stats->state_ns[ii] != 0)
+			printf("  state %s: %.3f ms\n", state_names[ii], stats->state_ns[ii] / 1e6);
+	}
+}
+#endif
+
+/*
+ * Parse the documents in fd bench_iterations times, from memory, and
+ * report the throughput, the latency of each document, allocations
+ * and, with -r, how long serializing them with the -F flags takes.
+ */
+static int benchit(int fd)
+{
+	size_t len, ndocs = 0, nlat = 0, serialized = 0;
+	double *lat = NULL, parse_ns = 0, serialize_ns = 0;
+	size_t mallocs = 0, reallocs = 0, frees = 0;
+	char *buf = read_all(fd, &len);
+	json_tokener *tok;
+	int iter, rc = 1;
+
+	if (buf == NULL)
+		return 1;
+	if (len > INT_MAX)
+	{
+		fprintf(stderr, "%s is too large to parse in one piece\n", fname);
+		free(buf);
+		return 1;
+	}
+	tok = json_tokener_new_ex(JSON_TOKENER_DEFAULT_DEPTH);
+	if (tok == NULL)
+	{
+		fprintf(stderr, "unable to allocate json_tokener: %s\n", strerror(errno));
+		goto out;
+	}
+	if (strict_mode)
+		json_tokener_set_flags(tok,
+		                       JSON_TOKENER_STRICT | JSON_TOKENER_ALLOW_TRAILING_CHARS);
+#ifdef HAVE_JSON_TOKENER_GET_STATS
+	if (show_stats && json_tokener_enable_stats(tok, 1) != 0)
+	{
+		fprintf(stderr, "unable to enable tokener stats: %s\n", strerror(errno));
+		goto out;
+	}
+#endif
+
+	for (iter = 0; iter < bench_iterations; iter++)
+	{
+		size_t start_pos = 0;
+
+		json_tokener_reset(tok);
+		while (start_pos < len)
+		{
+			struct json_object *obj;
+			enum json_tokener_error jerr;
+			size_t end;
+			double t0, t1;
+
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+			memset(&alloc_counts, 0, sizeof(alloc_counts));
+#endif
+			t0 = now_ns();
+			obj = json_tokener_parse_ex(tok, &buf[start_pos], (int)(len - start_pos));
+			t1 = now_ns();
+			jerr = json_tokener_get_error(tok);
+			end = start_pos + json_tokener_get_parse_end(tok);
+			if (jerr == json_tokener_continue)
+			{
+				size_t pos = start_pos;
+
+				while (pos < len && strchr(" \t\r\n", buf[pos]) != NULL)
+					pos++;
+				if (pos == len)
+					break; /* Only whitespace left */
+
+				/* A number, say, which only ends with the input */
+				obj = json_tokener_parse_ex(tok, "", 1);
+				t1 = now_ns();
+				jerr = json_tokener_get_error(tok);
+				end = len;
+				if (jerr == json_tokener_continue)
+					jerr = json_tokener_error_parse_eof;
+			}
+			if (obj == NULL)
+			{
+				fprintf(stderr, "Failed at offset %lu: %s\n", (unsigned long)end,
+				        json_tokener_error_desc(jerr));
+				goto out;
+			}
+			start_pos = end;
+			parse_ns += t1 - t0;
+			if (iter == 0)
+			{
+				ndocs++;
+				lat = realloc(lat, ndocs * bench_iterations * sizeof(*lat));
+				if (lat == NULL)
+				{
+					fprintf(stderr, "unable to allocate memory\n");
+					json_object_put(obj);
+					goto out;
+				}
+			}
+			lat[nlat++] = t1 - t0;
+
+			if (bench_serialize)
+			{
+				size_t slen;
+
+				t0 = now_ns();
+				json_object_to_json_string_length(obj, formatted_output | color,
+				                                  &slen);
+				serialize_ns += now_ns() - t0;
+				serialized += slen;
+			}
+			json_object_put(obj);
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+			mallocs += alloc_counts.mallocs;
+			reallocs += alloc_counts.reallocs;
+			frees += alloc_counts.frees;
+#endif
+		}
+#ifdef HAVE_JSON_TOKENER_GET_STATS
+		if (iter == 0 && show_stats)
+			show_tokener_stats(json_tokener_get_stats(tok));
+#endif
+	}
+
+	if (nlat == 0)
+	{
+		fprintf(stderr, "%s: no documents to parse\n", fname);
+		goto out;
+	}
+	qsort(lat, nlat, sizeof(*lat), cmp_double);
+	printf("%s: %lu bytes, %lu documents\n", fname, (unsigned long)len, (unsigned long)ndocs);
+	printf("parse: %d passes in %.3f s, %.1f MB/s, %.0f documents/s\n", bench_iterations,
+	       parse_ns / 1e9, (double)len * bench_iterations * 1e3 / parse_ns,
+	       nlat * 1e9 / parse_ns);
+	printf("parse latency (us): min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f\n", lat[0] / 1e3,
+	       lat[nlat / 2] / 1e3, lat[nlat * 9 / 10] / 1e3, lat[nlat * 99 / 100] / 1e3,
+	       lat[nlat - 1] / 1e3);
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+	/* From parsing to freeing, including serializing with -r */
+	printf("allocations per document: mallocs %.1f reallocs %.1f frees %.1f\n",
+	       (double)mallocs / nlat, (double)reallocs / nlat, (double)frees / nlat);
+#endif
+	if (bench_serialize)
+	{
+		printf("serialize: %lu bytes per pass, %.1f MB/s\n",
+		       (unsigned long)(serialized / bench_iterations),
+		       serialized * 1e3 / serialize_ns);
+	}
+	fflush(stdout);
+	showmem();
+	rc = 0;
+
+out:
+	json_tokener_free(tok);
+	free(lat);
+	free(buf);
+	return rc;
+}
+#else
+static int benchit(int fd)
+{
+	fprintf(stderr, "-B needs clock_gettime(), which isn't available\n");
+	return 1;
+}
+#endif
+
 static void usage(const char *argv0, int exitval, const char *errmsg)
 {
 	FILE *fp = stdout;
@@ -160,13 +466,17 @@ static void usage(const char *argv0, int exitval, const char *errmsg)
 		fp = stderr;
 	if (errmsg != NULL)
 		fprintf(fp, "ERROR: %s\n\n", errmsg);
-	fprintf(fp, "Usage: %s [-f|-F <arg>] [-n] [-s]\n", argv0);
+	fprintf(fp, "Usage: %s [-f|-F <arg>] [-n] [-s] [-B <count> [-r] [-S]]\n", argv0);
 	fprintf(fp, "  -f - Format the output to stdout with JSON_C_TO_STRING_PRETTY (default is JSON_C_TO_STRING_SPACED)\n");
 	fprintf(fp, "  -F - Format the output to stdout with <arg>, e.g. 0 for JSON_C_TO_STRING_PLAIN\n");
 	fprintf(fp, "  -n - No output\n");
 	fprintf(fp, "  -c - color\n");
 	fprintf(fp, "  -s - Parse in strict mode, flags:\n");
 	fprintf(fp, "       JSON_TOKENER_STRICT|JSON_TOKENER_ALLOW_TRAILING_CHARS\n");
+	fprintf(fp, "  -B - Benchmark: parse the file <count> times from memory, and report\n");
+	fprintf(fp, "       throughput, latency per document, allocations and maxrss\n");
+	fprintf(fp, "  -r - With -B, also serialize each document with the -f/-F/-c flags\n");
+	fprintf(fp, "  -S - With -B, also show the tokener's stats for one pass\n");
 	fprintf(fp, " Diagnostic information will be emitted to stderr\n");
 
 	fprintf(fp, "\nWARNING WARNING WARNING\n");
@@ -178,7 +488,7 @@ int main(int argc, char **argv)
 {
 	int opt;
 
-	while ((opt = getopt(argc, argv, "fF:hnsc")) != -1)
+	while ((opt = getopt(argc, argv, "B:fF:hnrsSc")) != -1)
 	{
 		switch (opt)
 		{
@@ -187,6 +497,9 @@ int main(int argc, char **argv)
 		case 'n': show_output = 0; break;
 		case 's': strict_mode = 1; break;
 		case 'c': color = JSON_C_TO_STRING_COLOR; break;
+		case 'B': bench_iterations = atoi(optarg); break;
+		case 'r': bench_serialize = 1; break;
+		case 'S': show_stats = 1; break;
 		case 'h': usage(argv[0], 0, NULL);
 		default: /* '?' */ usage(argv[0], EXIT_FAILURE, "Unknown arguments");
 		}
@@ -196,8 +509,22 @@ int main(int argc, char **argv)
 		usage(argv[0], EXIT_FAILURE, "Expected argument after options");
 	}
 	fname = argv[optind];
+	if (bench_iterations < 0 || ((bench_serialize || show_stats) && bench_iterations == 0))
+		usage(argv[0], EXIT_FAILURE, "-r and -S need -B with a positive count");
+#ifndef HAVE_JSON_TOKENER_GET_STATS
+	if (show_stats)
+		usage(argv[0], EXIT_FAILURE, "-S needs json_tokener_get_stats()");
+#endif
 
 	int fd = open(argv[optind], O_RDONLY, 0);
+	if (bench_iterations > 0)
+	{
+#ifdef HAVE_JSON_C_SET_ALLOC_FUNCS
+		/* Before json-c allocates anything */
+		json_c_set_alloc_funcs(count_malloc, count_realloc, count_free);
+#endif
+		exit(benchit(fd) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
 	showmem();
 	if (parseit(fd, showobj) != 0)
 		exit(EXIT_FAILURE);
@@ -0,0 +1,487 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apps_config.h"
+
+/* XXX for a regular program, these should be <json-c/foo.h>
+ * but that's inconvenient when building in the json-c source tree.
+ */
+#include "json_object.h"
+#include "json_object_iterator.h"
+#include "json_tokener.h"
+#include "json_util.h"
+#include "json_visit.h"
+
+#ifndef JSON_NORETURN
+#if defined(_MSC_VER)
+#define JSON_NORETURN __declspec(noreturn)
+#elif defined(__OS400__)
+#define JSON_NORETURN
+#else
+/* 'cold' attribute is for optimization, telling the computer this code
+ * path is unlikely.
+ */
+#define JSON_NORETURN __attribute__((noreturn, cold))
+#endif
+#endif
+
+/*
+ * The distribution of a size: its count, range and mean, and a histogram
+ * with power of two buckets, i.e. 0, 1, 2-3, 4-7, ...
+ */
+struct dist
+{
+	size_t count;
+	uint64_t sum, min, max;
+	size_t buckets[65];
+};
+
+/* Everything we learn about the documents */
+struct shape
+{
+	size_t documents;
+	size_t bytes;
+	struct dist depth;
+	struct dist object_members;
+	struct dist array_length;
+	struct dist key_length;
+	struct dist string_length;
+	size_t keys;
+	size_t untracked_keys;
+	struct json_object *key_counts; /* key => number of times seen */
+	size_t ints, int64s, uint64s, doubles;
+	size_t trues, falses, nulls;
+	struct json_object_memory_stats memory;
+	/* While visiting a document */
+	int cur_depth, doc_depth;
+};
+
+static int max_depth = 1000;
+static int max_keys = 100000;
+static int top_keys = 20;
+static int output_flags = JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE;
+
+JSON_NORETURN static void usage(const char *argv0, int exitval, const char *errmsg);
+
+static void dist_add(struct dist *d, uint64_t value)
+{
+	int bucket = 0;
+
+	while (bucket < 64 && (value >> bucket) != 0)
+		bucket++;
+	d->buckets[bucket]++;
+	if (d->count == 0 || value < d->min)
+		d->min = value;
+	if (value > d->max)
+		d->max = value;
+	d->sum += value;
+	d->count++;
+}
+
+static struct json_object *dist_to_json(const struct dist *d)
+{
+	struct json_object *obj = json_object_new_object();
+	struct json_object *hist = json_object_new_object();
+	char name[48];
+	int ii;
+
+	json_object_object_add(obj, "count", json_object_new_uint64(d->count));
+	json_object_object_add(obj, "min", json_object_new_uint64(d->min));
+	json_object_object_add(obj, "max", json_object_new_uint64(d->max));
+	json_object_object_add(obj, "mean",
+	                       json_object_new_double(d->count ? (double)d->sum / d->count : 0));
+	for (ii = 0; ii < 65; ii++)
+	{
+		if (d->buckets[ii] == 0)
+			continue;
+		if (ii <= 1)
+			snprintf(name, sizeof(name), "%d", ii);
+		else if (ii == 64)
+			snprintf(name, sizeof(name), "%llu-", 1ULL << 63);
+		else
+			snprintf(name, sizeof(name), "%llu-%llu", 1ULL << (ii - 1),
+			         (1ULL << ii) - 1);
+		json_object_object_add(hist, name, json_object_new_uint64(d->buckets[ii]));
+	}
+	json_object_object_add(obj, "histogram", hist);
+	return obj;
+}
+
+static void count_key(struct shape *sh, const char *key)
+{
+	struct json_object *count;
+
+	sh->keys++;
+	dist_add(&sh->key_length, strlen(key));
+	if (json_object_object_get_ex(sh->key_counts, key, &count))
+		json_object_int_inc(count, 1);
+	else if (json_object_object_length(sh->key_counts) < max_keys)
+		json_object_object_add(sh->key_counts, key, json_object_new_int64(1));
+	else
+		sh->untracked_keys++;
+}
+
+static void count_number(struct shape *sh, struct json_object *jso)
+{
+	int64_t i64 = json_object_get_int64(jso);
+
+	if (i64 == INT64_MAX && json_object_get_uint64(jso) > INT64_MAX)
+		sh->uint64s++;
+	else if (i64 >= INT32_MIN && i64 <= INT32_MAX)
+		sh->ints++;
+	else
+		sh->int64s++;
+}
+
+static int visit(struct json_object *jso, int flags, struct json_object *parent,
+                 const char *key, size_t *index, void *arg)
+{
+	struct shape *sh = (struct shape *)arg;
+
+	if (flags & JSON_C_VISIT_SECOND)
+	{
+		sh->cur_depth--;
+		return JSON_C_VISIT_RETURN_CONTINUE;
+	}
+	if (key != NULL)
+		count_key(sh, key);
+
+	switch (json_object_get_type(jso))
+	{
+	case json_type_null: sh->nulls++; break;
+	case json_type_boolean:
+		if (json_object_get_boolean(jso))
+			sh->trues++;
+		else
+			sh->falses++;
+		break;
+	case json_type_int: count_number(sh, jso); break;
+	case json_type_double: sh->doubles++; break;
+	case json_type_string: dist_add(&sh->string_length, json_object_get_string_len(jso)); break;
+	case json_type_object:
+		dist_add(&sh->object_members, json_object_object_length(jso));
+		break;
+	case json_type_array: dist_add(&sh->array_length, json_object_array_length(jso)); break;
+	}
+
+	/* Top level values are at depth 1, as in json_tokener_stats.max_depth */
+	if (++sh->cur_depth > sh->doc_depth)
+		sh->doc_depth = sh->cur_depth;
+	if (!json_object_is_type(jso, json_type_object) &&
+	    !json_object_is_type(jso, json_type_array))
+		sh->cur_depth--;
+	return JSON_C_VISIT_RETURN_CONTINUE;
+}
+
+static int add_document(struct shape *sh, struct json_object *doc)
+{
+	struct json_object_memory_stats mem;
+	size_t *total = (size_t *)&sh->memory, *add = (size_t *)&mem;
+	size_t ii;
+
+	sh->documents++;
+	sh->cur_depth = sh->doc_depth = 0;
+	if (json_c_visit(doc, 0, visit, sh) != 0)
+		return -1;
+	dist_add(&sh->depth, sh->doc_depth);
+
+	if (json_object_memory_usage(doc, &mem) != 0)
+		return -1;
+	/* Every member is a size_t */
+	for (ii = 0; ii < sizeof(mem) / sizeof(size_t); ii++)
+		total[ii] += add[ii];
+	return 0;
+}
+
+static int only_whitespace(const char *str, size_t len)
+{
+	while (len > 0 && strchr(" \t\r\n", *str) != NULL)
+		str++, len--;
+	return len == 0;
+}
+
+/* Parse every document in fd, which may be concatenated or one per line */
+static int read_documents(struct shape *sh, int fd, const char *fname,
+                          struct json_tokener_stats *strings)
+{
+	char buf[32768];
+	size_t total_read = 0;
+	ssize_t ret;
+	int pending = 0; /* Whether a document has been started but not finished */
+	struct json_tokener *tok = json_tokener_new_ex(max_depth);
+	const struct json_tokener_stats *stats;
+
+	if (tok == NULL || json_tokener_enable_stats(tok, 1) != 0)
+	{
+		fprintf(stderr, "unable to allocate json_tokener: %s\n", strerror(errno));
+		json_tokener_free(tok);
+		return -1;
+	}
+	while ((ret = read(fd, buf, sizeof(buf))) > 0)
+	{
+		size_t len = (size_t)ret, start_pos = 0;
+
+		total_read += len;
+		while (start_pos != len)
+		{
+			struct json_object *obj =
+			    json_tokener_parse_ex(tok, &buf[start_pos], len - start_pos);
+			enum json_tokener_error jerr = json_tokener_get_error(tok);
+
+			if (obj == NULL && jerr != json_tokener_continue)
+			{
+				fprintf(stderr, "%s: failed at offset %lu: %s\n", fname,
+				        (unsigned long)(total_read - len + start_pos +
+				                        json_tokener_get_parse_end(tok)),
+				        json_tokener_error_desc(jerr));
+				json_tokener_free(tok);
+				return -1;
+			}
+			if (obj == NULL &&
+			    !only_whitespace(&buf[start_pos], json_tokener_get_parse_end(tok)))
+				pending = 1;
+			if (obj != NULL)
+			{
+				int rc = add_document(sh, obj);
+
+				pending = 0;
+				json_object_put(obj);
+				if (rc != 0)
+				{
+					fprintf(stderr, "%s: out of memory\n", fname);
+					json_tokener_free(tok);
+					return -1;
+				}
+			}
+			start_pos += json_tokener_get_parse_end(tok);
+		}
+	}
+	if (ret == 0 && pending)
+	{
+		/* A NUL marks the end of the input, to finish e.g. a number at the very end */
+		struct json_object *obj = json_tokener_parse_ex(tok, "", 1);
+
+		if (obj != NULL)
+		{
+			pending = add_document(sh, obj) != 0;
+			json_object_put(obj);
+		}
+	}
+	if (ret < 0 || pending)
+	{
+		if (ret < 0)
+			fprintf(stderr, "error reading %s: %s\n", fname, strerror(errno));
+		else
+			fprintf(stderr, "%s: %s\n", fname,
+			        json_tokener_error_desc(json_tokener_error_parse_eof));
+		json_tokener_free(tok);
+		return -1;
+	}
+	sh->bytes += total_read;
+	stats = json_tokener_get_stats(tok);
+	strings->strings_clean += stats->strings_clean;
+	strings->strings_escaped += stats->strings_escaped;
+	json_tokener_free(tok);
+	return 0;
+}
+
+static int cmp_key_count(const void *a, const void *b)
+{
+	struct json_object *pa = *(struct json_object *const *)a;
+	struct json_object *pb = *(struct json_object *const *)b;
+	int64_t ca = json_object_get_int64(json_object_array_get_idx(pa, 1));
+	int64_t cb = json_object_get_int64(json_object_array_get_idx(pb, 1));
+
+	return (ca < cb) - (ca > cb);
+}
+
+static struct json_object *keys_to_json(struct shape *sh)
+{
+	struct json_object *obj = json_object_new_object();
+	struct json_object *pairs = json_object_new_array();
+	struct json_object *top = json_object_new_array();
+	struct json_object_iterator it = json_object_iter_begin(sh->key_counts);
+	struct json_object_iterator end = json_object_iter_end(sh->key_counts);
+	size_t distinct = json_object_object_length(sh->key_counts);
+	double repetition;
+	size_t ii;
+
+	for (; !json_object_iter_equal(&it, &end); json_object_iter_next(&it))
+	{
+		struct json_object *pair = json_object_new_array_ext(2);
+
+		json_object_array_add(pair,
+		                      json_object_new_string(json_object_iter_peek_name(&it)));
+		json_object_array_add(pair, json_object_get(json_object_iter_peek_value(&it)));
+		json_object_array_add(pairs, pair);
+	}
+	json_object_array_sort(pairs, cmp_key_count);
+	for (ii = 0; ii < json_object_array_length(pairs) && (int)ii < top_keys; ii++)
+	{
+		struct json_object *pair = json_object_array_get_idx(pairs, ii);
+		struct json_object *entry = json_object_new_object();
+
+		json_object_object_add(entry, "key",
+		                       json_object_get(json_object_array_get_idx(pair, 0)));
+		json_object_object_add(entry, "count",
+		                       json_object_get(json_object_array_get_idx(pair, 1)));
+		json_object_array_add(top, entry);
+	}
+	json_object_put(pairs);
+
+	json_object_object_add(obj, "total", json_object_new_uint64(sh->keys));
+	json_object_object_add(obj, "distinct", json_object_new_uint64(distinct));
+	json_object_object_add(obj, "untracked", json_object_new_uint64(sh->untracked_keys));
+	/* How many times each distinct key is used, on average */
+	repetition = distinct ? (double)(sh->keys - sh->untracked_keys) / distinct : 0;
+	json_object_object_add(obj, "mean_repetition", json_object_new_double(repetition));
+	json_object_object_add(obj, "length", dist_to_json(&sh->key_length));
+	json_object_object_add(obj, "top", top);
+	return obj;
+}
+
+static struct json_object *memory_to_json(const struct json_object_memory_stats *mem)
+{
+	struct json_object *obj = json_object_new_object();
+	struct json_object *nodes = json_object_new_object();
+	int ii;
+
+	for (ii = json_type_null; ii <= json_type_string; ii++)
+	{
+		struct json_object *node = json_object_new_object();
+
+		json_object_object_add(node, "count", json_object_new_uint64(mem->count[ii]));
+		json_object_object_add(node, "bytes", json_object_new_uint64(mem->node_bytes[ii]));
+		json_object_object_add(nodes, json_type_to_name((enum json_type)ii), node);
+	}
+	json_object_object_add(obj, "nodes", nodes);
+	json_object_object_add(obj, "table_bytes", json_object_new_uint64(mem->table_bytes));
+	json_object_object_add(obj, "table_unused_bytes",
+	                       json_object_new_uint64(mem->table_unused_bytes));
+	json_object_object_add(obj, "array_bytes", json_object_new_uint64(mem->array_bytes));
+	json_object_object_add(obj, "array_unused_bytes",
+	                       json_object_new_uint64(mem->array_unused_bytes));
+	json_object_object_add(obj, "key_bytes", json_object_new_uint64(mem->key_bytes));
+	json_object_object_add(obj, "string_bytes", json_object_new_uint64(mem->string_bytes));
+	json_object_object_add(obj, "total_bytes", json_object_new_uint64(mem->total_bytes));
+	json_object_object_add(obj, "compact_savings",
+	                       json_object_new_uint64(mem->compact_savings));
+	return obj;
+}
+
+static struct json_object *shape_to_json(struct shape *sh, const struct json_tokener_stats *strings)
+{
+	struct json_object *obj = json_object_new_object();
+	struct json_object *sub;
+
+	json_object_object_add(obj, "documents", json_object_new_uint64(sh->documents));
+	json_object_object_add(obj, "bytes", json_object_new_uint64(sh->bytes));
+	json_object_object_add(obj, "depth", dist_to_json(&sh->depth));
+	json_object_object_add(obj, "object_members", dist_to_json(&sh->object_members));
+	json_object_object_add(obj, "array_length", dist_to_json(&sh->array_length));
+	json_object_object_add(obj, "keys", keys_to_json(sh));
+
+	sub = json_object_new_object();
+	json_object_object_add(sub, "length", dist_to_json(&sh->string_length));
+	/* The tokener counts keys as strings too */
+	json_object_object_add(sub, "clean_including_keys",
+	                       json_object_new_uint64(strings->strings_clean));
+	json_object_object_add(sub, "escaped_including_keys",
+	                       json_object_new_uint64(strings->strings_escaped));
+	json_object_object_add(obj, "strings", sub);
+
+	sub = json_object_new_object();
+	json_object_object_add(sub, "int32", json_object_new_uint64(sh->ints));
+	json_object_object_add(sub, "int64", json_object_new_uint64(sh->int64s));
+	json_object_object_add(sub, "uint64", json_object_new_uint64(sh->uint64s));
+	json_object_object_add(sub, "double", json_object_new_uint64(sh->doubles));
+	json_object_object_add(obj, "numbers", sub);
+
+	sub = json_object_new_object();
+	json_object_object_add(sub, "true", json_object_new_uint64(sh->trues));
+	json_object_object_add(sub, "false", json_object_new_uint64(sh->falses));
+	json_object_object_add(sub, "null", json_object_new_uint64(sh->nulls));
+	json_object_object_add(obj, "literals", sub);
+
+	json_object_object_add(obj, "memory", memory_to_json(&sh->memory));
+	return obj;
+}
+
+static void usage(const char *argv0, int exitval, const char *errmsg)
+{
+	FILE *fp = stdout;
+	if (exitval != 0)
+		fp = stderr;
+	if (errmsg != NULL)
+		fprintf(fp, "ERROR: %s\n\n", errmsg);
+	fprintf(fp, "Usage: %s [-d <depth>] [-k <count>] [-t <count>] [-F <flags>] [<file> ...]\n",
+	        argv0);
+	fprintf(fp, "  Report the shape of the JSON documents in each <file>, or stdin,\n");
+	fprintf(fp, "  as JSON.  A file may hold several documents, e.g. one per line.\n");
+	fprintf(fp, "  -d - Maximum nesting depth to parse (default %d)\n", max_depth);
+	fprintf(fp, "  -k - Number of distinct keys to count (default %d)\n", max_keys);
+	fprintf(fp, "  -t - Number of most frequent keys to list (default %d)\n", top_keys);
+	fprintf(fp, "  -F - Format the output with <flags>, e.g. 0 for JSON_C_TO_STRING_PLAIN\n");
+
+	fprintf(fp, "\nWARNING WARNING WARNING\n");
+	fprintf(fp, "This is a prototype, it may change or be removed at any time!\n");
+	exit(exitval);
+}
+
+int main(int argc, char **argv)
+{
+	struct shape sh;
+	struct json_tokener_stats strings;
+	struct json_object *result;
+	int opt, rc = 0;
+
+	while ((opt = getopt(argc, argv, "d:F:hk:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': max_depth = atoi(optarg); break;
+		case 'F': output_flags = atoi(optarg); break;
+		case 'k': max_keys = atoi(optarg); break;
+		case 't': top_keys = atoi(optarg); break;
+		case 'h': usage(argv[0], 0, NULL);
+		default: /* '?' */ usage(argv[0], EXIT_FAILURE, "Unknown arguments");
+		}
+	}
+	if (max_depth < 1 || max_keys < 0 || top_keys < 0)
+		usage(argv[0], EXIT_FAILURE, "Invalid option value");
+
+	memset(&sh, 0, sizeof(sh));
+	memset(&strings, 0, sizeof(strings));
+	sh.key_counts = json_object_new_object();
+	if (optind >= argc)
+		rc = read_documents(&sh, STDIN_FILENO, "<stdin>", &strings);
+	for (; optind < argc && rc == 0; optind++)
+	{
+		int fd = open(argv[optind], O_RDONLY, 0);
+
+		if (fd < 0)
+		{
+			fprintf(stderr, "unable to open %s: %s\n", argv[optind], strerror(errno));
+			rc = -1;
+			break;
+		}
+		rc = read_documents(&sh, fd, argv[optind], &strings);
+		close(fd);
+	}
+
+	if (rc == 0)
+	{
+		result = shape_to_json(&sh, &strings);
+		printf("%s\n", json_object_to_json_string_ext(result, output_flags));
+		json_object_put(result);
+	}
+	json_object_put(sh.key_counts);
+	exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
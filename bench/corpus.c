@@ -0,0 +1,241 @@
+/*
+ * Deterministic generation of synthetic JSON documents for benchmarks.
+ *
+ * Only integer arithmetic is used to decide what to generate, and numbers
+ * are formatted from integers, so a given shape produces the same bytes
+ * everywhere.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "corpus.h"
+
+struct corpus_state
+{
+	const struct corpus_shape *shape;
+	struct printbuf *pb;
+	uint64_t rng;
+	int failed;
+};
+
+static const char *key_words[] = {"id",     "name",  "type",    "status", "created", "updated",
+                                  "value",  "count", "enabled", "tags",   "owner",   "email",
+                                  "region", "score", "version", "parent", "label",   "url"};
+#define NKEY_WORDS (sizeof(key_words) / sizeof(key_words[0]))
+
+static const char *escapes[] = {"\\n", "\\t", "\\\"", "\\\\", "\\/", "\\u00e9", "\\u4e16",
+                                "\\ud83d\\ude00"};
+#define NESCAPES (sizeof(escapes) / sizeof(escapes[0]))
+
+/* U+00E9, U+00DF, U+4E16, U+754C and U+1F600 */
+static const char *unicode_chars[] = {"\xc3\xa9", "\xc3\x9f", "\xe4\xb8\x96", "\xe7\x95\x8c",
+                                      "\xf0\x9f\x98\x80"};
+#define NUNICODE (sizeof(unicode_chars) / sizeof(unicode_chars[0]))
+
+static const char ascii_chars[] =
+    "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789";
+
+void corpus_shape_init(struct corpus_shape *shape)
+{
+	memset(shape, 0, sizeof(*shape));
+	shape->seed = 1;
+	shape->records = 1000;
+	shape->keys = 50;
+	shape->fields = 8;
+	shape->depth = 2;
+	shape->array_len = 4;
+	shape->string_len = 16;
+	shape->string_share = 0.5;
+	shape->escape_share = 0.02;
+	shape->unicode_share = 0.02;
+	shape->int_weight = 6;
+	shape->uint64_weight = 1;
+	shape->double_weight = 3;
+}
+
+/* splitmix64 */
+static uint64_t next(struct corpus_state *st)
+{
+	uint64_t z = (st->rng += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* A number in [0, n), n must be positive */
+static uint64_t below(struct corpus_state *st, uint64_t n)
+{
+	return next(st) % n;
+}
+
+/* Return whether an event with the given probability happens */
+static int chance(struct corpus_state *st, double p)
+{
+	/* Compare in fixed point, so rounding can't differ between platforms */
+	return below(st, 1000000) < (uint64_t)(p * 1000000);
+}
+
+static void append(struct corpus_state *st, const char *str, size_t len)
+{
+	if (printbuf_memappend(st->pb, str, (int)len) < 0)
+		st->failed = 1;
+}
+
+static void append_str(struct corpus_state *st, const char *str)
+{
+	append(st, str, strlen(str));
+}
+
+static void gen_key(struct corpus_state *st, int idx)
+{
+	char buf[32];
+
+	append(st, "\"", 1);
+	append_str(st, key_words[idx % NKEY_WORDS]);
+	if (idx >= (int)NKEY_WORDS)
+	{
+		snprintf(buf, sizeof(buf), "_%d", idx / (int)NKEY_WORDS);
+		append_str(st, buf);
+	}
+	append(st, "\":", 2);
+}
+
+static void gen_string(struct corpus_state *st)
+{
+	const struct corpus_shape *shape = st->shape;
+	int ii, len = 1 + (int)below(st, 2 * (uint64_t)shape->string_len);
+
+	append(st, "\"", 1);
+	for (ii = 0; ii < len; ii++)
+	{
+		if (chance(st, shape->escape_share))
+			append_str(st, escapes[below(st, NESCAPES)]);
+		else if (chance(st, shape->unicode_share))
+			append_str(st, unicode_chars[below(st, NUNICODE)]);
+		else
+			append(st, &ascii_chars[below(st, sizeof(ascii_chars) - 1)], 1);
+	}
+	append(st, "\"", 1);
+}
+
+static void gen_number(struct corpus_state *st)
+{
+	const struct corpus_shape *shape = st->shape;
+	uint64_t total = (uint64_t)shape->int_weight + shape->uint64_weight + shape->double_weight;
+	uint64_t pick = total > 0 ? below(st, total) : 0;
+	char buf[64];
+
+	if (pick < (uint64_t)shape->int_weight || total == 0)
+	{
+		/* Mostly small, sometimes up to the full int64 range */
+		static const uint64_t limits[] = {10, 1000, 100000, 10000000000ULL, 1ULL << 63};
+		uint64_t mag = below(st, limits[below(st, 5)]);
+
+		snprintf(buf, sizeof(buf), "%s%llu", (next(st) & 1) ? "-" : "",
+		         (unsigned long long)mag);
+	}
+	else if (pick < (uint64_t)shape->int_weight + shape->uint64_weight)
+	{
+		/* Values that only fit in a uint64_t */
+		snprintf(buf, sizeof(buf), "%llu", (unsigned long long)(next(st) | (1ULL << 63)));
+	}
+	else if (next(st) & 1)
+	{
+		unsigned long long whole = below(st, 100000);
+		unsigned long long frac = below(st, 1000000);
+
+		snprintf(buf, sizeof(buf), "%s%llu.%llu", (next(st) & 1) ? "-" : "", whole, frac);
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "%llu.%06llue%s%llu", (unsigned long long)below(st, 10),
+		         (unsigned long long)below(st, 1000000), (next(st) & 1) ? "-" : "",
+		         (unsigned long long)below(st, 300));
+	}
+	append_str(st, buf);
+}
+
+static void gen_leaf(struct corpus_state *st)
+{
+	if (chance(st, st->shape->string_share))
+		gen_string(st);
+	else if (below(st, 10) != 0)
+		gen_number(st);
+	else
+	{
+		static const char *literals[] = {"true", "false", "null"};
+		append_str(st, literals[below(st, 3)]);
+	}
+}
+
+/*
+ * Each container has at most one nested container, so the size of a record
+ * grows linearly with the depth.
+ */
+static void gen_container(struct corpus_state *st, int level, int is_object)
+{
+	const struct corpus_shape *shape = st->shape;
+	int ii;
+
+	if (is_object)
+	{
+		int fields = shape->fields < shape->keys ? shape->fields : shape->keys;
+		int first = (int)below(st, shape->keys);
+
+		append(st, "{", 1);
+		for (ii = 0; ii < fields; ii++)
+		{
+			if (ii > 0)
+				append(st, ",", 1);
+			/* Consecutive keys, so there are no duplicates */
+			gen_key(st, (first + ii) % shape->keys);
+			if (ii == 0 && level < shape->depth)
+				gen_container(st, level + 1, (int)below(st, 2));
+			else
+				gen_leaf(st);
+		}
+		append(st, "}", 1);
+	}
+	else
+	{
+		append(st, "[", 1);
+		for (ii = 0; ii < shape->array_len; ii++)
+		{
+			if (ii > 0)
+				append(st, ",", 1);
+			if (ii == 0 && level < shape->depth)
+				gen_container(st, level + 1, (int)below(st, 2));
+			else
+				gen_leaf(st);
+		}
+		append(st, "]", 1);
+	}
+}
+
+int corpus_generate(const struct corpus_shape *shape, struct printbuf *pb)
+{
+	struct corpus_state st;
+	int ii;
+
+	if (shape->keys < 1 || shape->string_len < 1)
+		return -1;
+	st.shape = shape;
+	st.pb = pb;
+	st.rng = shape->seed;
+	st.failed = 0;
+
+	if (!shape->ndjson)
+		append(&st, "[", 1);
+	for (ii = 0; ii < shape->records && !st.failed; ii++)
+	{
+		if (ii > 0 && !shape->ndjson)
+			append(&st, ",\n", 2);
+		gen_container(&st, 0, 1);
+		if (shape->ndjson)
+			append(&st, "\n", 1);
+	}
+	if (!shape->ndjson)
+		append(&st, "]\n", 2);
+	return st.failed ? -1 : 0;
+}
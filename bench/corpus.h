@@ -0,0 +1,44 @@
+/*
+ * Deterministic generation of synthetic JSON documents for benchmarks.
+ */
+#ifndef _jc_bench_corpus_h_
+#define _jc_bench_corpus_h_
+
+#include <stdint.h>
+
+#include "printbuf.h"
+
+/*
+ * The shape of a generated corpus.  Fill in with corpus_shape_init()
+ * and adjust as needed.
+ */
+struct corpus_shape
+{
+	uint64_t seed;
+	int records;       /* Number of top level records */
+	int keys;          /* Number of distinct key names to draw from */
+	int fields;        /* Members per object */
+	int depth;         /* Levels of nested containers within each record */
+	int array_len;     /* Elements of nested arrays */
+	int string_len;    /* Average length of string values, in characters */
+	double string_share;  /* Fraction of leaf values that are strings */
+	double escape_share;  /* Fraction of string characters that need escaping */
+	double unicode_share; /* Fraction of string characters outside of ASCII */
+	/* Relative weights of int, uint64 and double values among numbers */
+	int int_weight;
+	int uint64_weight;
+	int double_weight;
+	int ndjson; /* One record per line, instead of an array of records */
+};
+
+void corpus_shape_init(struct corpus_shape *shape);
+
+/*
+ * Append the corpus described by shape to pb.  The result depends only on
+ * shape, and is the same on every platform.
+ * Returns 0, or -1 if memory ran out or shape has no keys or strings
+ * shorter than 1 character on average.
+ */
+int corpus_generate(const struct corpus_shape *shape, struct printbuf *pb);
+
+#endif
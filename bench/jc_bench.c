@@ -0,0 +1,887 @@
+/*
+ * Microbenchmarks for json-c's hot paths.
+ *
+ * All inputs are generated from a fixed seed, so results are comparable
+ * between runs and between json-c revisions.  See README.bench.md.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* XXX for a regular program, these should be <json-c/foo.h>
+ * but that's inconvenient when building in the json-c source tree.
+ */
+#include "corpus.h"
+#include "json_alloc.h"
+#include "json_c_version.h"
+#include "json_object.h"
+#include "json_object_iterator.h"
+#include "json_tokener.h"
+#include "json_util.h"
+#ifndef JC_BENCH_NO_POINTER
+#include "json_pointer.h"
+#endif
+#ifndef JC_BENCH_NO_PATCH
+#include "json_patch.h"
+#endif
+
+#ifndef JSON_NORETURN
+#if defined(_MSC_VER)
+#define JSON_NORETURN __declspec(noreturn)
+#elif defined(__OS400__)
+#define JSON_NORETURN
+#else
+/* 'cold' attribute is for optimization, telling the computer this code
+ * path is unlikely.
+ */
+#define JSON_NORETURN __attribute__((noreturn, cold))
+#endif
+#endif
+
+#define BENCH_SEED 0x6a736f6e2d63ULL
+#define BENCH_MAX_ITERS 1000000000
+#define REPORT_FLAGS (JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE)
+
+/* The generated documents */
+enum bench_doc
+{
+	DOC_SMALL,
+	DOC_MEDIUM,
+	DOC_HUGE,
+	DOC_STRINGS,
+	DOC_NUMBERS,
+	DOC_DEEP,
+	DOC_INPUT, /* The file given with -i */
+	DOC_COUNT
+};
+
+struct bench_state
+{
+	const struct bench *b;
+	char *text;                 /* The document's text */
+	size_t len;                 /* strlen(text) */
+	struct json_object *doc;    /* The parsed document */
+	struct json_object *other;  /* A second input, e.g. a copy or a patch */
+	struct json_object **batch; /* Objects prepared for the timed loop */
+	const char **keys;          /* Keys or paths to look up */
+	size_t nkeys;
+	json_tokener *tok;
+	size_t bytes; /* Bytes processed per iteration, if meaningful */
+};
+
+struct bench
+{
+	const char *name;
+	enum bench_doc doc;
+	int arg; /* Benchmark specific, e.g. serializer flags */
+	int (*setup)(struct bench_state *st);
+	/* Prepare for a timed call of run(), outside of the timed region */
+	int (*prepare)(struct bench_state *st, size_t iters);
+	void (*run)(struct bench_state *st, size_t iters);
+};
+
+struct bench_result
+{
+	size_t iters;
+	double ns_min;
+	double ns_median;
+	double ns_mean;
+	/* With -a, the allocations per iteration */
+	double mallocs;
+	double reallocs;
+	double frees;
+	double alloc_bytes;
+};
+
+static double min_time = 0.5;
+static int repetitions = 5;
+static int count_allocs = 0;
+
+/* Consumed by benchmarks so the compiler can't drop their work */
+static volatile size_t bench_sink;
+
+JSON_NORETURN static void usage(const char *argv0, int exitval, const char *errmsg);
+
+/*
+ * Input generation
+ */
+
+#define DEEP_DEPTH 10000
+
+static char *gen_doc(enum bench_doc doc, size_t *len)
+{
+	struct corpus_shape shape;
+	struct printbuf *pb = printbuf_new();
+	char *text = NULL;
+
+	if (pb == NULL)
+		return NULL;
+	corpus_shape_init(&shape);
+	/* Each document is independent of which others were generated */
+	shape.seed = BENCH_SEED + doc;
+	switch (doc)
+	{
+	case DOC_SMALL: shape.records = 1; break;
+	case DOC_MEDIUM: shape.records = 250; break;
+	case DOC_HUGE: shape.records = 64000; break;
+	case DOC_STRINGS:
+		shape.records = 2000;
+		shape.string_share = 0.95;
+		shape.string_len = 40;
+		shape.escape_share = 0.1;
+		shape.unicode_share = 0.1;
+		break;
+	case DOC_NUMBERS:
+		shape.records = 4000;
+		shape.string_share = 0;
+		break;
+	case DOC_DEEP:
+		shape.records = 1;
+		/* Leave room for the record itself, and the array it's in */
+		shape.depth = DEEP_DEPTH - 3;
+		shape.fields = 2;
+		shape.array_len = 2;
+		break;
+	default: break;
+	}
+	if (corpus_generate(&shape, pb) == 0)
+	{
+		*len = printbuf_length(pb);
+		text = strdup(pb->buf);
+	}
+	printbuf_free(pb);
+	return text;
+}
+
+/*
+ * The benchmarks
+ */
+
+/* The deep document doesn't fit in the default depth */
+static json_tokener *new_tokener(enum bench_doc doc)
+{
+	if (doc == DOC_DEEP || doc == DOC_INPUT)
+		return json_tokener_new_ex(DEEP_DEPTH);
+	return json_tokener_new_ex(JSON_TOKENER_DEFAULT_DEPTH);
+}
+
+/*
+ * Parse each of the (e.g. newline separated) documents in text, adding them
+ * to into, or freeing them if into is NULL.
+ * Returns the number of documents, or -1 on error.
+ */
+static int parse_all(json_tokener *tok, const char *text, size_t len, struct json_object *into)
+{
+	int count = 0;
+
+	json_tokener_reset(tok);
+	while (len > 0)
+	{
+		struct json_object *obj = json_tokener_parse_ex(tok, text, (int)len);
+		size_t end = json_tokener_get_parse_end(tok);
+
+		if (obj == NULL)
+		{
+			size_t ii = 0;
+
+			if (json_tokener_get_error(tok) != json_tokener_continue)
+				return -1;
+			/* All of text was used up, so what's left is whitespace... */
+			while (ii < len && strchr(" \t\r\n", text[ii]) != NULL)
+				ii++;
+			if (ii == len)
+				break;
+			/* ...or a document, a number say, that only ends with the input */
+			if ((obj = json_tokener_parse_ex(tok, "", 1)) == NULL)
+				return -1;
+			end = len;
+		}
+		count++;
+		if (into != NULL)
+			json_object_array_add(into, obj);
+		else
+			json_object_put(obj);
+		text += end;
+		len -= end;
+	}
+	return count;
+}
+
+static int setup_text(struct bench_state *st)
+{
+	st->tok = new_tokener(st->b->doc);
+	st->bytes = st->len;
+	/* Make sure that what's being timed isn't a parse error */
+	if (st->tok == NULL || parse_all(st->tok, st->text, st->len, NULL) < 1)
+		return -1;
+	return 0;
+}
+
+/* Parse the input into st->doc, as an array if there are several documents */
+static int setup_doc(struct bench_state *st)
+{
+	json_tokener *tok = new_tokener(st->b->doc);
+	struct json_object *docs = json_object_new_array();
+	int count = -1;
+
+	if (tok != NULL && docs != NULL)
+		count = parse_all(tok, st->text, st->len, docs);
+	if (count == 1)
+	{
+		st->doc = json_object_get(json_object_array_get_idx(docs, 0));
+		json_object_put(docs);
+	}
+	else
+		st->doc = docs;
+	if (tok != NULL)
+		json_tokener_free(tok);
+	return count < 1 ? -1 : 0;
+}
+
+static void run_parse(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	/* This includes freeing the result, see free/ for how long that takes */
+	for (ii = 0; ii < iters; ii++)
+		bench_sink += (size_t)parse_all(st->tok, st->text, st->len, NULL);
+}
+
+static int setup_serialize(struct bench_state *st)
+{
+	if (setup_doc(st) != 0)
+		return -1;
+	st->bytes = strlen(json_object_to_json_string_ext(st->doc, st->b->arg));
+	return 0;
+}
+
+static void run_serialize(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+		bench_sink += (size_t)json_object_to_json_string_ext(st->doc, st->b->arg)[0];
+}
+
+#define LOOKUP_KEYS 1000
+
+static int setup_lookup(struct bench_state *st)
+{
+	static char keybuf[LOOKUP_KEYS][16];
+	static const char *keys[LOOKUP_KEYS];
+	size_t ii;
+
+	/* arg selects keys that are present (1) or missing (0) */
+	st->doc = json_object_new_object();
+	for (ii = 0; ii < LOOKUP_KEYS; ii++)
+	{
+		snprintf(keybuf[ii], sizeof(keybuf[ii]), "key%u", (unsigned int)ii);
+		json_object_object_add(st->doc, keybuf[ii], json_object_new_int((int)ii));
+		if (!st->b->arg)
+			keybuf[ii][0] = 'K';
+		keys[ii] = keybuf[ii];
+	}
+	st->keys = keys;
+	st->nkeys = LOOKUP_KEYS;
+	return 0;
+}
+
+static void run_lookup(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+	{
+		struct json_object *val;
+
+		bench_sink += json_object_object_get_ex(st->doc, st->keys[ii % st->nkeys], &val);
+	}
+}
+
+#ifndef JC_BENCH_NO_POINTER
+#define POINTER_PATHS 5
+
+static int setup_pointer(struct bench_state *st)
+{
+	static const int records[POINTER_PATHS - 1] = {0, 17, 120, 249};
+	static char pathbuf[POINTER_PATHS][128];
+	static const char *paths[POINTER_PATHS];
+	struct json_object *val;
+	int ii, level;
+
+	if (setup_doc(st) != 0)
+		return -1;
+	/* Descend a few levels into some of the records, through their first entries */
+	for (ii = 0; ii < POINTER_PATHS - 1; ii++)
+	{
+		size_t len = snprintf(pathbuf[ii], sizeof(pathbuf[ii]), "/%d", records[ii]);
+
+		val = json_object_array_get_idx(st->doc, records[ii]);
+		for (level = 0; level < 3 && len < sizeof(pathbuf[ii]); level++)
+		{
+			if (json_object_is_type(val, json_type_object))
+			{
+				struct json_object_iterator it = json_object_iter_begin(val);
+
+				len += snprintf(pathbuf[ii] + len, sizeof(pathbuf[ii]) - len, "/%s",
+				                json_object_iter_peek_name(&it));
+				val = json_object_iter_peek_value(&it);
+			}
+			else if (json_object_is_type(val, json_type_array))
+			{
+				len += snprintf(pathbuf[ii] + len, sizeof(pathbuf[ii]) - len, "/0");
+				val = json_object_array_get_idx(val, 0);
+			}
+		}
+		if (json_pointer_get(st->doc, pathbuf[ii], &val) != 0)
+			return -1;
+		paths[ii] = pathbuf[ii];
+	}
+	paths[ii] = "/100/missing";
+
+	st->keys = paths;
+	st->nkeys = POINTER_PATHS;
+	return 0;
+}
+
+static void run_pointer(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+	{
+		struct json_object *val;
+
+		bench_sink += (size_t)json_pointer_get(st->doc, st->keys[ii % st->nkeys], &val);
+	}
+}
+#endif
+
+static void run_deep_copy(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+	{
+		struct json_object *copy = NULL;
+
+		bench_sink += (size_t)json_object_deep_copy(st->doc, &copy, NULL);
+		json_object_put(copy);
+	}
+}
+
+static int setup_equal(struct bench_state *st)
+{
+	if (setup_doc(st) != 0 || json_object_deep_copy(st->doc, &st->other, NULL) != 0)
+		return -1;
+	return 0;
+}
+
+static void run_equal(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+		bench_sink += (size_t)json_object_equal(st->doc, st->other);
+}
+
+#ifndef JC_BENCH_NO_PATCH
+static int setup_patch(struct bench_state *st)
+{
+	struct json_object *res = NULL, *expected = NULL;
+	int rc;
+
+	/* Only refer to array indexes, which exist whatever the generated records hold */
+	st->other = json_tokener_parse(
+	    "[ { \"op\": \"replace\", \"path\": \"/1\", \"value\": { \"replaced\": true } },"
+	    "  { \"op\": \"add\", \"path\": \"/2/added\", \"value\": \"new\" },"
+	    "  { \"op\": \"remove\", \"path\": \"/3\" },"
+	    "  { \"op\": \"move\", \"from\": \"/4\", \"path\": \"/0\" },"
+	    "  { \"op\": \"copy\", \"from\": \"/5\", \"path\": \"/-\" },"
+	    "  { \"op\": \"add\", \"path\": \"/6/extra\", \"value\": { \"a\": [1, 2, 3] } },"
+	    "  { \"op\": \"test\", \"path\": \"/1\" } ]");
+	if (st->other == NULL || setup_doc(st) != 0)
+		return -1;
+	/* The test operation checks that the first record moved */
+	if (json_object_deep_copy(json_object_array_get_idx(st->doc, 0), &expected, NULL) != 0)
+		return -1;
+	json_object_object_add(json_object_array_get_idx(st->other, 6), "value", expected);
+
+	/* Make sure that what's being timed isn't a failure */
+	rc = json_patch_apply(st->doc, st->other, &res, NULL);
+	json_object_put(res);
+	return rc;
+}
+
+static void run_patch(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	/* This includes copying the document, which json_patch_apply() always does */
+	for (ii = 0; ii < iters; ii++)
+	{
+		struct json_object *res = NULL;
+
+		bench_sink += (size_t)json_patch_apply(st->doc, st->other, &res, NULL);
+		json_object_put(res);
+	}
+}
+#endif
+
+static int prepare_free(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	free(st->batch);
+	st->batch = calloc(iters, sizeof(st->batch[0]));
+	if (st->batch == NULL)
+		return -1;
+	for (ii = 0; ii < iters; ii++)
+	{
+		if (json_object_deep_copy(st->doc, &st->batch[ii], NULL) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static void run_free(struct bench_state *st, size_t iters)
+{
+	size_t ii;
+
+	for (ii = 0; ii < iters; ii++)
+		bench_sink += (size_t)json_object_put(st->batch[ii]);
+}
+
+#define PARSE(name, doc) {"parse/" name, doc, 0, setup_text, NULL, run_parse}
+#define SERIALIZE(name, flags) \
+	{"serialize/" name, DOC_MEDIUM, flags, setup_serialize, NULL, run_serialize}
+
+static const struct bench benchmarks[] = {
+    PARSE("small", DOC_SMALL),
+    PARSE("medium", DOC_MEDIUM),
+    PARSE("huge", DOC_HUGE),
+    PARSE("strings", DOC_STRINGS),
+    PARSE("numbers", DOC_NUMBERS),
+    PARSE("deep", DOC_DEEP),
+    SERIALIZE("plain", JSON_C_TO_STRING_PLAIN),
+    SERIALIZE("spaced", JSON_C_TO_STRING_SPACED),
+    SERIALIZE("pretty", JSON_C_TO_STRING_PRETTY),
+    SERIALIZE("pretty_tab", JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB),
+    SERIALIZE("noslashescape", JSON_C_TO_STRING_NOSLASHESCAPE),
+    SERIALIZE("nozero", JSON_C_TO_STRING_NOZERO),
+    SERIALIZE("color", JSON_C_TO_STRING_COLOR),
+    {"serialize/strings", DOC_STRINGS, JSON_C_TO_STRING_PLAIN, setup_serialize, NULL,
+     run_serialize},
+    {"serialize/numbers", DOC_NUMBERS, JSON_C_TO_STRING_PLAIN, setup_serialize, NULL,
+     run_serialize},
+    {"object_get_ex/hit", DOC_SMALL, 1, setup_lookup, NULL, run_lookup},
+    {"object_get_ex/miss", DOC_SMALL, 0, setup_lookup, NULL, run_lookup},
+#ifndef JC_BENCH_NO_POINTER
+    {"pointer/get", DOC_MEDIUM, 0, setup_pointer, NULL, run_pointer},
+#endif
+    {"deep_copy/medium", DOC_MEDIUM, 0, setup_doc, NULL, run_deep_copy},
+    {"equal/medium", DOC_MEDIUM, 0, setup_equal, NULL, run_equal},
+#ifndef JC_BENCH_NO_PATCH
+    {"patch/apply", DOC_MEDIUM, 0, setup_patch, NULL, run_patch},
+#endif
+    {"free/medium", DOC_MEDIUM, 0, setup_doc, prepare_free, run_free},
+    {"free/deep", DOC_DEEP, 0, setup_doc, prepare_free, run_free},
+    /* Only run with -i */
+    PARSE("input", DOC_INPUT),
+    {"serialize/input", DOC_INPUT, JSON_C_TO_STRING_PLAIN, setup_serialize, NULL, run_serialize},
+    {"free/input", DOC_INPUT, 0, setup_doc, prepare_free, run_free},
+};
+
+#define NBENCHMARKS (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/*
+ * The harness
+ */
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Time one call of b->run() with iters iterations, in nanoseconds */
+static double time_run(struct bench_state *st, size_t iters)
+{
+	double start;
+
+	if (st->b->prepare != NULL && st->b->prepare(st, iters) != 0)
+		return -1;
+	start = now_ns();
+	st->b->run(st, iters);
+	return now_ns() - start;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return da < db ? -1 : da > db;
+}
+
+static int run_benchmark(struct bench_state *st, struct bench_result *res)
+{
+	double sample_ns = min_time * 1e9 / repetitions;
+	double *samples;
+	double elapsed;
+	size_t iters = 1;
+	int ii;
+
+	/* Find an iteration count that takes at least sample_ns */
+	for (;;)
+	{
+		if ((elapsed = time_run(st, iters)) < 0)
+			return -1;
+		if (elapsed >= sample_ns || iters >= BENCH_MAX_ITERS)
+			break;
+		if (elapsed < sample_ns / 100)
+			iters *= 10;
+		else
+			iters = (size_t)(iters * sample_ns * 1.2 / elapsed) + 1;
+	}
+
+	samples = malloc(repetitions * sizeof(samples[0]));
+	if (samples == NULL)
+		return -1;
+	res->iters = iters;
+	res->ns_mean = 0;
+	for (ii = 0; ii < repetitions; ii++)
+	{
+		if ((elapsed = time_run(st, iters)) < 0)
+		{
+			free(samples);
+			return -1;
+		}
+		samples[ii] = elapsed / iters;
+		res->ns_mean += samples[ii] / repetitions;
+	}
+	qsort(samples, repetitions, sizeof(samples[0]), cmp_double);
+	res->ns_min = samples[0];
+	res->ns_median = (samples[(repetitions - 1) / 2] + samples[repetitions / 2]) / 2;
+	free(samples);
+	return 0;
+}
+
+/*
+ * Allocation counting, for -a
+ *
+ * The size of each block is kept in front of it, so that reallocs can be
+ * accounted for.
+ */
+
+#define ALLOC_HEADER 16
+
+static struct
+{
+	size_t mallocs;
+	size_t reallocs;
+	size_t frees;
+	size_t bytes; /* Requested by malloc, and by realloc beyond the old size */
+} alloc_counts;
+
+static void *count_malloc(size_t size)
+{
+	char *p = malloc(size + ALLOC_HEADER);
+
+	if (p == NULL)
+		return NULL;
+	alloc_counts.mallocs++;
+	alloc_counts.bytes += size;
+	memcpy(p, &size, sizeof(size));
+	return p + ALLOC_HEADER;
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	char *p;
+	size_t old;
+
+	if (ptr == NULL)
+		return count_malloc(size);
+	p = (char *)ptr - ALLOC_HEADER;
+	memcpy(&old, p, sizeof(old));
+	if ((p = realloc(p, size + ALLOC_HEADER)) == NULL)
+		return NULL;
+	alloc_counts.reallocs++;
+	if (size > old)
+		alloc_counts.bytes += size - old;
+	memcpy(p, &size, sizeof(size));
+	return p + ALLOC_HEADER;
+}
+
+static void count_free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	alloc_counts.frees++;
+	free((char *)ptr - ALLOC_HEADER);
+}
+
+/* Count the allocations made by repetitions iterations of b->run() */
+static int count_benchmark(struct bench_state *st, struct bench_result *res)
+{
+	size_t iters = repetitions;
+
+	/* Let anything that's cached between runs be set up first */
+	if (time_run(st, 1) < 0)
+		return -1;
+	if (st->b->prepare != NULL && st->b->prepare(st, iters) != 0)
+		return -1;
+	memset(&alloc_counts, 0, sizeof(alloc_counts));
+	st->b->run(st, iters);
+
+	res->iters = iters;
+	res->mallocs = (double)alloc_counts.mallocs / iters;
+	res->reallocs = (double)alloc_counts.reallocs / iters;
+	res->frees = (double)alloc_counts.frees / iters;
+	res->alloc_bytes = (double)alloc_counts.bytes / iters;
+	return 0;
+}
+
+/* Whether name matches any of the comma separated substrings in filter */
+static int matches(const char *name, const char *filter)
+{
+	char buf[256];
+	char *tok, *save;
+
+	if (filter == NULL)
+		return 1;
+	snprintf(buf, sizeof(buf), "%s", filter);
+	for (tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save))
+	{
+		if (strstr(name, tok) != NULL)
+			return 1;
+	}
+	return 0;
+}
+
+static struct json_object *result_to_json(const struct bench_state *st,
+                                          const struct bench_result *res)
+{
+	struct json_object *obj = json_object_new_object();
+
+	json_object_object_add(obj, "name", json_object_new_string(st->b->name));
+	json_object_object_add(obj, "iterations", json_object_new_uint64(res->iters));
+	if (count_allocs)
+	{
+		json_object_object_add(obj, "mallocs_per_op", json_object_new_double(res->mallocs));
+		json_object_object_add(obj, "reallocs_per_op",
+		                       json_object_new_double(res->reallocs));
+		json_object_object_add(obj, "frees_per_op", json_object_new_double(res->frees));
+		json_object_object_add(obj, "alloc_bytes_per_op",
+		                       json_object_new_double(res->alloc_bytes));
+		return obj;
+	}
+	json_object_object_add(obj, "repetitions", json_object_new_int(repetitions));
+	json_object_object_add(obj, "ns_per_op_min", json_object_new_double(res->ns_min));
+	json_object_object_add(obj, "ns_per_op_median", json_object_new_double(res->ns_median));
+	json_object_object_add(obj, "ns_per_op_mean", json_object_new_double(res->ns_mean));
+	if (st->bytes > 0)
+	{
+		json_object_object_add(obj, "bytes_per_op", json_object_new_uint64(st->bytes));
+		json_object_object_add(obj, "mb_per_sec",
+		                       json_object_new_double(st->bytes * 1e3 / res->ns_median));
+	}
+	return obj;
+}
+
+static char *read_file(const char *fname, size_t *len)
+{
+	FILE *fp = fopen(fname, "rb");
+	struct printbuf *pb = printbuf_new();
+	char buf[65536];
+	char *text = NULL;
+	size_t ret;
+
+	if (fp != NULL && pb != NULL)
+	{
+		while ((ret = fread(buf, 1, sizeof(buf), fp)) > 0)
+		{
+			if (printbuf_memappend(pb, buf, (int)ret) < 0)
+				break;
+		}
+		if (!ferror(fp) && feof(fp))
+		{
+			*len = printbuf_length(pb);
+			text = strdup(pb->buf);
+		}
+	}
+	if (fp != NULL)
+		fclose(fp);
+	printbuf_free(pb);
+	return text;
+}
+
+static void free_state(struct bench_state *st)
+{
+	json_object_put(st->doc);
+	json_object_put(st->other);
+	free(st->batch);
+	if (st->tok != NULL)
+		json_tokener_free(st->tok);
+	memset(st, 0, sizeof(*st));
+}
+
+static void usage(const char *argv0, int exitval, const char *errmsg)
+{
+	FILE *fp = stdout;
+	if (exitval != 0)
+		fp = stderr;
+	if (errmsg != NULL)
+		fprintf(fp, "ERROR: %s\n\n", errmsg);
+	fprintf(fp, "Usage: %s [-l] [-a] [-f <filter>] [-t <seconds>] [-r <count>]\n", argv0);
+	fprintf(fp, "          [-i <file>] [-o <file>]\n");
+	fprintf(fp, "  -l - List the benchmarks and exit\n");
+	fprintf(fp, "  -a - Count the allocations per iteration, over -r iterations,\n");
+	fprintf(fp, "       instead of timing\n");
+	fprintf(fp, "  -f - Only run benchmarks whose name contains one of the comma\n");
+	fprintf(fp, "       separated strings in <filter>, e.g. parse/,free/deep\n");
+	fprintf(fp, "  -t - Time to spend measuring each benchmark (default %g)\n", min_time);
+	fprintf(fp, "  -r - Number of samples to take of each benchmark (default %d)\n",
+	        repetitions);
+	fprintf(fp, "  -i - Also benchmark parsing, serializing and freeing <file>, which\n");
+	fprintf(fp, "       may hold several documents, e.g. one per line (see jc_corpus)\n");
+	fprintf(fp, "  -o - Also write the results as JSON to <file>, or - for stdout\n");
+	exit(exitval);
+}
+
+int main(int argc, char **argv)
+{
+	char *docs[DOC_COUNT] = {NULL};
+	size_t doc_lens[DOC_COUNT];
+	const char *filter = NULL, *output = NULL, *input = NULL;
+	struct json_object *results, *context, *report;
+	size_t ii;
+	int opt, list = 0, failed = 0;
+
+	while ((opt = getopt(argc, argv, "af:hi:lo:r:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a': count_allocs = 1; break;
+		case 'f': filter = optarg; break;
+		case 'i': input = optarg; break;
+		case 'l': list = 1; break;
+		case 'o': output = optarg; break;
+		case 'r': repetitions = atoi(optarg); break;
+		case 't': min_time = atof(optarg); break;
+		case 'h': usage(argv[0], 0, NULL);
+		default: /* '?' */ usage(argv[0], EXIT_FAILURE, "Unknown arguments");
+		}
+	}
+	if (optind < argc)
+		usage(argv[0], EXIT_FAILURE, "Unexpected arguments");
+	if (repetitions < 1 || !(min_time > 0))
+		usage(argv[0], EXIT_FAILURE, "-r and -t must be positive");
+
+	/* This must come before json-c allocates anything */
+	if (count_allocs && json_c_set_alloc_funcs(count_malloc, count_realloc, count_free) != 0)
+	{
+		fprintf(stderr, "unable to set the allocator: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (list)
+	{
+		for (ii = 0; ii < NBENCHMARKS; ii++)
+			printf("%s\n", benchmarks[ii].name);
+		return 0;
+	}
+
+	results = json_object_new_array();
+	if ((output == NULL || strcmp(output, "-") != 0) && count_allocs)
+		printf("%-24s %12s %12s %12s %14s\n", "benchmark", "mallocs/op", "reallocs/op",
+		       "frees/op", "bytes/op");
+	else if (output == NULL || strcmp(output, "-") != 0)
+		printf("%-24s %12s %14s %14s %10s\n", "benchmark", "iterations", "ns/op (min)",
+		       "ns/op (median)", "MB/s");
+	for (ii = 0; ii < NBENCHMARKS; ii++)
+	{
+		struct bench_state st;
+		struct bench_result res = {0};
+		enum bench_doc doc = benchmarks[ii].doc;
+
+		if (!matches(benchmarks[ii].name, filter) || (doc == DOC_INPUT && input == NULL))
+			continue;
+		if (docs[doc] == NULL && doc == DOC_INPUT)
+		{
+			if ((docs[doc] = read_file(input, &doc_lens[doc])) == NULL)
+			{
+				fprintf(stderr, "unable to read %s: %s\n", input, strerror(errno));
+				return EXIT_FAILURE;
+			}
+		}
+		else if (docs[doc] == NULL && (docs[doc] = gen_doc(doc, &doc_lens[doc])) == NULL)
+		{
+			fprintf(stderr, "unable to generate input: %s\n", strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		memset(&st, 0, sizeof(st));
+		st.b = &benchmarks[ii];
+		st.text = docs[doc];
+		st.len = doc_lens[doc];
+		if (st.b->setup(&st) != 0 ||
+		    (count_allocs ? count_benchmark(&st, &res) : run_benchmark(&st, &res)) != 0)
+		{
+			fprintf(stderr, "%s: failed\n", st.b->name);
+			failed = 1;
+			free_state(&st);
+			continue;
+		}
+		if ((output == NULL || strcmp(output, "-") != 0) && count_allocs)
+		{
+			printf("%-24s %12.1f %12.1f %12.1f %14.1f\n", st.b->name, res.mallocs,
+			       res.reallocs, res.frees, res.alloc_bytes);
+		}
+		else if (output == NULL || strcmp(output, "-") != 0)
+		{
+			printf("%-24s %12lu %14.1f %14.1f", st.b->name, (unsigned long)res.iters,
+			       res.ns_min, res.ns_median);
+			if (st.bytes > 0)
+				printf(" %10.1f", st.bytes * 1e3 / res.ns_median);
+			printf("\n");
+			fflush(stdout);
+		}
+		json_object_array_add(results, result_to_json(&st, &res));
+		free_state(&st);
+	}
+
+	if (output != NULL)
+	{
+		context = json_object_new_object();
+		json_object_object_add(context, "json_c_version",
+		                       json_object_new_string(json_c_version()));
+		json_object_object_add(context, "seed", json_object_new_uint64(BENCH_SEED));
+		if (input != NULL)
+			json_object_object_add(context, "input", json_object_new_string(input));
+		json_object_object_add(context, "min_time", json_object_new_double(min_time));
+		json_object_object_add(context, "repetitions", json_object_new_int(repetitions));
+		json_object_object_add(context, "count_allocs",
+		                       json_object_new_boolean(count_allocs));
+		report = json_object_new_object();
+		json_object_object_add(report, "context", context);
+		json_object_object_add(report, "benchmarks", json_object_get(results));
+		if (strcmp(output, "-") == 0)
+			printf("%s\n", json_object_to_json_string_ext(report, REPORT_FLAGS));
+		else if (json_object_to_file_ext(output, report, REPORT_FLAGS) != 0)
+		{
+			fprintf(stderr, "%s\n", json_util_get_last_err());
+			failed = 1;
+		}
+		json_object_put(report);
+	}
+	json_object_put(results);
+	for (ii = 0; ii < DOC_COUNT; ii++)
+		free(docs[ii]);
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+ * Write a synthetic JSON corpus, for use with jc_bench -i or any other
+ * benchmark.  The same options always produce the same output.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "corpus.h"
+
+#ifndef JSON_NORETURN
+#if defined(_MSC_VER)
+#define JSON_NORETURN __declspec(noreturn)
+#elif defined(__OS400__)
+#define JSON_NORETURN
+#else
+/* 'cold' attribute is for optimization, telling the computer this code
+ * path is unlikely.
+ */
+#define JSON_NORETURN __attribute__((noreturn, cold))
+#endif
+#endif
+
+JSON_NORETURN static void usage(const char *argv0, int exitval, const char *errmsg);
+
+static void usage(const char *argv0, int exitval, const char *errmsg)
+{
+	FILE *fp = stdout;
+	struct corpus_shape def;
+
+	corpus_shape_init(&def);
+	if (exitval != 0)
+		fp = stderr;
+	if (errmsg != NULL)
+		fprintf(fp, "ERROR: %s\n\n", errmsg);
+	fprintf(fp, "Usage: %s [options] [-o <file>]\n", argv0);
+	fprintf(fp, "  -s <n>     - Random seed (default %llu)\n", (unsigned long long)def.seed);
+	fprintf(fp, "  -n <n>     - Number of records (default %d)\n", def.records);
+	fprintf(fp, "  -k <n>     - Number of distinct keys (default %d)\n", def.keys);
+	fprintf(fp, "  -f <n>     - Members per object (default %d)\n", def.fields);
+	fprintf(fp, "  -d <n>     - Nesting depth within each record (default %d)\n", def.depth);
+	fprintf(fp, "  -a <n>     - Elements per array (default %d)\n", def.array_len);
+	fprintf(fp, "  -l <n>     - Average string length (default %d)\n", def.string_len);
+	fprintf(fp, "  -S <frac>  - Share of values that are strings (default %g)\n",
+	        def.string_share);
+	fprintf(fp, "  -e <frac>  - Share of string characters that are escaped (default %g)\n",
+	        def.escape_share);
+	fprintf(fp, "  -u <frac>  - Share of string characters that are non-ASCII (default %g)\n",
+	        def.unicode_share);
+	fprintf(fp, "  -m <i,u,d> - Relative weights of int, uint64 and double numbers\n");
+	fprintf(fp, "               (default %d,%d,%d)\n", def.int_weight, def.uint64_weight,
+	        def.double_weight);
+	fprintf(fp, "  -N         - Write one record per line (NDJSON), instead of one array\n");
+	fprintf(fp, "  -o <file>  - Write to <file> instead of stdout\n");
+	exit(exitval);
+}
+
+static double parse_share(const char *argv0, const char *arg)
+{
+	char *end;
+	double val = strtod(arg, &end);
+
+	if (*end != '\0' || !(val >= 0 && val <= 1))
+		usage(argv0, EXIT_FAILURE, "Shares must be between 0 and 1");
+	return val;
+}
+
+static int parse_count(const char *argv0, const char *arg, int min)
+{
+	char *end;
+	long val = strtol(arg, &end, 10);
+
+	if (*end != '\0' || val < min || val > 1000000000)
+		usage(argv0, EXIT_FAILURE, "Invalid count");
+	return (int)val;
+}
+
+int main(int argc, char **argv)
+{
+	struct corpus_shape shape;
+	struct printbuf *pb;
+	const char *output = NULL;
+	FILE *fp = stdout;
+	int opt;
+
+	corpus_shape_init(&shape);
+	while ((opt = getopt(argc, argv, "a:d:e:f:hk:l:m:n:No:s:S:u:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a': shape.array_len = parse_count(argv[0], optarg, 0); break;
+		case 'd': shape.depth = parse_count(argv[0], optarg, 0); break;
+		case 'e': shape.escape_share = parse_share(argv[0], optarg); break;
+		case 'f': shape.fields = parse_count(argv[0], optarg, 0); break;
+		case 'k': shape.keys = parse_count(argv[0], optarg, 1); break;
+		case 'l': shape.string_len = parse_count(argv[0], optarg, 1); break;
+		case 'm':
+			if (sscanf(optarg, "%d,%d,%d", &shape.int_weight, &shape.uint64_weight,
+			           &shape.double_weight) != 3 ||
+			    shape.int_weight < 0 || shape.uint64_weight < 0 ||
+			    shape.double_weight < 0)
+				usage(argv[0], EXIT_FAILURE, "-m expects 3 weights, e.g. 6,1,3");
+			break;
+		case 'n': shape.records = parse_count(argv[0], optarg, 0); break;
+		case 'N': shape.ndjson = 1; break;
+		case 'o': output = optarg; break;
+		case 's': shape.seed = strtoull(optarg, NULL, 0); break;
+		case 'S': shape.string_share = parse_share(argv[0], optarg); break;
+		case 'u': shape.unicode_share = parse_share(argv[0], optarg); break;
+		case 'h': usage(argv[0], 0, NULL);
+		default: /* '?' */ usage(argv[0], EXIT_FAILURE, "Unknown arguments");
+		}
+	}
+	if (optind < argc)
+		usage(argv[0], EXIT_FAILURE, "Unexpected arguments");
+
+	pb = printbuf_new();
+	if (pb == NULL || corpus_generate(&shape, pb) != 0)
+	{
+		fprintf(stderr, "unable to generate the corpus: %s\n", strerror(ENOMEM));
+		return EXIT_FAILURE;
+	}
+	if (output != NULL && (fp = fopen(output, "wb")) == NULL)
+	{
+		fprintf(stderr, "unable to open %s: %s\n", output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (fwrite(pb->buf, 1, printbuf_length(pb), fp) != (size_t)printbuf_length(pb) ||
+	    fclose(fp) != 0)
+	{
+		fprintf(stderr, "unable to write %s: %s\n", output ? output : "stdout",
+		        strerror(errno));
+		return EXIT_FAILURE;
+	}
+	printbuf_free(pb);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+# Generate the amalgamation: json-c.c and json-c.h, the whole library as a
+# single source file and a single header, which lets the compiler inline
+# across what are otherwise separate translation units, and which can be
+# dropped into another project's build.
+#
+# Run as a script:
+#   cmake -DSOURCES="<json-c .c files>" -DPUBLIC_HEADERS="<public headers>"
+#         -DINCLUDE_DIRS="<dirs to look up includes in>" -DOUTPUT_DIR=<dir>
+#         -P amalgamate.cmake
+#
+# Every #include "..." of a file found in INCLUDE_DIRS is replaced by that
+# file's contents, the first time it's seen, and dropped after that; all
+# json-c headers have include guards, or nothing that can't be repeated.
+# PUBLIC_HEADERS go into json-c.h, everything else into json-c.c.
+# The generated config.h and json_config.h are inlined too, so the result
+# is configured for the platform that cmake ran on.
+
+cmake_minimum_required(VERSION 3.9)
+
+foreach(var SOURCES PUBLIC_HEADERS INCLUDE_DIRS OUTPUT_DIR)
+    if (NOT DEFINED ${var})
+        message(FATAL_ERROR "amalgamate.cmake: ${var} is not set")
+    endif()
+endforeach()
+
+set_property(GLOBAL PROPERTY AMALGAMATED_FILES "")
+
+function(find_include name result)
+    foreach(dir ${INCLUDE_DIRS})
+        if (EXISTS "${dir}/${name}")
+            set(${result} "${dir}/${name}" PARENT_SCOPE)
+            return()
+        endif()
+    endforeach()
+    set(${result} "" PARENT_SCOPE)
+endfunction()
+
+# Append the contents of path to the variable out, expanding its includes
+function(amalgamate_file path out)
+    get_filename_component(name "${path}" NAME)
+    file(READ "${path}" rest)
+    # So that every #include to be matched follows a newline
+    set(rest "\n${rest}")
+    set(done "\n/*** Start of ${name} ***/\n")
+
+    while (1)
+        string(REGEX MATCH "\n#include \"([^\"]+)\"[^\n]*" line "${rest}")
+        if (line STREQUAL "")
+            break()
+        endif()
+        set(inc "${CMAKE_MATCH_1}")
+        string(FIND "${rest}" "${line}" pos)
+        string(LENGTH "${line}" len)
+        string(SUBSTRING "${rest}" 0 ${pos} before)
+        math(EXPR pos "${pos} + ${len}")
+        string(SUBSTRING "${rest}" ${pos} -1 rest)
+        string(APPEND done "${before}")
+
+        find_include("${inc}" inc_path)
+        get_property(seen GLOBAL PROPERTY AMALGAMATED_FILES)
+        if (inc_path STREQUAL "")
+            # Not one of ours, leave it to the compiler
+            string(APPEND done "${line}")
+        elseif (NOT inc_path IN_LIST seen)
+            set_property(GLOBAL APPEND PROPERTY AMALGAMATED_FILES "${inc_path}")
+            set(inner "")
+            amalgamate_file("${inc_path}" inner)
+            string(APPEND done "${inner}")
+        else()
+            string(APPEND done "\n/* ${inc} is already included */")
+        endif()
+    endwhile()
+
+    string(APPEND done "${rest}\n/*** End of ${name} ***/\n")
+    set(${out} "${${out}}${done}" PARENT_SCOPE)
+endfunction()
+
+set(banner "/*
+ * json-c, amalgamated into a single file.  Do not edit, this is generated
+ * from the json-c sources by cmake/amalgamate.cmake.
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ */
+")
+
+set(header "${banner}#ifndef _json_c_amalgamation_h_\n#define _json_c_amalgamation_h_\n")
+foreach(path ${PUBLIC_HEADERS})
+    get_property(seen GLOBAL PROPERTY AMALGAMATED_FILES)
+    if (NOT path IN_LIST seen)
+        set_property(GLOBAL APPEND PROPERTY AMALGAMATED_FILES "${path}")
+        amalgamate_file("${path}" header)
+    endif()
+endforeach()
+string(APPEND header "\n#endif\n")
+
+# config.h has to come before anything else, then the public headers
+set(source "${banner}")
+find_include("config.h" config_h)
+set_property(GLOBAL APPEND PROPERTY AMALGAMATED_FILES "${config_h}")
+amalgamate_file("${config_h}" source)
+string(APPEND source "\n#include \"json-c.h\"\n")
+foreach(path ${SOURCES})
+    amalgamate_file("${path}" source)
+endforeach()
+
+file(WRITE "${OUTPUT_DIR}/json-c.h" "${header}")
+file(WRITE "${OUTPUT_DIR}/json-c.c" "${source}")
@@ -0,0 +1,85 @@
+#!/bin/bash -eu
+#
+# Run complexity_fuzzer locally, looking for inputs that make json-c do
+# superlinear work.  See complexity_fuzzer.cc for what is measured.
+#
+# Usage, from the top of the json-c source tree:
+#
+#   fuzz/complexity.sh [seconds]       fuzz for that long, 600 by default
+#   fuzz/complexity.sh --replay FILE...
+#                                      report what each file costs, without
+#                                      libFuzzer; exits 1 if any went over
+#                                      its budget
+#
+# Fuzzing needs clang with -fsanitize=fuzzer, replaying any C++ compiler.
+# Inputs found to go over a budget are saved in $OUT/complexity-crashes.
+
+: ${OUT:=$(pwd)/fuzz/out}
+: ${CC:=clang}
+: ${CXX:=clang++}
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+BUILD=$OUT/complexity-build
+
+build_lib()
+{
+	# No sanitizers: they'd be counted as json-c's work
+	mkdir -p "$BUILD"
+	(cd "$BUILD" && cmake -DBUILD_SHARED_LIBS=OFF -DCMAKE_BUILD_TYPE=Release \
+		-DCMAKE_C_COMPILER="$CC" "$SRC/.." >/dev/null && make -j"$(nproc)" json-c >/dev/null)
+}
+
+# Seeds that each hit one of the known ways to make a parser do more work
+# than it should, for the fuzzer to start from
+make_seeds()
+{
+	local dir=$1
+
+	mkdir -p "$dir"
+	# A long number, which gets re-scanned if it's split across chunks
+	printf '%s' "$(printf '1%.0s' $(seq 4000))" >"$dir/long_number"
+	printf '[%s]' "$(printf '0.%.0s' $(seq 1))$(printf '5%.0s' $(seq 4000))" >"$dir/long_fraction"
+	# Deep nesting
+	printf '%s' "$(printf '[%.0s' $(seq 900))$(printf ']%.0s' $(seq 900))" >"$dir/deep_arrays"
+	printf '%s1' "$(printf '{"a":%.0s' $(seq 900))" >"$dir/deep_objects"
+	printf '}%.0s' $(seq 900) >>"$dir/deep_objects"
+	# Many keys, and the same key many times over
+	{
+		printf '{'
+		seq -f '"k%g":1,' 4000
+		printf '"last":1}'
+	} >"$dir/many_keys"
+	{
+		printf '{'
+		printf '"k":1,%.0s' $(seq 4000)
+		printf '"k":1}'
+	} >"$dir/duplicate_keys"
+	# Long strings, full of escapes
+	printf '["%s"]' "$(printf '\\u00e9\\n%.0s' $(seq 2000))" >"$dir/escaped_string"
+	printf '["%s"]' "$(printf '\\ud83d\\ude00%.0s' $(seq 1000))" >"$dir/surrogates"
+}
+
+if [ "${1:-}" = "--replay" ]; then
+	shift
+	CXX=${CXX_REPLAY:-c++}
+	CC=${CC_REPLAY:-cc}
+	build_lib
+	${CXX} -std=c++11 -O2 -DJSON_C_COMPLEXITY_STANDALONE -I"$SRC/.." -I"$BUILD" \
+		"$SRC/complexity_fuzzer.cc" -o "$BUILD/complexity_replay" "$BUILD/libjson-c.a"
+	if [ $# -eq 0 ]; then
+		make_seeds "$BUILD/seeds"
+		set -- "$BUILD"/seeds/*
+	fi
+	exec "$BUILD/complexity_replay" "$@"
+fi
+
+SECONDS_TO_RUN=${1:-600}
+build_lib
+${CXX} -std=c++11 -O2 -g -fsanitize=fuzzer -I"$SRC/.." -I"$BUILD" \
+	"$SRC/complexity_fuzzer.cc" -o "$BUILD/complexity_fuzzer" "$BUILD/libjson-c.a"
+
+make_seeds "$OUT/complexity-corpus"
+mkdir -p "$OUT/complexity-crashes"
+exec "$BUILD/complexity_fuzzer" -dict="$SRC/tokener_parse_ex_fuzzer.dict" \
+	-max_len=65536 -max_total_time="$SECONDS_TO_RUN" -timeout=60 \
+	-artifact_prefix="$OUT/complexity-crashes/" "$OUT/complexity-corpus"
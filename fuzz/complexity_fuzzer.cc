@@ -0,0 +1,396 @@
+// Looks for inputs that make json-c do superlinear work, rather than crash.
+//
+// Each input is parsed whole and one byte at a time, serialized, deep
+// copied, compared and then has every key of every object replaced, and
+// the work that took is measured against the size of the input:
+//
+//  - cost: instructions retired, from perf_event_open() where the kernel
+//    allows it, or else thread CPU time in nanoseconds
+//  - mallocs, reallocs and the bytes passed to realloc(), counted through
+//    json_c_set_alloc_funcs()
+//  - hash table probes: the slots a lookup of every key has to look at,
+//    and the slots a lookup of a missing key has to look at in every object
+//    once its keys were replaced, which grows with tombstones (LH_FREED)
+//
+// An input that goes over one of the budgets below is reported and abort()s,
+// so that libFuzzer saves it.  Under libFuzzer, how close each input gets to
+// the budgets is also fed back as extra coverage, which steers the fuzzer
+// towards more expensive inputs.  Set JSON_C_COMPLEXITY_SLACK to scale the
+// budgets, e.g. to 2 on a noisy machine when cost is measured in time.
+//
+// Build with -DJSON_C_COMPLEXITY_STANDALONE for a main() that replays files
+// without libFuzzer and prints what each one cost, see complexity.sh.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <json.h>
+#include <json_alloc.h>
+#include <json_visit.h>
+
+// Budgets, as a multiple of the input size plus a constant
+#define MALLOCS_PER_BYTE 16
+#define MALLOCS_BASE 1024
+#define REALLOC_BYTES_PER_BYTE 64
+#define REALLOC_BYTES_BASE (1024 * 1024)
+#define PROBES_PER_KEY 8
+#define PROBES_BASE 64
+#define INSNS_PER_BYTE 50000
+#define INSNS_BASE (10 * 1000 * 1000)
+#define NS_PER_BYTE 20000
+#define NS_BASE (50 * 1000 * 1000)
+// Parsing a byte at a time costs a lot more than parsing all at once, but
+// by a constant factor
+#define CHUNKED_RATIO 100
+
+#define MAX_DEPTH 1000
+
+struct work
+{
+	uint64_t cost;          // See cost_now()
+	uint64_t chunked_cost;  // Parsing a byte at a time
+	uint64_t mallocs;
+	uint64_t reallocs;
+	uint64_t realloc_bytes;
+	uint64_t keys;
+	uint64_t objects;
+	uint64_t hit_probes;
+	uint64_t miss_probes;
+};
+
+static struct work counts;
+static int perf_fd = -1;
+static double slack = 1.0;
+
+static void *count_malloc(size_t size)
+{
+	counts.mallocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	counts.reallocs++;
+	counts.realloc_bytes += size;
+	return realloc(ptr, size);
+}
+
+static uint64_t cost_now(void)
+{
+	struct timespec ts;
+
+#ifdef __linux__
+	uint64_t insns;
+
+	if (perf_fd >= 0 && read(perf_fd, &insns, sizeof(insns)) == (ssize_t)sizeof(insns))
+		return insns;
+#endif
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void init(void)
+{
+	const char *env = getenv("JSON_C_COMPLEXITY_SLACK");
+
+	if (env != NULL && atof(env) > 0)
+		slack = atof(env);
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	perf_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	// This must come before json-c allocates anything
+	json_c_set_alloc_funcs(count_malloc, count_realloc, free);
+}
+
+// The slots that finding key in t looks at, whether or not it's there
+static uint64_t probe_length(struct lh_table *t, const void *key)
+{
+	unsigned long n = lh_get_hash(t, key) % t->size;
+	uint64_t probes = 1;
+
+	while (t->table[n].k != LH_EMPTY && probes < (uint64_t)t->size)
+	{
+		if (t->table[n].k != LH_FREED && t->equal_fn(t->table[n].k, key))
+			break;
+		if ((int)++n == t->size)
+			n = 0;
+		probes++;
+	}
+	return probes;
+}
+
+static int count_probes(json_object *jso, int flags, json_object *parent, const char *key,
+                        size_t *index, void *arg)
+{
+	struct work *w = (struct work *)arg;
+	struct lh_table *t;
+	struct lh_entry *ent;
+
+	(void)parent;
+	(void)key;
+	(void)index;
+
+	if ((flags & JSON_C_VISIT_SECOND) || !json_object_is_type(jso, json_type_object))
+		return JSON_C_VISIT_RETURN_CONTINUE;
+	t = json_object_get_object(jso);
+	w->objects++;
+	for (ent = t->head; ent != NULL; ent = ent->next)
+	{
+		w->keys++;
+		w->hit_probes += probe_length(t, ent->k);
+	}
+	w->miss_probes += probe_length(t, "\x01 not a key");
+	return JSON_C_VISIT_RETURN_CONTINUE;
+}
+
+// Replace every key of every object, leaving a tombstone for each
+static int churn(json_object *jso, int flags, json_object *parent, const char *key,
+                 size_t *index, void *arg)
+{
+	json_object *renamed;
+	char *keys = NULL;
+	size_t len = 0, pos;
+
+	(void)parent;
+	(void)key;
+	(void)index;
+	(void)arg;
+	if ((flags & JSON_C_VISIT_SECOND) || !json_object_is_type(jso, json_type_object))
+		return JSON_C_VISIT_RETURN_CONTINUE;
+
+	// Gather the keys first, since they can't be changed while iterating
+	json_object_object_foreach(jso, k, v)
+	{
+		size_t klen = strlen(k) + 1;
+		char *newkeys = (char *)realloc(keys, len + klen);
+
+		if (newkeys == NULL)
+		{
+			free(keys);
+			return JSON_C_VISIT_RETURN_ERROR;
+		}
+		keys = newkeys;
+		memcpy(keys + len, k, klen);
+		len += klen;
+		(void)v;
+	}
+	renamed = json_object_new_object();
+	for (pos = 0; pos < len; pos += strlen(keys + pos) + 1)
+	{
+		json_object_object_add(renamed, keys + pos, NULL);
+		json_object_object_del(jso, keys + pos);
+	}
+	// Put them back under new names, so that they don't reuse their old slots
+	for (pos = 0; pos < len; pos += strlen(keys + pos) + 1)
+	{
+		char newkey[64];
+
+		snprintf(newkey, sizeof(newkey), "%zu", pos);
+		json_object_object_add(jso, newkey, NULL);
+	}
+	json_object_put(renamed);
+	free(keys);
+	return JSON_C_VISIT_RETURN_SKIP;
+}
+
+static void measure(const char *data, size_t size, struct work *w)
+{
+	json_tokener *tok = json_tokener_new_ex(MAX_DEPTH);
+	json_object *obj, *copy = NULL;
+	uint64_t start;
+	size_t ii;
+
+	memset(&counts, 0, sizeof(counts));
+	start = cost_now();
+	obj = json_tokener_parse_ex(tok, data, (int)size);
+	// Not pretty printed, since its output grows with the square of the depth
+	(void)json_object_to_json_string_ext(obj, JSON_C_TO_STRING_SPACED);
+	if (json_object_deep_copy(obj, &copy, NULL) == 0)
+		(void)json_object_equal(obj, copy);
+	json_c_visit(copy, 0, churn, NULL);
+	json_object_put(copy);
+	w->cost = cost_now() - start;
+	w->mallocs = counts.mallocs;
+	w->reallocs = counts.reallocs;
+	w->realloc_bytes = counts.realloc_bytes;
+
+	// Probe counts don't depend on the instruction or time counters
+	w->keys = w->objects = w->hit_probes = w->miss_probes = 0;
+	json_c_visit(obj, 0, count_probes, w);
+	if (json_object_deep_copy(obj, &copy, NULL) == 0)
+	{
+		struct work churned;
+
+		memset(&churned, 0, sizeof(churned));
+		json_c_visit(copy, 0, churn, NULL);
+		json_c_visit(copy, 0, count_probes, &churned);
+		w->miss_probes = churned.miss_probes;
+		json_object_put(copy);
+	}
+	json_object_put(obj);
+
+	json_tokener_reset(tok);
+	start = cost_now();
+	for (ii = 0; ii < size; ii++)
+	{
+		obj = json_tokener_parse_ex(tok, data + ii, 1);
+		if (obj != NULL || json_tokener_get_error(tok) != json_tokener_continue)
+			break;
+	}
+	w->chunked_cost = cost_now() - start;
+	json_object_put(obj);
+	json_tokener_free(tok);
+}
+
+// The budgets for cost, in instructions when perf can count them, else in ns
+static double cost_budget(size_t size)
+{
+	if (perf_fd >= 0)
+		return (double)INSNS_PER_BYTE * size + INSNS_BASE;
+	return (double)NS_PER_BYTE * size + NS_BASE;
+}
+
+static double chunked_cost_budget(const struct work *w)
+{
+	return (double)CHUNKED_RATIO * w->cost + (perf_fd >= 0 ? INSNS_BASE : NS_BASE);
+}
+
+static const char *check(const struct work *w, size_t size)
+{
+	if (w->mallocs > slack * (MALLOCS_PER_BYTE * size + MALLOCS_BASE))
+		return "mallocs";
+	if (w->realloc_bytes > slack * (REALLOC_BYTES_PER_BYTE * size + REALLOC_BYTES_BASE))
+		return "realloc bytes";
+	if (w->hit_probes > slack * (PROBES_PER_KEY * w->keys + PROBES_BASE))
+		return "hash probes";
+	if (w->miss_probes > slack * (PROBES_PER_KEY * (w->keys + w->objects) + PROBES_BASE))
+		return "hash probes after replacing keys";
+	if (w->cost > slack * cost_budget(size))
+		return "cost";
+	if (w->chunked_cost > slack * chunked_cost_budget(w))
+		return "cost of parsing a byte at a time";
+	return NULL;
+}
+
+static void print_work(FILE *fp, const char *name, const struct work *w, size_t size)
+{
+	fprintf(fp,
+	        "%s: %zu bytes, %s %llu, chunked %llu, mallocs %llu, reallocs %llu"
+	        " (%llu bytes), keys %llu, probes %llu, miss probes %llu\n",
+	        name, size, perf_fd >= 0 ? "insns" : "ns", (unsigned long long)w->cost,
+	        (unsigned long long)w->chunked_cost, (unsigned long long)w->mallocs,
+	        (unsigned long long)w->reallocs, (unsigned long long)w->realloc_bytes,
+	        (unsigned long long)w->keys, (unsigned long long)w->hit_probes,
+	        (unsigned long long)w->miss_probes);
+}
+
+#ifndef JSON_C_COMPLEXITY_STANDALONE
+
+// libFuzzer treats these as coverage: one counter per metric and per
+// power of two of how much of its budget an input used
+__attribute__((section("__libfuzzer_extra_counters"))) static uint8_t extra_counters[6 * 16];
+
+static void set_extra_counter(int metric, double used, double budget)
+{
+	int bucket = 0;
+
+	while (bucket < 15 && used * 1024 > budget * (1 << bucket))
+		bucket++;
+	extra_counters[metric * 16 + bucket] = 1;
+}
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	(void)argc;
+	(void)argv;
+	init();
+	return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct work w;
+	const char *over;
+
+	measure(reinterpret_cast<const char *>(data), size, &w);
+	set_extra_counter(0, w.mallocs, MALLOCS_PER_BYTE * size + MALLOCS_BASE);
+	set_extra_counter(1, w.realloc_bytes, REALLOC_BYTES_PER_BYTE * size + REALLOC_BYTES_BASE);
+	set_extra_counter(2, w.hit_probes, PROBES_PER_KEY * w.keys + PROBES_BASE);
+	set_extra_counter(3, w.miss_probes, PROBES_PER_KEY * (w.keys + w.objects) + PROBES_BASE);
+	set_extra_counter(4, w.cost, cost_budget(size));
+	set_extra_counter(5, w.chunked_cost, chunked_cost_budget(&w));
+
+	if ((over = check(&w, size)) != NULL)
+	{
+		fprintf(stderr, "==json-c complexity== over the budget for %s\n", over);
+		print_work(stderr, "input", &w, size);
+		abort();
+	}
+	return 0;
+}
+
+#else
+
+// Replay files, e.g. a corpus or saved crashes, and report what each cost
+int main(int argc, char **argv)
+{
+	int ii, rc = 0;
+
+	init();
+	for (ii = 1; ii < argc; ii++)
+	{
+		FILE *fp = fopen(argv[ii], "rb");
+		char *data = NULL;
+		size_t size = 0, ret;
+		char buf[65536];
+		struct work w;
+		const char *over;
+
+		if (fp == NULL)
+		{
+			fprintf(stderr, "%s: %s\n", argv[ii], strerror(errno));
+			return 2;
+		}
+		while ((ret = fread(buf, 1, sizeof(buf), fp)) > 0)
+		{
+			data = (char *)realloc(data, size + ret);
+			if (data == NULL)
+			{
+				fprintf(stderr, "%s: out of memory\n", argv[ii]);
+				return 2;
+			}
+			memcpy(data + size, buf, ret);
+			size += ret;
+		}
+		fclose(fp);
+
+		measure(data != NULL ? data : "", size, &w);
+		print_work(stdout, argv[ii], &w, size);
+		if ((over = check(&w, size)) != NULL)
+		{
+			printf("%s: over the budget for %s\n", argv[ii], over);
+			rc = 1;
+		}
+		free(data);
+	}
+	return rc;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "json_alloc_private.h"
+
+struct json_c_alloc_funcs json_c_alloc = {malloc, realloc, free, 1};
+
+int json_c_set_alloc_funcs(json_c_malloc_fn *malloc_fn, json_c_realloc_fn *realloc_fn,
+                           json_c_free_fn *free_fn)
+{
+	if (malloc_fn == NULL && realloc_fn == NULL && free_fn == NULL)
+	{
+		json_c_alloc.malloc_fn = malloc;
+		json_c_alloc.realloc_fn = realloc;
+		json_c_alloc.free_fn = free;
+		json_c_alloc.is_default = 1;
+		return 0;
+	}
+	if (malloc_fn == NULL || realloc_fn == NULL || free_fn == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	json_c_alloc.malloc_fn = malloc_fn;
+	json_c_alloc.realloc_fn = realloc_fn;
+	json_c_alloc.free_fn = free_fn;
+	json_c_alloc.is_default = 0;
+	return 0;
+}
+
+void json_c_get_alloc_funcs(json_c_malloc_fn **malloc_fn, json_c_realloc_fn **realloc_fn,
+                            json_c_free_fn **free_fn)
+{
+	if (malloc_fn != NULL)
+		*malloc_fn = json_c_alloc.malloc_fn;
+	if (realloc_fn != NULL)
+		*realloc_fn = json_c_alloc.realloc_fn;
+	if (free_fn != NULL)
+		*free_fn = json_c_alloc.free_fn;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/**
+ * @file
+ * @brief Replace the memory allocator that json-c uses.
+ */
+#ifndef _json_alloc_h_
+#define _json_alloc_h_
+
+#include "json_types.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A replacement for malloc(), see json_c_set_alloc_funcs() */
+typedef void *(json_c_malloc_fn)(size_t size);
+/** A replacement for realloc(), see json_c_set_alloc_funcs() */
+typedef void *(json_c_realloc_fn)(void *ptr, size_t size);
+/** A replacement for free(), see json_c_set_alloc_funcs() */
+typedef void(json_c_free_fn)(void *ptr);
+
+/**
+ * Set the functions that json-c uses for all of its memory allocations,
+ * instead of malloc(), realloc() and free(), e.g. to use an arena or
+ * pool allocator, or to count allocations.
+ *
+ * The functions must behave like the ones they replace: realloc_fn(NULL, n)
+ * must act like malloc_fn(n), and free_fn(NULL) must do nothing.
+ *
+ * This affects the whole process, and must be called before any other
+ * json-c function, since memory allocated by one set of functions can't be
+ * released by another.  That includes any userdata released with
+ * json_object_free_userdata().
+ *
+ * @param malloc_fn the replacement for malloc()
+ * @param realloc_fn the replacement for realloc()
+ * @param free_fn the replacement for free()
+ * @return 0 on success, or -1 (with errno set to EINVAL) if some but not all of
+ *         the functions are NULL.  Passing all NULLs restores the defaults.
+ */
+JSON_EXPORT int json_c_set_alloc_funcs(json_c_malloc_fn *malloc_fn, json_c_realloc_fn *realloc_fn,
+                                       json_c_free_fn *free_fn);
+
+/**
+ * Return the functions that json-c currently uses to allocate memory,
+ * e.g. to allocate userdata that json_object_free_userdata() will release.
+ * Any of the arguments may be NULL.
+ */
+JSON_EXPORT void json_c_get_alloc_funcs(json_c_malloc_fn **malloc_fn,
+                                        json_c_realloc_fn **realloc_fn, json_c_free_fn **free_fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ */
+
+/**
+ * @file
+ * @brief Do not use, json-c internal, may be changed or removed at any time.
+ */
+#ifndef _json_alloc_private_h_
+#define _json_alloc_private_h_
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_alloc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct json_c_alloc_funcs
+{
+	json_c_malloc_fn *malloc_fn;
+	json_c_realloc_fn *realloc_fn;
+	json_c_free_fn *free_fn;
+	int is_default;
+};
+
+/* Set by json_c_set_alloc_funcs() */
+extern struct json_c_alloc_funcs json_c_alloc;
+
+/*
+ * All memory that json-c allocates or frees itself must go through these,
+ * instead of calling malloc(), calloc(), realloc(), free() or strdup() directly.
+ */
+static inline void *json_c_malloc(size_t size)
+{
+	return json_c_alloc.malloc_fn(size);
+}
+
+static inline void *json_c_calloc(size_t nmemb, size_t size)
+{
+	void *p;
+
+	if (json_c_alloc.is_default)
+		return calloc(nmemb, size);
+	if (size != 0 && nmemb > (size_t)-1 / size)
+		return NULL;
+	if ((p = json_c_alloc.malloc_fn(nmemb * size)) != NULL)
+		memset(p, 0, nmemb * size);
+	return p;
+}
+
+static inline void *json_c_realloc(void *ptr, size_t size)
+{
+	return json_c_alloc.realloc_fn(ptr, size);
+}
+
+static inline void json_c_free(void *ptr)
+{
+	json_c_alloc.free_fn(ptr);
+}
+
+static inline char *json_c_strdup(const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *p = (char *)json_c_alloc.malloc_fn(len);
+
+	if (p != NULL)
+		memcpy(p, str, len);
+	return p;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -24,9 +24,11 @@
 
 #include "arraylist.h"
 #include "debug.h"
+#include "json_alloc_private.h"
 #include "json_inttypes.h"
 #include "json_object.h"
 #include "json_object_private.h"
+#include "json_probes_private.h"
 #include "json_util.h"
 #include "linkhash.h"
 #include "math_compat.h"
@@ -65,6 +67,12 @@ static void json_object_generic_delete(struct json_object *jso);
 #define inline
 #endif
 
+#if defined(__GNUC__)
+#define json_object_prefetch(p) __builtin_prefetch(p)
+#else
+#define json_object_prefetch(p) ((void)0)
+#endif
+
 /* define colors */
 #define ANSI_COLOR_RESET "\033[0m"
 #define ANSI_COLOR_FG_GREEN "\033[0;32m"
@@ -134,9 +142,11 @@ static inline const struct json_object_string *JC_STRING_C(const struct json_obj
 static inline struct json_object *json_object_new(enum json_type o_type, size_t alloc_size,
                                                   json_object_to_json_string_fn *to_json_string);
 
-static void json_object_object_delete(struct json_object *jso_base);
+static void json_object_object_delete(struct json_object *jso_base, struct json_object **worklist);
 static void json_object_string_delete(struct json_object *jso);
-static void json_object_array_delete(struct json_object *jso);
+static void json_object_array_delete(struct json_object *jso, struct json_object **worklist);
+static void json_object_lh_entry_free(struct lh_entry *ent);
+static void json_object_array_entry_free(void *data);
 
 static json_object_to_json_string_fn json_object_object_to_json_string;
 static json_object_to_json_string_fn json_object_boolean_to_json_string;
@@ -269,11 +279,12 @@ struct json_object *json_object_get(struct json_object *jso)
 	return jso;
 }
 
-int json_object_put(struct json_object *jso)
+/*
+ * Drop a reference to jso, and if it was the last one, call its _user_delete
+ * function and return 1.  The caller is then responsible for freeing it.
+ */
+static int json_object_release(struct json_object *jso)
 {
-	if (!jso)
-		return 0;
-
 	/* Avoid invalid free and crash explicitly instead of (silently)
 	 * segfaulting.
 	 */
@@ -295,22 +306,122 @@ int json_object_put(struct json_object *jso)
 
 	if (jso->_user_delete)
 		jso->_user_delete(jso, jso->_userdata);
-	switch (jso->o_type)
+	return 1;
+}
+
+/*
+ * Free the objects on worklist, a list linked through the _userdata field
+ * of objects that json_object_release() returned 1 for.
+ *
+ * Children whose last reference goes away are pushed onto the list rather
+ * than freed recursively, so this uses constant stack space no matter how
+ * deeply nested the objects are.
+ *
+ * If max_objects is non-zero, at most that many objects are freed and the
+ * rest of the list is returned, otherwise it returns NULL.
+ */
+static struct json_object *json_object_free_worklist(struct json_object *worklist,
+                                                     size_t max_objects, size_t *nfreed)
+{
+	size_t count = 0;
+
+	while (worklist != NULL && (max_objects == 0 || count < max_objects))
+	{
+		struct json_object *jso = worklist;
+
+		worklist = (struct json_object *)jso->_userdata;
+		switch (jso->o_type)
+		{
+		case json_type_object: json_object_object_delete(jso, &worklist); break;
+		case json_type_array: json_object_array_delete(jso, &worklist); break;
+		case json_type_string: json_object_string_delete(jso); break;
+		default: json_object_generic_delete(jso); break;
+		}
+		count++;
+	}
+	if (nfreed)
+		*nfreed = count;
+	return worklist;
+}
+
+/* Release a child of an object being freed, adding it to worklist if this was the last reference */
+static void json_object_release_child(struct json_object *jso, struct json_object **worklist)
+{
+	if (jso == NULL || !json_object_release(jso))
+		return;
+	jso->_userdata = *worklist;
+	*worklist = jso;
+}
+
+int json_object_put(struct json_object *jso)
+{
+	size_t nfreed = 0;
+
+	if (!jso)
+		return 0;
+	if (!json_object_release(jso))
+		return 0;
+
+	JSON_C_PROBE2(free__start, jso, jso->o_type);
+	jso->_userdata = NULL;
+	(void)json_object_free_worklist(jso, 0, &nfreed);
+	JSON_C_PROBE2(free__done, jso, nfreed);
+	return 1;
+}
+
+/*
+ * Objects handed to json_object_put_deferred(), pushed by any thread, and
+ * the part of them that json_c_reclaim_deferred() is working through.
+ */
+static struct json_object *deferred_head = NULL;
+static struct json_object *deferred_work = NULL;
+
+int json_object_put_deferred(struct json_object *jso)
+{
+	if (!jso)
+		return 0;
+	if (!json_object_release(jso))
+		return 0;
+
+#if defined(HAVE_ATOMIC_BUILTINS)
 	{
-	case json_type_object: json_object_object_delete(jso); break;
-	case json_type_array: json_object_array_delete(jso); break;
-	case json_type_string: json_object_string_delete(jso); break;
-	default: json_object_generic_delete(jso); break;
+		struct json_object *head;
+		do
+		{
+			head = deferred_head;
+			jso->_userdata = head;
+		} while (!__sync_bool_compare_and_swap(&deferred_head, head, jso));
 	}
+#else
+	jso->_userdata = deferred_head;
+	deferred_head = jso;
+#endif
 	return 1;
 }
 
+size_t json_c_reclaim_deferred(size_t max_objects)
+{
+	size_t nfreed = 0;
+
+	if (deferred_work == NULL)
+	{
+#if defined(HAVE_ATOMIC_BUILTINS)
+		deferred_work = __sync_lock_test_and_set(&deferred_head, NULL);
+#else
+		deferred_work = deferred_head;
+		deferred_head = NULL;
+#endif
+	}
+	deferred_work = json_object_free_worklist(deferred_work, max_objects, &nfreed);
+	return nfreed;
+}
+
 /* generic object construction and destruction parts */
 
 static void json_object_generic_delete(struct json_object *jso)
 {
 	printbuf_free(jso->_pb);
-	free(jso);
+	json_c_free(jso);
 }
 
 static inline struct json_object *json_object_new(enum json_type o_type, size_t alloc_size,
@@ -318,7 +429,7 @@ static inline struct json_object *json_object_new(enum json_type o_type, size_t
 {
 	struct json_object *jso;
 
-	jso = (struct json_object *)malloc(alloc_size);
+	jso = (struct json_object *)json_c_malloc(alloc_size);
 	if (!jso)
 		return NULL;
 
@@ -410,6 +521,7 @@ const char *json_object_to_json_string_length(struct json_object *jso, int flags
 	const char *r = NULL;
 	size_t s = 0;
 
+	JSON_C_PROBE2(serialize__start, jso, flags);
 	if (!jso)
 	{
 		s = 4;
@@ -428,6 +540,7 @@ const char *json_object_to_json_string_length(struct json_object *jso, int flags
 
 	if (length)
 		*length = s;
+	JSON_C_PROBE2(serialize__done, jso, s);
 	return r;
 }
 
@@ -517,13 +630,32 @@ static int json_object_object_to_json_string(struct json_object *jso, struct pri
 static void json_object_lh_entry_free(struct lh_entry *ent)
 {
 	if (!lh_entry_k_is_constant(ent))
-		free(lh_entry_k(ent));
+		json_c_free(lh_entry_k(ent));
 	json_object_put((struct json_object *)lh_entry_v(ent));
 }
 
-static void json_object_object_delete(struct json_object *jso_base)
+static void json_object_object_delete(struct json_object *jso_base, struct json_object **worklist)
 {
-	lh_table_free(JC_OBJECT(jso_base)->c_object);
+	struct lh_table *t = JC_OBJECT(jso_base)->c_object;
+	struct lh_entry *ent;
+
+	if (t->free_fn != json_object_lh_entry_free)
+	{
+		lh_table_free(t);
+		json_object_generic_delete(jso_base);
+		return;
+	}
+	/* Same as lh_table_free(), but without recursing into the values */
+	for (ent = t->head; ent != NULL; ent = ent->next)
+	{
+		if (ent->next != NULL)
+			json_object_prefetch(lh_entry_v(ent->next));
+		if (!lh_entry_k_is_constant(ent))
+			json_c_free(lh_entry_k(ent));
+		json_object_release_child((struct json_object *)lh_entry_v(ent), worklist);
+	}
+	json_c_free(t->table);
+	json_c_free(t);
 	json_object_generic_delete(jso_base);
 }
 
@@ -567,23 +699,40 @@ int json_object_object_add_ex(struct json_object *jso, const char *const key,
 	// and re-adding it, so the existing key remains valid.
 	hash = lh_get_hash(JC_OBJECT(jso)->c_object, (const void *)key);
 	existing_entry =
-	    (opts & JSON_C_OBJECT_ADD_KEY_IS_NEW)
+	    (opts & (JSON_C_OBJECT_ADD_KEY_IS_NEW | JSON_C_OBJECT_ADD_IF_NEW))
 	        ? NULL
 	        : lh_table_lookup_entry_w_hash(JC_OBJECT(jso)->c_object, (const void *)key, hash);
 
 	// The caller must avoid creating loops in the object tree, but do a
 	// quick check anyway to make sure we're not creating a trivial loop.
 	if (jso == val)
+	{
+		if (opts & JSON_C_OBJECT_ADD_TAKE_KEY)
+			json_c_free(_LH_UNCONST(key));
 		return -1;
+	}
 
 	if (!existing_entry)
 	{
 		const void *const k =
-		    (opts & JSON_C_OBJECT_ADD_CONSTANT_KEY) ? (const void *)key : strdup(key);
+		    (opts & (JSON_C_OBJECT_ADD_CONSTANT_KEY | JSON_C_OBJECT_ADD_TAKE_KEY))
+		        ? (const void *)key
+		        : json_c_strdup(key);
+		int rc;
 		if (k == NULL)
 			return -1;
-		return lh_table_insert_w_hash(JC_OBJECT(jso)->c_object, k, val, hash, opts);
+		/* 1 if the key is there already, with JSON_C_OBJECT_ADD_IF_NEW */
+		rc = lh_table_insert_w_hash(JC_OBJECT(jso)->c_object, k, val, hash, opts);
+		if (rc != 0)
+		{
+			if (!(opts & JSON_C_OBJECT_ADD_CONSTANT_KEY))
+				json_c_free(_LH_UNCONST(k));
+			return rc < 0 ? -1 : rc;
+		}
+		return 0;
 	}
+	if (opts & JSON_C_OBJECT_ADD_TAKE_KEY)
+		json_c_free(_LH_UNCONST(key));
 	existing_value = (json_object *)lh_entry_v(existing_entry);
 	if (existing_value)
 		json_object_put(existing_value);
@@ -1001,15 +1150,15 @@ int json_c_set_serialization_double_format(const char *double_format, int global
 #if defined(HAVE___THREAD)
 		if (tls_serialization_float_format)
 		{
-			free(tls_serialization_float_format);
+			json_c_free(tls_serialization_float_format);
 			tls_serialization_float_format = NULL;
 		}
 #endif
 		if (global_serialization_float_format)
-			free(global_serialization_float_format);
+			json_c_free(global_serialization_float_format);
 		if (double_format)
 		{
-			char *p = strdup(double_format);
+			char *p = json_c_strdup(double_format);
 			if (p == NULL)
 			{
 				_json_c_set_last_err("json_c_set_serialization_double_format: "
@@ -1028,12 +1177,12 @@ int json_c_set_serialization_double_format(const char *double_format, int global
 #if defined(HAVE___THREAD)
 		if (tls_serialization_float_format)
 		{
-			free(tls_serialization_float_format);
+			json_c_free(tls_serialization_float_format);
 			tls_serialization_float_format = NULL;
 		}
 		if (double_format)
 		{
-			char *p = strdup(double_format);
+			char *p = json_c_strdup(double_format);
 			if (p == NULL)
 			{
 				_json_c_set_last_err("json_c_set_serialization_double_format: "
@@ -1184,7 +1333,7 @@ struct json_object *json_object_new_double_s(double d, const char *ds)
 	if (!jso)
 		return NULL;
 
-	new_ds = strdup(ds);
+	new_ds = json_c_strdup(ds);
 	if (!new_ds)
 	{
 		json_object_generic_delete(jso);
@@ -1217,7 +1366,7 @@ int json_object_userdata_to_json_string(struct json_object *jso, struct printbuf
 
 void json_object_free_userdata(struct json_object *jso, void *userdata)
 {
-	free(userdata);
+	json_c_free(userdata);
 }
 
 double json_object_get_double(const struct json_object *jso)
@@ -1307,7 +1456,7 @@ static int json_object_string_to_json_string(struct json_object *jso, struct pri
 static void json_object_string_delete(struct json_object *jso)
 {
 	if (JC_STRING(jso)->len < 0)
-		free(JC_STRING(jso)->c_string.pdata);
+		json_c_free(JC_STRING(jso)->c_string.pdata);
 	json_object_generic_delete(jso);
 }
 
@@ -1404,7 +1553,7 @@ static int _json_object_set_string_len(json_object *jso, const char *s, size_t l
 	curlen = JC_STRING(jso)->len;
 	if (curlen < 0) {
 		if (len == 0) {
-			free(JC_STRING(jso)->c_string.pdata);
+			json_c_free(JC_STRING(jso)->c_string.pdata);
 			JC_STRING(jso)->len = curlen = 0;
 		} else {
 			curlen = -curlen;
@@ -1419,11 +1568,11 @@ static int _json_object_set_string_len(json_object *jso, const char *s, size_t l
 		// We have no way to return the new ptr from realloc(jso, newlen)
 		// and we have no way of knowing whether there's extra room available
 		// so we need to stuff a pointer in to pdata :(
-		dstbuf = (char *)malloc(len + 1);
+		dstbuf = (char *)json_c_malloc(len + 1);
 		if (dstbuf == NULL)
 			return 0;
 		if (JC_STRING(jso)->len < 0)
-			free(JC_STRING(jso)->c_string.pdata);
+			json_c_free(JC_STRING(jso)->c_string.pdata);
 		JC_STRING(jso)->c_string.pdata = dstbuf;
 		newlen = -(ssize_t)len;
 	}
@@ -1500,9 +1649,26 @@ static void json_object_array_entry_free(void *data)
 	json_object_put((struct json_object *)data);
 }
 
-static void json_object_array_delete(struct json_object *jso)
+static void json_object_array_delete(struct json_object *jso, struct json_object **worklist)
 {
-	array_list_free(JC_ARRAY(jso)->c_array);
+	struct array_list *arr = JC_ARRAY(jso)->c_array;
+	size_t ii;
+
+	if (arr->free_fn != json_object_array_entry_free)
+	{
+		array_list_free(arr);
+		json_object_generic_delete(jso);
+		return;
+	}
+	/* Same as array_list_free(), but without recursing into the elements */
+	for (ii = 0; ii < arr->length; ii++)
+	{
+		if (ii + 1 < arr->length)
+			json_object_prefetch(arr->array[ii + 1]);
+		json_object_release_child((struct json_object *)arr->array[ii], worklist);
+	}
+	json_c_free(arr->array);
+	json_c_free(arr);
 	json_object_generic_delete(jso);
 }
 
@@ -1518,7 +1684,7 @@ struct json_object *json_object_new_array_ext(int initial_size)
 	jso->c_array = array_list_new2(&json_object_array_entry_free, initial_size);
 	if (jso->c_array == NULL)
 	{
-		free(jso);
+		json_c_free(jso);
 		return NULL;
 	}
 	return &jso->base;
@@ -1714,7 +1880,7 @@ static int json_object_copy_serializer_data(struct json_object *src, struct json
 	{
 		char *p;
 		assert(src->_userdata);
-		p = strdup(src->_userdata);
+		p = json_c_strdup(src->_userdata);
 		if (p == NULL)
 		{
 			_json_c_set_last_err("json_object_copy_serializer_data: out of memory\n");
@@ -1894,6 +2060,520 @@ int json_object_deep_copy(struct json_object *src, struct json_object **dst,
 	return rc;
 }
 
+/*
+ * json_object_compact() and its helpers.
+ *
+ * Objects are moved by allocating a copy and pointing the parent at it.
+ * The old memory is only freed at the very end, so that the new allocations
+ * aren't simply placed back into the holes left by the old ones.
+ *
+ * Neither counting nor moving recurses: both keep the containers they have
+ * yet to finish in heap memory, so any tree that could be built can be
+ * compacted, however deeply it's nested.
+ */
+
+/* An object or array whose children json_object_compact() is moving */
+struct json_object_compact_frame
+{
+	struct json_object *jso;
+	struct lh_entry *ent; /* The next member of an object */
+	size_t idx;           /* The next element of an array */
+};
+
+struct json_object_compact_state
+{
+	void **pending; /* Old allocations, to be freed once everything has moved */
+	size_t npending;
+	/* The containers from the root down to the one whose children are being moved */
+	struct json_object_compact_frame *stack;
+	size_t depth, stack_size;
+	int failed;
+};
+
+/*
+ * The smallest table size that holds count entries without
+ * lh_table_insert_w_hash() needing to resize it.
+ */
+static int json_object_lh_ideal_size(int count)
+{
+	double size = count / LH_LOAD_FACTOR + 1;
+
+	return size > INT_MAX ? INT_MAX : (int)size;
+}
+
+static size_t json_object_string_objsize(size_t len)
+{
+	size_t objsize = (sizeof(struct json_object_string) -
+	                  sizeof(((struct json_object_string *)NULL)->c_string)) +
+	                 len + 1;
+	if (len < sizeof(void *))
+		objsize += sizeof(void *) - len;
+	return objsize;
+}
+
+/* Return whether jso may be moved, i.e. nothing but its parent can be pointing at it */
+static int json_object_is_movable(const struct json_object *jso)
+{
+	if (jso->_ref_count != 1)
+		return 0;
+	/* Other userdata might refer back to the object */
+	return jso->_userdata == NULL ||
+	       (jso->_user_delete == json_object_free_userdata &&
+	        jso->_to_json_string == _json_object_userdata_to_json_string);
+}
+
+/*
+ * An upper bound of the number of allocations that compacting jso could
+ * replace, or 0 if memory to count them couldn't be allocated.
+ */
+static size_t json_object_compact_count(struct json_object *jso)
+{
+	struct array_list *stack = array_list_new2(NULL, 64);
+	size_t count = 0;
+	size_t ii;
+
+	if (stack == NULL || array_list_add(stack, jso) != 0)
+		goto fail;
+	while (stack->length > 0)
+	{
+		jso = (struct json_object *)stack->array[--stack->length];
+		/* The object itself, its userdata and its string data or container */
+		count += 3;
+		switch (json_object_get_type(jso))
+		{
+		case json_type_object:
+		{
+			struct lh_entry *ent;
+
+			for (ent = lh_table_head(JC_OBJECT(jso)->c_object); ent;
+			     ent = lh_entry_next(ent))
+			{
+				count++;
+				if (array_list_add(stack, lh_entry_v(ent)) != 0)
+					goto fail;
+			}
+			break;
+		}
+		case json_type_array:
+			count++;
+			for (ii = 0; ii < json_object_array_length(jso); ii++)
+			{
+				if (array_list_add(stack, json_object_array_get_idx(jso, ii)) != 0)
+					goto fail;
+			}
+			break;
+		default: break;
+		}
+	}
+	array_list_free(stack);
+	return count;
+fail:
+	if (stack != NULL)
+		array_list_free(stack);
+	return 0;
+}
+
+static void json_object_compact_defer(struct json_object_compact_state *st, void *old)
+{
+	st->pending[st->npending++] = old;
+}
+
+/*
+ * Move a child of an object or array, returning its new location.
+ * What it owns is left for json_object_compact_contents().
+ */
+static struct json_object *json_object_compact_child(struct json_object *jso,
+                                                     struct json_object_compact_state *st)
+{
+	struct json_object *moved;
+	size_t objsize;
+
+	if (!json_object_is_movable(jso))
+		return jso;
+
+	switch (jso->o_type)
+	{
+	case json_type_object: objsize = sizeof(struct json_object_object); break;
+	case json_type_array: objsize = sizeof(struct json_object_array); break;
+	case json_type_boolean: objsize = sizeof(struct json_object_boolean); break;
+	case json_type_double: objsize = sizeof(struct json_object_double); break;
+	case json_type_int: objsize = sizeof(struct json_object_int); break;
+	case json_type_string:
+		objsize = json_object_string_objsize(_json_object_get_string_len(JC_STRING(jso)));
+		break;
+	default: json_abort("invalid o_type");
+	}
+
+	moved = (struct json_object *)json_c_malloc(objsize);
+	if (moved == NULL)
+	{
+		st->failed = 1;
+		return jso;
+	}
+	if (jso->o_type == json_type_string && JC_STRING(jso)->len < 0)
+	{
+		/* Bring string data that json_object_set_string() moved out back inline */
+		ssize_t len = -JC_STRING(jso)->len;
+
+		memcpy(moved, jso, offsetof(struct json_object_string, c_string));
+		memcpy(JC_STRING(moved)->c_string.idata, JC_STRING(jso)->c_string.pdata, len + 1);
+		JC_STRING(moved)->len = len;
+		json_object_compact_defer(st, JC_STRING(jso)->c_string.pdata);
+	}
+	else
+	{
+		memcpy(moved, jso, objsize);
+	}
+	json_object_compact_defer(st, jso);
+	return moved;
+}
+
+/*
+ * Compact the buffers that jso owns, and push it onto st->stack if it's an
+ * object or array, for json_object_compact_tree() to move its children.
+ */
+static void json_object_compact_contents(struct json_object *jso,
+                                         struct json_object_compact_state *st)
+{
+	struct json_object_compact_frame *frame;
+
+	printbuf_free(jso->_pb);
+	jso->_pb = NULL;
+
+	if (jso->_userdata != NULL && jso->_to_json_string == _json_object_userdata_to_json_string)
+	{
+		char *ds = json_c_strdup((const char *)jso->_userdata);
+		if (ds != NULL)
+		{
+			json_object_compact_defer(st, jso->_userdata);
+			jso->_userdata = ds;
+		}
+		else
+			st->failed = 1;
+	}
+
+	switch (jso->o_type)
+	{
+	case json_type_object:
+	{
+		struct lh_table *t = JC_OBJECT(jso)->c_object;
+		struct lh_table *new_t = json_c_malloc(sizeof(*t));
+
+		if (new_t != NULL)
+		{
+			memcpy(new_t, t, sizeof(*t));
+			json_object_compact_defer(st, t);
+			JC_OBJECT(jso)->c_object = t = new_t;
+		}
+		else
+			st->failed = 1;
+		/* This also gets rid of any LH_FREED slots */
+		if (lh_table_resize(t, json_object_lh_ideal_size(t->count)) != 0)
+			st->failed = 1;
+		break;
+	}
+	case json_type_array:
+	{
+		struct array_list *arr = JC_ARRAY(jso)->c_array;
+		struct array_list *new_arr = json_c_malloc(sizeof(*arr));
+		size_t size = arr->length > 0 ? arr->length : 1;
+		void **new_array;
+
+		if (new_arr != NULL)
+		{
+			memcpy(new_arr, arr, sizeof(*arr));
+			json_object_compact_defer(st, arr);
+			JC_ARRAY(jso)->c_array = arr = new_arr;
+		}
+		else
+			st->failed = 1;
+		new_array = json_c_malloc(size * sizeof(void *));
+		if (new_array != NULL)
+		{
+			memcpy(new_array, arr->array, arr->length * sizeof(void *));
+			json_object_compact_defer(st, arr->array);
+			arr->array = new_array;
+			arr->size = size;
+		}
+		else
+			st->failed = 1;
+		break;
+	}
+	default: return;
+	}
+
+	if (st->depth == st->stack_size)
+	{
+		size_t new_size = st->stack_size * 2;
+		struct json_object_compact_frame *new_stack =
+		    json_c_realloc(st->stack, new_size * sizeof(*new_stack));
+
+		/* Its children stay where they are, which is still a valid tree */
+		if (new_stack == NULL)
+		{
+			st->failed = 1;
+			return;
+		}
+		st->stack = new_stack;
+		st->stack_size = new_size;
+	}
+	frame = &st->stack[st->depth++];
+	frame->jso = jso;
+	frame->ent = (jso->o_type == json_type_object) ? lh_table_head(JC_OBJECT(jso)->c_object)
+	                                                : NULL;
+	frame->idx = 0;
+}
+
+/*
+ * Compact jso and everything below it, depth first, so that each child's
+ * new allocations follow its parent's and precede its next sibling's.
+ */
+static void json_object_compact_tree(struct json_object *jso,
+                                     struct json_object_compact_state *st)
+{
+	json_object_compact_contents(jso, st);
+	while (st->depth > 0)
+	{
+		struct json_object_compact_frame *frame = &st->stack[st->depth - 1];
+		struct json_object *child;
+
+		if (frame->jso->o_type == json_type_object)
+		{
+			struct lh_entry *ent = frame->ent;
+
+			if (ent == NULL)
+			{
+				st->depth--;
+				continue;
+			}
+			frame->ent = lh_entry_next(ent);
+			if (!lh_entry_k_is_constant(ent))
+			{
+				char *k = json_c_strdup((const char *)lh_entry_k(ent));
+				if (k != NULL)
+				{
+					json_object_compact_defer(st, lh_entry_k(ent));
+					ent->k = k;
+				}
+				else
+					st->failed = 1;
+			}
+			child = (struct json_object *)lh_entry_v(ent);
+			if (child != NULL)
+			{
+				child = json_object_compact_child(child, st);
+				lh_entry_set_val(ent, child);
+			}
+		}
+		else
+		{
+			struct array_list *arr = JC_ARRAY(frame->jso)->c_array;
+
+			if (frame->idx == arr->length)
+			{
+				st->depth--;
+				continue;
+			}
+			child = (struct json_object *)arr->array[frame->idx];
+			if (child != NULL)
+			{
+				child = json_object_compact_child(child, st);
+				arr->array[frame->idx] = child;
+			}
+			frame->idx++;
+		}
+		/* This may move st->stack, so frame mustn't be used after it */
+		if (child != NULL)
+			json_object_compact_contents(child, st);
+	}
+}
+
+int json_object_compact(struct json_object *jso)
+{
+	struct json_object_compact_state st;
+	size_t count, ii;
+
+	if (jso == NULL)
+		return 0;
+
+	st.npending = 0;
+	st.failed = 0;
+	st.depth = 0;
+	st.stack_size = 16;
+	count = json_object_compact_count(jso);
+	st.pending = count > 0 ? json_c_malloc(count * sizeof(void *)) : NULL;
+	st.stack = json_c_malloc(st.stack_size * sizeof(*st.stack));
+	if (st.pending == NULL || st.stack == NULL)
+	{
+		json_c_free(st.pending);
+		json_c_free(st.stack);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	json_object_compact_tree(jso, &st);
+
+	for (ii = 0; ii < st.npending; ii++)
+		json_c_free(st.pending[ii]);
+	json_c_free(st.pending);
+	json_c_free(st.stack);
+	if (st.failed)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * json_object_memory_usage() and its helpers.
+ */
+
+/* Account for jso itself, and push its children onto the stack */
+static int json_object_memory_usage_node(struct json_object *jso, struct array_list *stack,
+                                         struct json_object_memory_stats *stats)
+{
+	int movable = json_object_is_movable(jso);
+	size_t node_bytes;
+	size_t ii;
+
+	if (jso->_pb != NULL)
+	{
+		size_t pb_bytes = sizeof(struct printbuf) + jso->_pb->size;
+
+		stats->printbuf_bytes += pb_bytes;
+		stats->compact_savings += pb_bytes;
+	}
+	if (jso->_userdata != NULL && jso->_user_delete == json_object_free_userdata &&
+	    jso->_to_json_string == _json_object_userdata_to_json_string)
+		stats->string_bytes += strlen((const char *)jso->_userdata) + 1;
+
+	switch (jso->o_type)
+	{
+	case json_type_object:
+	{
+		struct lh_table *t = JC_OBJECT(jso)->c_object;
+		int ideal = json_object_lh_ideal_size(t->count);
+		struct lh_entry *ent;
+
+		node_bytes = sizeof(struct json_object_object);
+		stats->table_bytes += sizeof(struct lh_table) + t->size * sizeof(struct lh_entry);
+		stats->table_unused_bytes += (size_t)(t->size - t->count) * sizeof(struct lh_entry);
+		if (t->size > ideal)
+			stats->compact_savings +=
+			    (size_t)(t->size - ideal) * sizeof(struct lh_entry);
+		for (ent = lh_table_head(t); ent; ent = lh_entry_next(ent))
+		{
+			if (!lh_entry_k_is_constant(ent))
+				stats->key_bytes += strlen((const char *)lh_entry_k(ent)) + 1;
+			if (lh_entry_v(ent) != NULL && array_list_add(stack, lh_entry_v(ent)) != 0)
+				return -1;
+		}
+		break;
+	}
+	case json_type_array:
+	{
+		struct array_list *arr = JC_ARRAY(jso)->c_array;
+		size_t ideal = arr->length > 0 ? arr->length : 1;
+
+		node_bytes = sizeof(struct json_object_array);
+		stats->array_bytes += sizeof(struct array_list) + arr->size * sizeof(void *);
+		stats->array_unused_bytes += (arr->size - arr->length) * sizeof(void *);
+		if (arr->size > ideal)
+			stats->compact_savings += (arr->size - ideal) * sizeof(void *);
+		for (ii = 0; ii < arr->length; ii++)
+		{
+			if (arr->array[ii] != NULL && array_list_add(stack, arr->array[ii]) != 0)
+				return -1;
+		}
+		break;
+	}
+	case json_type_boolean: node_bytes = sizeof(struct json_object_boolean); break;
+	case json_type_double: node_bytes = sizeof(struct json_object_double); break;
+	case json_type_int: node_bytes = sizeof(struct json_object_int); break;
+	case json_type_string:
+	{
+		size_t len = _json_object_get_string_len(JC_STRING(jso));
+
+		if (JC_STRING(jso)->len >= 0)
+		{
+			node_bytes = json_object_string_objsize(len);
+			break;
+		}
+		/*
+		 * The size the object was created with is no longer known, so this
+		 * is a lower bound, as is len + 1 for the separate buffer, which
+		 * might have been allocated for a longer string.
+		 */
+		node_bytes = json_object_string_objsize(0);
+		stats->string_bytes += len + 1;
+		if (movable && node_bytes + len + 1 > json_object_string_objsize(len))
+			stats->compact_savings +=
+			    node_bytes + len + 1 - json_object_string_objsize(len);
+		break;
+	}
+	default: json_abort("invalid o_type");
+	}
+
+	stats->count[jso->o_type]++;
+	stats->node_bytes[jso->o_type] += node_bytes;
+	return 0;
+}
+
+int json_object_memory_usage(struct json_object *jso, struct json_object_memory_stats *stats)
+{
+	struct array_list *stack;
+	struct lh_table *seen = NULL;
+	int rc = 0;
+	int ii;
+
+	memset(stats, 0, sizeof(*stats));
+	if (jso == NULL)
+		return 0;
+
+	/* An explicit stack, so that deeply nested trees can't overflow the real one */
+	stack = array_list_new2(NULL, 64);
+	if (stack == NULL || array_list_add(stack, jso) != 0)
+		rc = -1;
+	while (rc == 0 && stack->length > 0)
+	{
+		jso = (struct json_object *)stack->array[--stack->length];
+
+		/* Only objects with several references can be reached more than once */
+		if (jso->_ref_count > 1)
+		{
+			if (seen == NULL && (seen = lh_kptr_table_new(16, NULL)) == NULL)
+			{
+				rc = -1;
+				break;
+			}
+			if (lh_table_lookup_entry(seen, jso) != NULL)
+				continue;
+			if (lh_table_insert(seen, jso, NULL) != 0)
+			{
+				rc = -1;
+				break;
+			}
+		}
+		rc = json_object_memory_usage_node(jso, stack, stats);
+	}
+	if (stack != NULL)
+		array_list_free(stack);
+	if (seen != NULL)
+		lh_table_free(seen);
+	if (rc != 0)
+	{
+		errno = ENOMEM;
+		return -1;
+	}
+
+	for (ii = 0; ii <= json_type_string; ii++)
+		stats->total_bytes += stats->node_bytes[ii];
+	stats->total_bytes += stats->table_bytes + stats->array_bytes + stats->key_bytes +
+	                      stats->string_bytes + stats->printbuf_bytes;
+	return 0;
+}
+
 static void json_abort(const char *message)
 {
 	if (message != NULL)
@@ -174,12 +174,49 @@ JSON_EXPORT struct json_object *json_object_get(struct json_object *obj);
  *
  * NULL may be passed, in which case this is a no-op.
  *
+ * Freeing an object does not recurse into its members, so arbitrarily
+ * deeply nested objects can be freed with a fixed amount of stack space.
+ *
  * @param obj the json_object instance
  * @returns 1 if the object was freed, 0 if only the refcount was decremented
  * @see json_object_get()
+ * @see json_object_put_deferred()
  */
 JSON_EXPORT int json_object_put(struct json_object *obj);
 
+/**
+ * Like json_object_put(), but when the last reference goes away, instead of
+ * freeing obj and everything in it right away, add it to a list of objects
+ * to be freed later by json_c_reclaim_deferred().
+ *
+ * This moves the cost of tearing down large trees off of latency sensitive
+ * code paths.  The object's user delete function (see
+ * json_object_set_userdata()) is still called immediately, and obj must not
+ * be used after this returns, just as with json_object_put().
+ *
+ * When built with atomic builtins, this may be called from several threads
+ * at once, and concurrently with json_c_reclaim_deferred().
+ *
+ * @param obj the json_object instance
+ * @returns 1 if the object was queued to be freed, 0 if only the refcount
+ *          was decremented
+ */
+JSON_EXPORT int json_object_put_deferred(struct json_object *obj);
+
+/**
+ * Free objects that were passed to json_object_put_deferred().
+ *
+ * json-c does not create any threads of its own; call this periodically from
+ * a background thread, or from an idle point of the main loop.  Only one
+ * thread may call this at a time.
+ *
+ * @param max_objects the maximum number of json_object values to free in
+ *        this call, counting each member of a container separately, to bound
+ *        the time spent.  0 frees everything queued so far.
+ * @returns the number of json_object values that were freed
+ */
+JSON_EXPORT size_t json_c_reclaim_deferred(size_t max_objects);
+
 /**
  * Check if the json_object is of a given type
  * @param obj the json_object instance
@@ -324,6 +361,10 @@ JSON_EXPORT void json_object_set_serializer(json_object *jso,
  * Simply call free on the userdata pointer.
  * Can be used with json_object_set_serializer().
  *
+ * If json_c_set_alloc_funcs() was used to replace free(), the replacement
+ * is called instead, so userdata must have been allocated with the
+ * matching function (see json_c_get_alloc_funcs()).
+ *
  * @param jso unused
  * @param userdata the pointer that is passed to free().
  */
@@ -1110,6 +1151,97 @@ JSON_EXPORT json_c_shallow_copy_fn json_c_shallow_copy_default;
 
 JSON_EXPORT int json_object_deep_copy(struct json_object *src, struct json_object **dst,
                                       json_c_shallow_copy_fn *shallow_copy);
+
+/**
+ * Reorganize the memory used by a tree of objects, to reduce its size and
+ * improve locality, e.g. for a long lived document that has been built up or
+ * modified by many separate edits.
+ *
+ * This:
+ * - moves each object, along with its hash table or array, its keys and its
+ *   string data, to a new allocation, in depth-first order, so that objects
+ *   that are visited together end up close together in memory,
+ * - rebuilds each object's hash table at the smallest size that holds its
+ *   members, which also drops any slots left behind by deleted members,
+ * - shrinks each array to exactly its length, like json_object_array_shrink(),
+ * - moves string data that json_object_set_string() placed in a separate
+ *   allocation back into the object, and
+ * - discards the cached results of json_object_to_json_string().
+ *
+ * Objects with a reference count greater than one, as well as objects with
+ * userdata (other than that set by json_object_new_double_s()), can't be
+ * moved, as there may be other pointers to them.  Their contents are
+ * compacted just the same.  jso itself is never moved.
+ *
+ * All other pointers into the tree, such as ones returned by
+ * json_object_object_get(), json_object_array_get_idx(), json_object_get_object(),
+ * json_object_get_string() or a json_object_iterator, are invalidated.
+ * Take a reference with json_object_get() on any object that must
+ * stay where it is.
+ *
+ * Since tables and arrays are left with little or no spare room, adding to
+ * them afterwards will soon cause them to be resized.
+ *
+ * @param jso the root of the tree to compact
+ * @returns 0 on success, or -1 if memory ran out.  In that case some parts
+ *          of the tree might not have been compacted, but it remains valid.
+ */
+JSON_EXPORT int json_object_compact(struct json_object *jso);
+
+/**
+ * Memory used by a tree of json_objects, as reported by json_object_memory_usage().
+ *
+ * Sizes are in bytes, and count what json-c requested from malloc(), not
+ * any overhead of the allocator itself.
+ */
+struct json_object_memory_stats
+{
+	/** The number of json_object values of each type, indexed by enum json_type */
+	size_t count[json_type_string + 1];
+	/** Memory used by the json_object values themselves, indexed by enum json_type */
+	size_t node_bytes[json_type_string + 1];
+	/** Memory used by the hash tables of objects, including empty slots */
+	size_t table_bytes;
+	/** The part of table_bytes used by empty or deleted slots */
+	size_t table_unused_bytes;
+	/** Memory used by the element arrays of arrays, including spare capacity */
+	size_t array_bytes;
+	/** The part of array_bytes used by spare capacity */
+	size_t array_unused_bytes;
+	/** Memory used by object keys, except for JSON_C_OBJECT_ADD_CONSTANT_KEY keys */
+	size_t key_bytes;
+	/**
+	 * Memory used by string data held outside of the json_object, i.e. after
+	 * json_object_set_string() grew a string, and by the original text
+	 * of doubles created by json_object_new_double_s() or the parser.
+	 */
+	size_t string_bytes;
+	/** Memory used by output cached by json_object_to_json_string() */
+	size_t printbuf_bytes;
+	/** The sum of all of the above */
+	size_t total_bytes;
+	/**
+	 * An estimate of how much of total_bytes json_object_compact() would
+	 * release.  This doesn't include the (often larger) gain from undoing
+	 * heap fragmentation, which can't be measured from here.
+	 */
+	size_t compact_savings;
+};
+
+/**
+ * Measure the memory used by jso and everything below it, in one pass
+ * over the tree.
+ *
+ * Objects that are reachable more than once are counted once.
+ * Userdata set by json_object_set_userdata() is not included, as json-c
+ * doesn't know its size.
+ *
+ * @param jso the root of the tree, may be NULL
+ * @param stats filled in with the results
+ * @returns 0 on success, or -1 if memory for the traversal ran out
+ */
+JSON_EXPORT int json_object_memory_usage(struct json_object *jso,
+                                         struct json_object_memory_stats *stats);
 #ifdef __cplusplus
 }
 #endif
@@ -96,6 +96,21 @@ struct json_object_string
 	} c_string;
 };
 
+/*
+ * For json_object_object_add_ex(), only within json-c: the key was allocated
+ * with json_c_malloc() and the object takes it over instead of copying it.
+ * It is freed if it replaces the value of an existing key, or on failure.
+ */
+#define JSON_C_OBJECT_ADD_TAKE_KEY (1U << 31)
+
+/*
+ * For json_object_object_add_ex() and lh_table_insert_w_hash(), only within
+ * json-c: don't replace the value of an existing key, but leave the object
+ * as it is and return 1.  The key is looked for while probing for a free
+ * slot to insert it into, rather than by a separate lookup beforehand.
+ */
+#define JSON_C_OBJECT_ADD_IF_NEW (1U << 30)
+
 void _json_c_set_last_err(const char *err_fmt, ...);
 
 extern const char *json_hex_chars;
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ */
+
+/**
+ * @file
+ * @brief Do not use, json-c internal, may be changed or removed at any time.
+ */
+#ifndef _json_probes_private_h_
+#define _json_probes_private_h_
+
+/*
+ * Static tracepoints (USDT), for bpftrace, perf, SystemTap and the like.
+ *
+ * They are only compiled in when json-c is built with the ENABLE_USDT cmake
+ * option, which needs <sys/sdt.h>.  Otherwise the macros expand to nothing
+ * and their arguments aren't evaluated.  Even when compiled in, a probe
+ * that isn't being traced costs a single nop.
+ *
+ * All probes are in the "json_c" provider.  bpftrace, perf and SystemTap
+ * use the names below as they are, DTrace shows each "__" as a "-":
+ *
+ *   parse__start(tok, len)              json_tokener_parse_ex() was called
+ *   parse__done(tok, consumed, err)     it's returning, err is a json_tokener_error
+ *   serialize__start(jso, flags)        json_object_to_json_string_length()
+ *   serialize__done(jso, length)        length is 0 on failure
+ *   table__resize__start(t, count, old_size, new_size)
+ *   table__resize__done(t, new_size, ok)
+ *   printbuf__extend__start(p, used, old_size, new_size)
+ *   printbuf__extend__done(p, new_size, ok)
+ *   free__start(jso, type)              json_object_put() is freeing jso
+ *   free__done(jso, nfreed)             it freed nfreed objects, jso included
+ *
+ * For instance, to get a histogram of parse times:
+ *
+ *   bpftrace -e 'usdt:./libjson-c.so:json_c:parse__start { @t[tid] = nsecs; }
+ *       usdt:./libjson-c.so:json_c:parse__done /@t[tid]/ {
+ *       @ns = hist(nsecs - @t[tid]); delete(@t[tid]); }'
+ */
+
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+
+#define JSON_C_PROBE2(name, a1, a2) DTRACE_PROBE2(json_c, name, a1, a2)
+#define JSON_C_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(json_c, name, a1, a2, a3)
+#define JSON_C_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(json_c, name, a1, a2, a3, a4)
+
+#else
+
+#define JSON_C_PROBE2(name, a1, a2) \
+	do                          \
+	{                           \
+	} while (0)
+#define JSON_C_PROBE3(name, a1, a2, a3) JSON_C_PROBE2(name, a1, a2)
+#define JSON_C_PROBE4(name, a1, a2, a3, a4) JSON_C_PROBE2(name, a1, a2)
+
+#endif
+
+#endif
@@ -0,0 +1,843 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_alloc_private.h"
+#include "json_object.h"
+#include "json_object_private.h"
+#include "json_snapshot.h"
+#include "linkhash.h"
+#include "printbuf.h"
+
+/*
+ * Layout of a snapshot.
+ *
+ * Everything is stored in the native byte order, and every node starts at an
+ * offset that is a multiple of 8, so all fields can be read in place.
+ *
+ *   header      struct json_snapshot
+ *   node...     written in post-order, so every node only refers to nodes
+ *               at lower offsets.  This is what guarantees that the
+ *               accessors can't be sent around in circles by a corrupt file.
+ *
+ * Each node begins with a struct snap_node, followed by:
+ *   boolean     nothing, count holds the value
+ *   int         an int64_t or uint64_t (count is SNAP_INT_UNSIGNED for the latter)
+ *   double      a double
+ *   string      count bytes of string data, a nul terminator, then padding
+ *   array       count uint64_t element offsets
+ *   object      count struct snap_member entries in insertion order, followed
+ *               by count uint32_t indexes into those entries, sorted by key,
+ *               then padding.  Keys are string nodes, shared between all
+ *               objects that use the same key.
+ *
+ * An offset of 0 stands for a null value.
+ */
+
+#define SNAP_MAGIC 0x4a43534eU /* "JCSN" */
+#define SNAP_BYTE_ORDER 0x01020304U
+#define SNAP_ALIGN 8
+#define SNAP_INT_UNSIGNED 1
+
+struct json_snapshot
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t reserved;
+	uint64_t size;
+	uint64_t root;
+};
+
+struct snap_node
+{
+	uint32_t type;
+	uint32_t count;
+};
+
+struct snap_member
+{
+	uint64_t key;
+	uint64_t val;
+};
+
+/*
+ * Writer
+ */
+
+struct snap_writer
+{
+	struct printbuf *pb;
+	/* Maps key strings to the offset of the string node holding them */
+	struct lh_table *keys;
+};
+
+struct snap_sort_ent
+{
+	const char *key;
+	uint32_t idx;
+};
+
+static int snap_pad(struct printbuf *pb)
+{
+	int pad = (SNAP_ALIGN - (pb->bpos % SNAP_ALIGN)) % SNAP_ALIGN;
+	if (pad == 0)
+		return 0;
+	return printbuf_memset(pb, -1, 0, pad);
+}
+
+static int snap_append(struct printbuf *pb, const void *data, size_t len)
+{
+	if (len == 0)
+		return 0;
+	if (len > INT_MAX)
+		return -1;
+	return printbuf_memappend(pb, (const char *)data, (int)len) < 0 ? -1 : 0;
+}
+
+static int snap_write_node(struct printbuf *pb, enum json_type type, uint32_t count, uint64_t *off)
+{
+	struct snap_node node;
+
+	node.type = (uint32_t)type;
+	node.count = count;
+	*off = (uint64_t)pb->bpos;
+	return snap_append(pb, &node, sizeof(node));
+}
+
+static int snap_write_string(struct printbuf *pb, const char *str, size_t len, uint64_t *off)
+{
+	if (len > UINT32_MAX)
+		return -1;
+	if (snap_write_node(pb, json_type_string, (uint32_t)len, off) < 0 ||
+	    snap_append(pb, str, len) < 0 || printbuf_memset(pb, -1, 0, 1) < 0)
+		return -1;
+	return snap_pad(pb);
+}
+
+static int snap_write_key(struct snap_writer *w, const char *key, uint64_t *off)
+{
+	void *v;
+
+	if (lh_table_lookup_ex(w->keys, key, &v))
+	{
+		*off = (uint64_t)(uintptr_t)v;
+		return 0;
+	}
+	if (snap_write_string(w->pb, key, strlen(key), off) < 0)
+		return -1;
+	return lh_table_insert(w->keys, key, (void *)(uintptr_t)*off);
+}
+
+static int snap_sort_cmp(const void *a, const void *b)
+{
+	const struct snap_sort_ent *ea = a;
+	const struct snap_sort_ent *eb = b;
+	int rc = strcmp(ea->key, eb->key);
+
+	if (rc != 0)
+		return rc;
+	/* Keep duplicate keys (from JSON_C_OBJECT_ADD_KEY_IS_NEW) in insertion order */
+	return (ea->idx > eb->idx) - (ea->idx < eb->idx);
+}
+
+/* An array or object whose children snap_write_value() is writing */
+struct snap_write_frame
+{
+	struct json_object *jso;
+	uint64_t *off; /* Where to store the offset of its node once written */
+	size_t idx, count;
+	struct lh_entry *ent; /* The next member of an object */
+	uint64_t *elems;
+	struct snap_member *members;
+	struct snap_sort_ent *sorted;
+};
+
+static void snap_frame_free(struct snap_write_frame *f)
+{
+	json_c_free(f->elems);
+	json_c_free(f->members);
+	json_c_free(f->sorted);
+}
+
+static int snap_frame_init(struct snap_write_frame *f, struct json_object *jso, uint64_t *off)
+{
+	memset(f, 0, sizeof(*f));
+	f->jso = jso;
+	f->off = off;
+	if (json_object_is_type(jso, json_type_array))
+	{
+		f->count = json_object_array_length(jso);
+		if (f->count > UINT32_MAX)
+			return -1;
+		if (f->count > 0)
+			f->elems = json_c_malloc(f->count * sizeof(*f->elems));
+		return (f->count > 0 && f->elems == NULL) ? -1 : 0;
+	}
+	f->count = (size_t)json_object_object_length(jso);
+	f->ent = lh_table_head(json_object_get_object(jso));
+	if (f->count > UINT32_MAX)
+		return -1;
+	if (f->count > 0)
+	{
+		f->members = json_c_malloc(f->count * sizeof(*f->members));
+		f->sorted = json_c_malloc(f->count * sizeof(*f->sorted));
+		if (f->members == NULL || f->sorted == NULL)
+		{
+			snap_frame_free(f);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Write the node for an array or object, once all of its children have been written */
+static int snap_write_container(struct snap_writer *w, struct snap_write_frame *f)
+{
+	size_t ii;
+
+	if (json_object_is_type(f->jso, json_type_array))
+	{
+		if (snap_write_node(w->pb, json_type_array, (uint32_t)f->count, f->off) < 0)
+			return -1;
+		return snap_append(w->pb, f->elems, f->count * sizeof(*f->elems));
+	}
+
+	if (f->count > 1)
+		qsort(f->sorted, f->count, sizeof(*f->sorted), snap_sort_cmp);
+	if (snap_write_node(w->pb, json_type_object, (uint32_t)f->count, f->off) < 0 ||
+	    snap_append(w->pb, f->members, f->count * sizeof(*f->members)) < 0)
+		return -1;
+	for (ii = 0; ii < f->count; ii++)
+	{
+		if (snap_append(w->pb, &f->sorted[ii].idx, sizeof(uint32_t)) < 0)
+			return -1;
+	}
+	return snap_pad(w->pb);
+}
+
+static int snap_write_scalar(struct snap_writer *w, struct json_object *jso, uint64_t *off)
+{
+	switch (json_object_get_type(jso))
+	{
+	case json_type_null: *off = 0; return 0;
+	case json_type_boolean:
+	{
+		uint32_t val = json_object_get_boolean(jso) ? 1 : 0;
+
+		return snap_write_node(w->pb, json_type_boolean, val, off);
+	}
+	case json_type_int:
+	{
+		const struct json_object_int *jsoint = (const struct json_object_int *)jso;
+		uint32_t flags = 0;
+
+		if (jsoint->cint_type == json_object_int_type_uint64)
+			flags = SNAP_INT_UNSIGNED;
+		if (snap_write_node(w->pb, json_type_int, flags, off) < 0)
+			return -1;
+		return snap_append(w->pb, &jsoint->cint, sizeof(uint64_t));
+	}
+	case json_type_double:
+	{
+		double d = json_object_get_double(jso);
+
+		if (snap_write_node(w->pb, json_type_double, 0, off) < 0)
+			return -1;
+		return snap_append(w->pb, &d, sizeof(d));
+	}
+	case json_type_string:
+		return snap_write_string(w->pb, json_object_get_string(jso),
+		                         (size_t)json_object_get_string_len(jso), off);
+	default: return -1;
+	}
+}
+
+static int snap_is_container(struct json_object *jso)
+{
+	return json_object_is_type(jso, json_type_array) ||
+	       json_object_is_type(jso, json_type_object);
+}
+
+/*
+ * Write jso and everything below it in post-order, keeping the arrays and
+ * objects that are still being written on a stack of our own, so that
+ * there's no limit on how deeply they can be nested.
+ */
+static int snap_write_value(struct snap_writer *w, struct json_object *jso, uint64_t *off)
+{
+	struct snap_write_frame *stack;
+	size_t depth = 0, stack_size = 16;
+	int rc = -1;
+
+	if (!snap_is_container(jso))
+		return snap_write_scalar(w, jso, off);
+	if ((stack = json_c_malloc(stack_size * sizeof(*stack))) == NULL)
+		return -1;
+	if (snap_frame_init(&stack[0], jso, off) < 0)
+		goto out;
+	depth = 1;
+
+	while (depth > 0)
+	{
+		struct snap_write_frame *f = &stack[depth - 1];
+		struct json_object *val;
+		uint64_t *slot;
+
+		if (f->idx == f->count)
+		{
+			rc = snap_write_container(w, f);
+			snap_frame_free(f);
+			depth--;
+			if (rc < 0)
+				goto out;
+			continue;
+		}
+		if (json_object_is_type(f->jso, json_type_array))
+		{
+			val = json_object_array_get_idx(f->jso, f->idx);
+			slot = &f->elems[f->idx];
+		}
+		else
+		{
+			const char *key = (const char *)lh_entry_k(f->ent);
+
+			if (snap_write_key(w, key, &f->members[f->idx].key) < 0)
+				goto out;
+			f->sorted[f->idx].key = key;
+			f->sorted[f->idx].idx = (uint32_t)f->idx;
+			val = (struct json_object *)lh_entry_v(f->ent);
+			slot = &f->members[f->idx].val;
+			f->ent = lh_entry_next(f->ent);
+		}
+		f->idx++;
+
+		if (!snap_is_container(val))
+		{
+			if (snap_write_scalar(w, val, slot) < 0)
+				goto out;
+			continue;
+		}
+		if (depth == stack_size)
+		{
+			struct snap_write_frame *new_stack =
+			    json_c_realloc(stack, stack_size * 2 * sizeof(*new_stack));
+
+			if (new_stack == NULL)
+				goto out;
+			stack = new_stack;
+			stack_size *= 2;
+		}
+		if (snap_frame_init(&stack[depth], val, slot) < 0)
+			goto out;
+		depth++;
+	}
+	rc = 0;
+out:
+	while (depth > 0)
+		snap_frame_free(&stack[--depth]);
+	json_c_free(stack);
+	return rc;
+}
+
+int json_object_to_snapshot(struct json_object *jso, struct printbuf *pb)
+{
+	struct snap_writer w;
+	struct json_snapshot hdr;
+	uint64_t root = 0;
+	int rc;
+
+	if (pb == NULL || pb->bpos != 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SNAP_MAGIC;
+	hdr.version = JSON_SNAPSHOT_VERSION;
+	hdr.byte_order = SNAP_BYTE_ORDER;
+	if (snap_append(pb, &hdr, sizeof(hdr)) < 0)
+		return -1;
+
+	w.pb = pb;
+	w.keys = lh_kchar_table_new(JSON_OBJECT_DEF_HASH_ENTRIES, NULL);
+	if (w.keys == NULL)
+		return -1;
+	rc = snap_write_value(&w, jso, &root);
+	lh_table_free(w.keys);
+	if (rc < 0)
+		return -1;
+
+	/* Fill in the parts of the header that we know now */
+	hdr.size = (uint64_t)pb->bpos;
+	hdr.root = root;
+	memcpy(pb->buf, &hdr, sizeof(hdr));
+	return 0;
+}
+
+/*
+ * Reader
+ */
+
+const struct json_snapshot *json_snapshot_open(const void *buf, size_t size)
+{
+	const struct json_snapshot *snap = buf;
+
+	if (buf == NULL || ((uintptr_t)buf % SNAP_ALIGN) != 0 || size < sizeof(*snap))
+		return NULL;
+	if (snap->magic != SNAP_MAGIC || snap->version != JSON_SNAPSHOT_VERSION ||
+	    snap->byte_order != SNAP_BYTE_ORDER)
+		return NULL;
+	if (snap->size < sizeof(*snap) || snap->size > size)
+		return NULL;
+	if (snap->root != 0 && snap->root >= snap->size)
+		return NULL;
+	return snap;
+}
+
+json_snapshot_ref json_snapshot_root(const struct json_snapshot *snap)
+{
+	return snap ? snap->root : 0;
+}
+
+/*
+ * Return the node at ref, after checking that it and payload_size bytes
+ * following it fit within the snapshot.
+ */
+static const struct snap_node *snap_node_at(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	if (snap == NULL || ref < sizeof(*snap) || (ref % SNAP_ALIGN) != 0 ||
+	    ref > snap->size - sizeof(struct snap_node))
+		return NULL;
+	return (const struct snap_node *)((const char *)snap + ref);
+}
+
+static int snap_payload_fits(const struct json_snapshot *snap, json_snapshot_ref ref,
+                             uint64_t payload_size)
+{
+	return payload_size <= snap->size - ref - sizeof(struct snap_node);
+}
+
+static const struct snap_node *snap_node_of_type(const struct json_snapshot *snap,
+                                                 json_snapshot_ref ref, enum json_type type)
+{
+	const struct snap_node *node = snap_node_at(snap, ref);
+	uint64_t payload_size;
+
+	if (node == NULL || node->type != (uint32_t)type)
+		return NULL;
+	switch (type)
+	{
+	case json_type_int:
+	case json_type_double: payload_size = sizeof(uint64_t); break;
+	case json_type_string: payload_size = (uint64_t)node->count + 1; break;
+	case json_type_array: payload_size = (uint64_t)node->count * sizeof(uint64_t); break;
+	case json_type_object:
+		payload_size =
+		    (uint64_t)node->count * (sizeof(struct snap_member) + sizeof(uint32_t));
+		break;
+	default: payload_size = 0; break;
+	}
+	if (!snap_payload_fits(snap, ref, payload_size))
+		return NULL;
+	if (type == json_type_string && ((const char *)(node + 1))[node->count] != '\0')
+		return NULL;
+	return node;
+}
+
+/* Check that a child offset stored at parent refers backwards, as the writer guarantees. */
+static json_snapshot_ref snap_child(json_snapshot_ref parent, uint64_t child)
+{
+	return child < parent ? child : 0;
+}
+
+enum json_type json_snapshot_get_type(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node = snap_node_at(snap, ref);
+
+	if (node == NULL)
+		return json_type_null;
+	switch (node->type)
+	{
+	case json_type_boolean:
+	case json_type_double:
+	case json_type_int:
+	case json_type_object:
+	case json_type_array:
+	case json_type_string: return (enum json_type)node->type;
+	default: return json_type_null;
+	}
+}
+
+json_bool json_snapshot_get_boolean(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_boolean);
+
+	return node ? (node->count != 0) : 0;
+}
+
+int64_t json_snapshot_get_int64(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node;
+	uint64_t u;
+	int64_t i;
+	double d;
+
+	if ((node = snap_node_of_type(snap, ref, json_type_int)) != NULL)
+	{
+		if (node->count == SNAP_INT_UNSIGNED)
+		{
+			memcpy(&u, node + 1, sizeof(u));
+			return u > INT64_MAX ? INT64_MAX : (int64_t)u;
+		}
+		memcpy(&i, node + 1, sizeof(i));
+		return i;
+	}
+	if ((node = snap_node_of_type(snap, ref, json_type_double)) != NULL)
+	{
+		memcpy(&d, node + 1, sizeof(d));
+		if (d > (double)INT64_MAX)
+			return INT64_MAX;
+		if (d < (double)INT64_MIN || isnan(d))
+			return INT64_MIN;
+		return (int64_t)d;
+	}
+	return 0;
+}
+
+uint64_t json_snapshot_get_uint64(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node;
+	uint64_t u;
+	int64_t i;
+	double d;
+
+	if ((node = snap_node_of_type(snap, ref, json_type_int)) != NULL)
+	{
+		if (node->count == SNAP_INT_UNSIGNED)
+		{
+			memcpy(&u, node + 1, sizeof(u));
+			return u;
+		}
+		memcpy(&i, node + 1, sizeof(i));
+		return i < 0 ? 0 : (uint64_t)i;
+	}
+	if ((node = snap_node_of_type(snap, ref, json_type_double)) != NULL)
+	{
+		memcpy(&d, node + 1, sizeof(d));
+		if (d > (double)UINT64_MAX)
+			return UINT64_MAX;
+		if (d < 0 || isnan(d))
+			return 0;
+		return (uint64_t)d;
+	}
+	return 0;
+}
+
+double json_snapshot_get_double(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node;
+	uint64_t u;
+	int64_t i;
+	double d;
+
+	if ((node = snap_node_of_type(snap, ref, json_type_double)) != NULL)
+	{
+		memcpy(&d, node + 1, sizeof(d));
+		return d;
+	}
+	if ((node = snap_node_of_type(snap, ref, json_type_int)) != NULL)
+	{
+		if (node->count == SNAP_INT_UNSIGNED)
+		{
+			memcpy(&u, node + 1, sizeof(u));
+			return (double)u;
+		}
+		memcpy(&i, node + 1, sizeof(i));
+		return (double)i;
+	}
+	return 0.0;
+}
+
+const char *json_snapshot_get_string(const struct json_snapshot *snap, json_snapshot_ref ref,
+                                     size_t *len)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_string);
+
+	if (node == NULL)
+	{
+		if (len)
+			*len = 0;
+		return NULL;
+	}
+	if (len)
+		*len = node->count;
+	return (const char *)(node + 1);
+}
+
+size_t json_snapshot_length(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	const struct snap_node *node;
+
+	if ((node = snap_node_of_type(snap, ref, json_type_array)) != NULL ||
+	    (node = snap_node_of_type(snap, ref, json_type_object)) != NULL)
+		return node->count;
+	return 0;
+}
+
+json_snapshot_ref json_snapshot_array_get_idx(const struct json_snapshot *snap,
+                                              json_snapshot_ref ref, size_t idx)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_array);
+	uint64_t child;
+
+	if (node == NULL || idx >= node->count)
+		return 0;
+	memcpy(&child, (const uint64_t *)(node + 1) + idx, sizeof(child));
+	return snap_child(ref, child);
+}
+
+static const struct snap_member *snap_members(const struct snap_node *node)
+{
+	return (const struct snap_member *)(node + 1);
+}
+
+const char *json_snapshot_object_key_at(const struct json_snapshot *snap, json_snapshot_ref ref,
+                                        size_t idx)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_object);
+
+	if (node == NULL || idx >= node->count)
+		return NULL;
+	return json_snapshot_get_string(snap, snap_child(ref, snap_members(node)[idx].key), NULL);
+}
+
+json_snapshot_ref json_snapshot_object_value_at(const struct json_snapshot *snap,
+                                                json_snapshot_ref ref, size_t idx)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_object);
+
+	if (node == NULL || idx >= node->count)
+		return 0;
+	return snap_child(ref, snap_members(node)[idx].val);
+}
+
+json_bool json_snapshot_object_get_ex(const struct json_snapshot *snap, json_snapshot_ref ref,
+                                      const char *key, json_snapshot_ref *value)
+{
+	const struct snap_node *node = snap_node_of_type(snap, ref, json_type_object);
+	const struct snap_member *members;
+	const uint32_t *sorted;
+	size_t lo = 0, hi;
+
+	if (value)
+		*value = 0;
+	if (node == NULL || key == NULL)
+		return 0;
+	members = snap_members(node);
+	sorted = (const uint32_t *)(members + node->count);
+	hi = node->count;
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		uint32_t midx = sorted[mid];
+		const char *mkey;
+		int cmp;
+
+		if (midx >= node->count)
+			return 0;
+		mkey = json_snapshot_get_string(snap, snap_child(ref, members[midx].key), NULL);
+		if (mkey == NULL)
+			return 0;
+		cmp = strcmp(key, mkey);
+		if (cmp == 0)
+		{
+			if (value)
+				*value = snap_child(ref, members[midx].val);
+			return 1;
+		}
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return 0;
+}
+
+/*
+ * Create the json_object for the value at ref, with arrays and objects
+ * left empty for json_snapshot_to_json_object() to fill in.
+ */
+static struct json_object *snap_new_value(const struct json_snapshot *snap, json_snapshot_ref ref)
+{
+	struct json_object *jso;
+	const char *str;
+	size_t len;
+
+	switch (json_snapshot_get_type(snap, ref))
+	{
+	case json_type_boolean:
+		jso = json_object_new_boolean(json_snapshot_get_boolean(snap, ref));
+		break;
+	case json_type_double:
+		jso = json_object_new_double(json_snapshot_get_double(snap, ref));
+		break;
+	case json_type_int:
+		if (snap_node_at(snap, ref)->count == SNAP_INT_UNSIGNED)
+			jso = json_object_new_uint64(json_snapshot_get_uint64(snap, ref));
+		else
+			jso = json_object_new_int64(json_snapshot_get_int64(snap, ref));
+		break;
+	case json_type_string:
+		if ((str = json_snapshot_get_string(snap, ref, &len)) == NULL || len > INT_MAX)
+		{
+			errno = EINVAL;
+			return NULL;
+		}
+		jso = json_object_new_string_len(str, (int)len);
+		break;
+	case json_type_array:
+		jso = json_object_new_array_ext((int)json_snapshot_length(snap, ref));
+		break;
+	case json_type_object: jso = json_object_new_object(); break;
+	default: errno = EINVAL; return NULL;
+	}
+	if (jso == NULL)
+		errno = ENOMEM;
+	return jso;
+}
+
+/* An array or object that json_snapshot_to_json_object() is filling in */
+struct snap_convert_frame
+{
+	json_snapshot_ref ref;
+	struct json_object *jso;
+	size_t idx, len;
+};
+
+struct json_object *json_snapshot_to_json_object(const struct json_snapshot *snap,
+                                                 json_snapshot_ref ref)
+{
+	struct snap_convert_frame *stack = NULL;
+	struct json_object *root;
+	size_t max_nodes, nodes = 1;
+	size_t depth = 0, stack_size = 0;
+
+	if (snap_node_at(snap, ref) == NULL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+	/*
+	 * Values other than keys aren't shared in a snapshot written by
+	 * json_object_to_snapshot(), so it can't hold more of them than fit.
+	 * One whose arrays and objects point at the same children over and
+	 * over would otherwise expand into an enormous tree.
+	 */
+	max_nodes = snap->size / sizeof(struct snap_node);
+	if ((root = snap_new_value(snap, ref)) == NULL || !snap_is_container(root))
+		return root;
+	stack_size = 16;
+	if ((stack = json_c_malloc(stack_size * sizeof(*stack))) == NULL)
+	{
+		errno = ENOMEM;
+		goto fail;
+	}
+	stack[0].ref = ref;
+	stack[0].jso = root;
+	stack[0].idx = 0;
+	stack[0].len = json_snapshot_length(snap, ref);
+	depth = 1;
+
+	while (depth > 0)
+	{
+		struct snap_convert_frame *f = &stack[depth - 1];
+		json_snapshot_ref child;
+		struct json_object *val = NULL;
+		const char *key = NULL;
+		int rc;
+
+		if (f->idx == f->len)
+		{
+			depth--;
+			continue;
+		}
+		if (json_object_is_type(f->jso, json_type_array))
+		{
+			child = json_snapshot_array_get_idx(snap, f->ref, f->idx);
+		}
+		else
+		{
+			child = json_snapshot_object_value_at(snap, f->ref, f->idx);
+			if ((key = json_snapshot_object_key_at(snap, f->ref, f->idx)) == NULL)
+			{
+				errno = EINVAL;
+				goto fail;
+			}
+		}
+		f->idx++;
+		if (child != 0)
+		{
+			if (++nodes > max_nodes)
+			{
+				errno = EINVAL;
+				goto fail;
+			}
+			if ((val = snap_new_value(snap, child)) == NULL)
+				goto fail;
+		}
+		/* Keys are unique unless the original object had duplicates */
+		if (key == NULL)
+			rc = json_object_array_add(f->jso, val);
+		else
+			rc = json_object_object_add_ex(f->jso, key, val,
+			                               JSON_C_OBJECT_ADD_KEY_IS_NEW);
+		if (rc < 0)
+		{
+			json_object_put(val);
+			errno = ENOMEM;
+			goto fail;
+		}
+		/* Fill in an array or object once it's in place in its parent */
+		if (snap_is_container(val))
+		{
+			if (depth == stack_size)
+			{
+				struct snap_convert_frame *new_stack =
+				    json_c_realloc(stack, stack_size * 2 * sizeof(*new_stack));
+
+				if (new_stack == NULL)
+				{
+					errno = ENOMEM;
+					goto fail;
+				}
+				stack = new_stack;
+				stack_size *= 2;
+			}
+			stack[depth].ref = child;
+			stack[depth].jso = val;
+			stack[depth].idx = 0;
+			stack[depth].len = json_snapshot_length(snap, child);
+			depth++;
+		}
+	}
+	json_c_free(stack);
+	return root;
+fail:
+	json_c_free(stack);
+	json_object_put(root);
+	return NULL;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/**
+ * @file
+ * @brief A position independent binary snapshot of a json_object tree,
+ *        which can be mapped into memory and queried in place.
+ */
+#ifndef _json_snapshot_h_
+#define _json_snapshot_h_
+
+#include "json_inttypes.h"
+#include "json_object.h"
+#include "printbuf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The current version of the snapshot format, as written by
+ * json_object_to_snapshot().  json_snapshot_open() refuses snapshots
+ * with a different version.
+ */
+#define JSON_SNAPSHOT_VERSION 1
+
+/**
+ * An opaque handle to a snapshot, as returned by json_snapshot_open().
+ *
+ * This is just a view of the buffer that was passed to json_snapshot_open(),
+ * so it remains valid exactly as long as that buffer does.
+ */
+struct json_snapshot;
+
+/**
+ * A reference to a single value within a snapshot.
+ *
+ * This is a byte offset from the start of the snapshot, so it is only
+ * meaningful together with the snapshot it came from.
+ * A reference of 0 represents a JSON null.
+ */
+typedef uint64_t json_snapshot_ref;
+
+/**
+ * Serialize the tree rooted at jso into the binary snapshot format,
+ * appending it to pb.
+ *
+ * Unlike the text serializers, the output contains no pointers: all links
+ * between values are stored as offsets, and the members of each object are
+ * stored along with a pre-sorted key index so that json_snapshot_object_get_ex()
+ * does not need to build a hash table.  The resulting bytes may be written
+ * to a file and later mmap()ed, possibly by several processes at once,
+ * and queried with the json_snapshot_*() accessors without any parsing.
+ *
+ * Keys that occur several times in the tree are stored only once.
+ *
+ * The snapshot uses the byte order of the machine that created it.
+ * Custom serializers and userdata set on objects are not preserved.
+ *
+ * pb must be empty (e.g. freshly created, or after printbuf_reset()), since
+ * offsets are relative to the start of the buffer.
+ *
+ * Example:
+ * @code
+struct printbuf *pb = printbuf_new();
+if (json_object_to_snapshot(jso, pb) == 0)
+	write(fd, pb->buf, printbuf_length(pb));
+printbuf_free(pb);
+...
+void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+const struct json_snapshot *snap = json_snapshot_open(map, size);
+json_snapshot_ref ref;
+if (snap && json_snapshot_object_get_ex(snap, json_snapshot_root(snap), "foo", &ref))
+	printf("foo=%s\n", json_snapshot_get_string(snap, ref, NULL));
+ * @endcode
+ *
+ * @param jso the root of the tree to snapshot, may be NULL
+ * @param pb an empty printbuf to write the snapshot to
+ * @return 0 on success, -1 if memory could not be allocated or the tree
+ *         is too large for a printbuf (2GB).
+ */
+JSON_EXPORT int json_object_to_snapshot(struct json_object *jso, struct printbuf *pb);
+
+/**
+ * Check the header of a snapshot produced by json_object_to_snapshot()
+ * and return a handle that can be used with the other json_snapshot_*()
+ * functions.
+ *
+ * Only the header is validated here, so this is O(1) regardless of the
+ * size of the snapshot.  Every accessor checks the offsets it follows
+ * against the snapshot size, so a corrupt snapshot results in accessors
+ * returning NULL/0 values rather than in out of bounds reads.
+ *
+ * @param buf the snapshot data, which must be 8-byte aligned (as returned
+ *            by malloc() or mmap()).  It is not copied.
+ * @param size the number of bytes available at buf
+ * @return a snapshot handle, or NULL if buf does not hold a snapshot of
+ *         a supported version and byte order.
+ */
+JSON_EXPORT const struct json_snapshot *json_snapshot_open(const void *buf, size_t size);
+
+/**
+ * Return the reference to the top level value of the snapshot.
+ */
+JSON_EXPORT json_snapshot_ref json_snapshot_root(const struct json_snapshot *snap);
+
+/**
+ * Return the type of the value at ref.
+ * json_type_null is returned for null values and for invalid references.
+ */
+JSON_EXPORT enum json_type json_snapshot_get_type(const struct json_snapshot *snap,
+                                                  json_snapshot_ref ref);
+
+/**
+ * Return the value of a json_type_boolean value, or 0 for other types.
+ */
+JSON_EXPORT json_bool json_snapshot_get_boolean(const struct json_snapshot *snap,
+                                                json_snapshot_ref ref);
+
+/**
+ * Return the value of a json_type_int value as an int64_t, with the same
+ * clamping as json_object_get_int64().  Doubles are truncated, other types
+ * return 0.
+ */
+JSON_EXPORT int64_t json_snapshot_get_int64(const struct json_snapshot *snap,
+                                            json_snapshot_ref ref);
+
+/**
+ * Return the value of a json_type_int value as a uint64_t, with the same
+ * clamping as json_object_get_uint64().  Doubles are truncated, other types
+ * return 0.
+ */
+JSON_EXPORT uint64_t json_snapshot_get_uint64(const struct json_snapshot *snap,
+                                              json_snapshot_ref ref);
+
+/**
+ * Return the value of a json_type_double or json_type_int value as a double,
+ * or 0.0 for other types.
+ */
+JSON_EXPORT double json_snapshot_get_double(const struct json_snapshot *snap,
+                                            json_snapshot_ref ref);
+
+/**
+ * Return a pointer to the (nul terminated) contents of a json_type_string value.
+ * The pointer points into the snapshot itself.
+ *
+ * @param len if not NULL, set to the length of the string, which might
+ *            contain embedded nul bytes.
+ * @return the string, or NULL if the value at ref is not a string.
+ */
+JSON_EXPORT const char *json_snapshot_get_string(const struct json_snapshot *snap,
+                                                 json_snapshot_ref ref, size_t *len);
+
+/**
+ * Return the number of elements of an array, or the number of members of
+ * an object.  Other types return 0.
+ */
+JSON_EXPORT size_t json_snapshot_length(const struct json_snapshot *snap, json_snapshot_ref ref);
+
+/**
+ * Return the element at index idx of an array.
+ * Returns 0 (i.e. a null value) if ref is not an array or idx is out of range.
+ */
+JSON_EXPORT json_snapshot_ref json_snapshot_array_get_idx(const struct json_snapshot *snap,
+                                                          json_snapshot_ref ref, size_t idx);
+
+/**
+ * Look up the member named key in an object.
+ *
+ * This does a binary search of the key index stored in the snapshot, so
+ * it takes O(log(n)) string comparisons and does not allocate any memory.
+ *
+ * @param value if not NULL, set to the member's value, or to 0 if not found.
+ * @return 1 if the key exists, 0 otherwise (including if ref is not an object)
+ */
+JSON_EXPORT json_bool json_snapshot_object_get_ex(const struct json_snapshot *snap,
+                                                  json_snapshot_ref ref, const char *key,
+                                                  json_snapshot_ref *value);
+
+/**
+ * Return the key of the idx'th member of an object, in the order the
+ * members were in when the snapshot was created.
+ * Use this together with json_snapshot_object_value_at() and
+ * json_snapshot_length() to iterate over an object.
+ *
+ * @return the key, or NULL if ref is not an object or idx is out of range.
+ */
+JSON_EXPORT const char *json_snapshot_object_key_at(const struct json_snapshot *snap,
+                                                    json_snapshot_ref ref, size_t idx);
+
+/**
+ * Return the value of the idx'th member of an object.
+ * @see json_snapshot_object_key_at()
+ */
+JSON_EXPORT json_snapshot_ref json_snapshot_object_value_at(const struct json_snapshot *snap,
+                                                            json_snapshot_ref ref, size_t idx);
+
+/**
+ * Convert the value at ref, and everything below it, to a regular tree of
+ * json_object values which the caller owns and must release with json_object_put().
+ *
+ * This may be used on any value in the snapshot, so callers that only need
+ * to modify part of a document can convert just that part.
+ *
+ * Any snapshot written by json_object_to_snapshot() can be converted back,
+ * however deeply its arrays and objects are nested, while a corrupt one
+ * can't produce more values than it has room for, however its nodes refer
+ * to each other.
+ *
+ * @return the new json_object, or NULL for null values, invalid references and
+ *         if memory could not be allocated.  errno is set to ENOMEM or EINVAL
+ *         in the latter two cases, and to EINVAL for a snapshot that's corrupt.
+ */
+JSON_EXPORT struct json_object *json_snapshot_to_json_object(const struct json_snapshot *snap,
+                                                             json_snapshot_ref ref);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1068 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif /* HAVE_LOCALE_H */
+#ifdef HAVE_XLOCALE_H
+#include <xlocale.h>
+#endif
+
+#include "arraylist.h"
+#include "json_alloc_private.h"
+#include "json_object.h"
+#include "json_tape.h"
+#include "json_utf8_private.h"
+#include "json_util.h"
+
+/*
+ * Layout of a tape.
+ *
+ * Each value takes one or two 64-bit words, with a tag in the top 8 bits
+ * and a payload in the low 56 bits:
+ *
+ *   TAPE_NULL, TAPE_TRUE, TAPE_FALSE   no payload
+ *   TAPE_INT64, TAPE_UINT64            no payload, the value is in the next word
+ *   TAPE_DOUBLE                        offset of the original text in the string
+ *                                      buffer, the value is in the next word
+ *   TAPE_STRING, TAPE_KEY              offset of the string in the string buffer
+ *   TAPE_ARRAY, TAPE_OBJECT            bits 0-31: index of the word after the
+ *                                      matching end word, bits 32-55: number of
+ *                                      entries, saturated at TAPE_COUNT_MAX
+ *   TAPE_ARRAY_END, TAPE_OBJECT_END    index of the matching start word
+ *
+ * Object members are a TAPE_KEY word followed by the value.
+ *
+ * While parsing, the low 32 bits of the start word of each open container
+ * hold the index + 1 of the enclosing open container instead, so the stack
+ * of open containers costs no extra memory.
+ *
+ * Strings are stored in the string buffer as a uint32_t length, followed by
+ * the bytes and a nul terminator.
+ */
+
+#define TAPE_NULL 'n'
+#define TAPE_TRUE 't'
+#define TAPE_FALSE 'f'
+#define TAPE_INT64 'l'
+#define TAPE_UINT64 'u'
+#define TAPE_DOUBLE 'd'
+#define TAPE_STRING '"'
+#define TAPE_KEY 'k'
+#define TAPE_ARRAY '['
+#define TAPE_ARRAY_END ']'
+#define TAPE_OBJECT '{'
+#define TAPE_OBJECT_END '}'
+
+#define TAPE_TAG_SHIFT 56
+#define TAPE_PAYLOAD_MASK ((((uint64_t)1) << TAPE_TAG_SHIFT) - 1)
+#define TAPE_COUNT_SHIFT 32
+#define TAPE_COUNT_MAX 0xffffffU
+#define TAPE_INDEX_MASK 0xffffffffU
+
+#define TAPE_WORD(tag, payload) (((uint64_t)(tag) << TAPE_TAG_SHIFT) | (payload))
+#define TAPE_TAG(word) ((int)((word) >> TAPE_TAG_SHIFT))
+#define TAPE_PAYLOAD(word) ((word)&TAPE_PAYLOAD_MASK)
+#define TAPE_COUNT(word) ((size_t)(((word) >> TAPE_COUNT_SHIFT) & TAPE_COUNT_MAX))
+#define TAPE_INDEX(word) ((size_t)((word)&TAPE_INDEX_MASK))
+
+/* Size of the buffer used to nul terminate numbers for strtod() and friends */
+#define TAPE_NUMBER_BUF 64
+
+struct json_tape
+{
+	uint64_t *words;
+	size_t nwords;
+	size_t words_size;
+	char *strings;
+	size_t strings_len;
+	size_t strings_size;
+};
+
+struct tape_parser
+{
+	struct json_tape *tape;
+	const char *p;
+	const char *end;
+	/* Index + 1 of the innermost open container, 0 at the top level */
+	size_t open;
+	int depth;
+	int max_depth;
+	enum json_tokener_error err;
+};
+
+/*
+ * Parser
+ */
+
+static int tape_push(struct tape_parser *tp, uint64_t word)
+{
+	struct json_tape *tape = tp->tape;
+
+	if (tape->nwords == tape->words_size)
+	{
+		size_t new_size = tape->words_size * 2;
+		uint64_t *t;
+
+		/* Container start words can only address the first 4G words */
+		if (new_size > (size_t)TAPE_INDEX_MASK)
+			new_size = (size_t)TAPE_INDEX_MASK;
+		if (new_size <= tape->nwords)
+		{
+			tp->err = json_tokener_error_size;
+			return -1;
+		}
+		t = json_c_realloc(tape->words, new_size * sizeof(uint64_t));
+		if (t == NULL)
+		{
+			tp->err = json_tokener_error_memory;
+			return -1;
+		}
+		tape->words = t;
+		tape->words_size = new_size;
+	}
+	tape->words[tape->nwords++] = word;
+	return 0;
+}
+
+/* Make sure that there is room for a string of up to len bytes in the string buffer */
+static int tape_reserve_string(struct tape_parser *tp, size_t len)
+{
+	struct json_tape *tape = tp->tape;
+	size_t needed = tape->strings_len + sizeof(uint32_t) + len + 1;
+	char *t;
+	size_t new_size;
+
+	if (len > UINT32_MAX || needed < len)
+	{
+		tp->err = json_tokener_error_size;
+		return -1;
+	}
+	if (needed <= tape->strings_size)
+		return 0;
+	new_size = tape->strings_size * 2;
+	if (new_size < needed)
+		new_size = needed;
+	t = json_c_realloc(tape->strings, new_size);
+	if (t == NULL)
+	{
+		tp->err = json_tokener_error_memory;
+		return -1;
+	}
+	tape->strings = t;
+	tape->strings_size = new_size;
+	return 0;
+}
+
+/* Finish a string of len bytes already written after the length field, at offset off */
+static void tape_finish_string(struct json_tape *tape, size_t off, size_t len)
+{
+	uint32_t len32 = (uint32_t)len;
+
+	memcpy(tape->strings + off, &len32, sizeof(len32));
+	tape->strings[off + sizeof(len32) + len] = '\0';
+	tape->strings_len = off + sizeof(len32) + len + 1;
+}
+
+static void tape_skip_ws(struct tape_parser *tp)
+{
+	while (tp->p < tp->end &&
+	       (*tp->p == ' ' || *tp->p == '\n' || *tp->p == '\r' || *tp->p == '\t'))
+		tp->p++;
+}
+
+static int tape_hexdigit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Decode the 4 hex digits at p, or return -1 if they aren't all there */
+static long tape_parse_hex4(const char *p, const char *end)
+{
+	long v = 0;
+	int ii;
+
+	if (end - p < 4)
+		return -1;
+	for (ii = 0; ii < 4; ii++)
+	{
+		int d = tape_hexdigit(p[ii]);
+		if (d < 0)
+			return -1;
+		v = (v << 4) | d;
+	}
+	return v;
+}
+
+/*
+ * Parse the string starting just after the opening quote at tp->p,
+ * and push a word with the given tag for it.
+ */
+static int tape_parse_string(struct tape_parser *tp, int tag)
+{
+	struct json_tape *tape = tp->tape;
+	const char *start = tp->p;
+	const char *s = start;
+	size_t off, len;
+	char *out;
+
+	/* Find the closing quote, and whether there is anything to unescape */
+	while (s < tp->end && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20)
+		s++;
+	if (s < tp->end && *s == '"')
+	{
+		len = (size_t)(s - start);
+		if (tape_reserve_string(tp, len) < 0)
+			return -1;
+		off = tape->strings_len;
+		memcpy(tape->strings + off + sizeof(uint32_t), start, len);
+		tape_finish_string(tape, off, len);
+		tp->p = s + 1;
+		return tape_push(tp, TAPE_WORD(tag, off));
+	}
+	while (s < tp->end && *s != '"')
+	{
+		if ((unsigned char)*s < 0x20)
+		{
+			tp->err = json_tokener_error_parse_string;
+			return -1;
+		}
+		/* Skip what's escaped, unless the input ends first */
+		if (*s == '\\' && ++s == tp->end)
+			break;
+		s++;
+	}
+	if (s >= tp->end)
+	{
+		tp->err = json_tokener_error_parse_eof;
+		return -1;
+	}
+
+	/* Unescaping never makes a string longer */
+	if (tape_reserve_string(tp, (size_t)(s - start)) < 0)
+		return -1;
+	off = tape->strings_len;
+	out = tape->strings + off + sizeof(uint32_t);
+	for (s = start; *s != '"'; s++)
+	{
+		long ucs;
+
+		if (*s != '\\')
+		{
+			*out++ = *s;
+			continue;
+		}
+		switch (*++s)
+		{
+		case '"':
+		case '\\':
+		case '/': *out++ = *s; break;
+		case 'b': *out++ = '\b'; break;
+		case 'f': *out++ = '\f'; break;
+		case 'n': *out++ = '\n'; break;
+		case 'r': *out++ = '\r'; break;
+		case 't': *out++ = '\t'; break;
+		case 'u':
+			if ((ucs = tape_parse_hex4(s + 1, tp->end)) < 0)
+			{
+				tp->err = json_tokener_error_parse_string;
+				return -1;
+			}
+			s += 4;
+			if (IS_HIGH_SURROGATE(ucs) && tp->end - s > 6 && s[1] == '\\' &&
+			    s[2] == 'u')
+			{
+				long lo = tape_parse_hex4(s + 3, tp->end);
+				if (lo < 0)
+				{
+					tp->err = json_tokener_error_parse_string;
+					return -1;
+				}
+				if (IS_LOW_SURROGATE(lo))
+				{
+					ucs = DECODE_SURROGATE_PAIR(ucs, lo);
+					s += 6;
+				}
+				/*
+				 * Otherwise, the high surrogate becomes a replacement char
+				 * and the next sequence is handled on its own.
+				 */
+			}
+			out += json_utf8_put((unsigned int)ucs, (unsigned char *)out);
+			break;
+		default: tp->err = json_tokener_error_parse_string; return -1;
+		}
+	}
+	len = (size_t)(out - (tape->strings + off + sizeof(uint32_t)));
+	tape_finish_string(tape, off, len);
+	tp->p = s + 1;
+	return tape_push(tp, TAPE_WORD(tag, off));
+}
+
+static int tape_parse_literal(struct tape_parser *tp, const char *lit, size_t len, int tag,
+                              enum json_tokener_error err)
+{
+	if ((size_t)(tp->end - tp->p) < len || memcmp(tp->p, lit, len) != 0)
+	{
+		/* Report a truncated literal as such */
+		if ((size_t)(tp->end - tp->p) < len &&
+		    memcmp(tp->p, lit, (size_t)(tp->end - tp->p)) == 0)
+			tp->err = json_tokener_error_parse_eof;
+		else
+			tp->err = err;
+		return -1;
+	}
+	tp->p += len;
+	return tape_push(tp, TAPE_WORD(tag, 0));
+}
+
+static const char *tape_digits(const char *p, const char *end)
+{
+	while (p < end && *p >= '0' && *p <= '9')
+		p++;
+	return p;
+}
+
+static int tape_parse_number(struct tape_parser *tp)
+{
+	const char *start = tp->p;
+	const char *p = start;
+	const char *digits;
+	int is_double = 0;
+	char localbuf[TAPE_NUMBER_BUF];
+	char *buf = localbuf;
+	size_t len;
+	int rc = -1;
+
+	/* Check the syntax first, so strtod() and friends see nothing unexpected */
+	if (p < tp->end && *p == '-')
+		p++;
+	digits = p;
+	p = tape_digits(p, tp->end);
+	if (p == digits)
+		goto bad_number;
+	if (*digits == '0' && p - digits > 1)
+	{
+		tp->err = json_tokener_error_parse_number;
+		return -1;
+	}
+	if (p < tp->end && *p == '.')
+	{
+		is_double = 1;
+		digits = ++p;
+		p = tape_digits(p, tp->end);
+		if (p == digits)
+			goto bad_number;
+	}
+	if (p < tp->end && (*p == 'e' || *p == 'E'))
+	{
+		is_double = 1;
+		p++;
+		if (p < tp->end && (*p == '+' || *p == '-'))
+			p++;
+		digits = p;
+		p = tape_digits(p, tp->end);
+		if (p == digits)
+			goto bad_number;
+	}
+
+	len = (size_t)(p - start);
+	if (len >= sizeof(localbuf) && (buf = json_c_malloc(len + 1)) == NULL)
+	{
+		tp->err = json_tokener_error_memory;
+		return -1;
+	}
+	memcpy(buf, start, len);
+	buf[len] = '\0';
+
+	if (!is_double && *buf == '-')
+	{
+		int64_t num64 = 0;
+
+		/* Out of range values are clamped, as in non-strict json_tokener_parse() */
+		(void)json_parse_int64(buf, &num64);
+		if (tape_push(tp, TAPE_WORD(TAPE_INT64, 0)) < 0 ||
+		    tape_push(tp, (uint64_t)num64) < 0)
+			goto out;
+	}
+	else if (!is_double)
+	{
+		uint64_t numuint64 = 0;
+
+		(void)json_parse_uint64(buf, &numuint64);
+		if (tape_push(tp, TAPE_WORD(numuint64 <= INT64_MAX ? TAPE_INT64 : TAPE_UINT64, 0)) <
+		        0 ||
+		    tape_push(tp, numuint64) < 0)
+			goto out;
+	}
+	else
+	{
+		double d = strtod(buf, NULL);
+		uint64_t bits;
+		size_t off;
+
+		/* Keep the original text, for json_object_new_double_s() */
+		if (tape_reserve_string(tp, len) < 0)
+			goto out;
+		off = tp->tape->strings_len;
+		memcpy(tp->tape->strings + off + sizeof(uint32_t), buf, len);
+		tape_finish_string(tp->tape, off, len);
+
+		memcpy(&bits, &d, sizeof(bits));
+		if (tape_push(tp, TAPE_WORD(TAPE_DOUBLE, off)) < 0 || tape_push(tp, bits) < 0)
+			goto out;
+	}
+	tp->p = p;
+	rc = 0;
+out:
+	if (buf != localbuf)
+		json_c_free(buf);
+	return rc;
+
+bad_number:
+	tp->err = (p >= tp->end) ? json_tokener_error_parse_eof : json_tokener_error_parse_number;
+	return -1;
+}
+
+static int tape_open_container(struct tape_parser *tp, int tag)
+{
+	if (tp->depth >= tp->max_depth)
+	{
+		tp->err = json_tokener_error_depth;
+		return -1;
+	}
+	if (tape_push(tp, TAPE_WORD(tag, tp->open)) < 0)
+		return -1;
+	tp->depth++;
+	tp->open = tp->tape->nwords;
+	tp->p++;
+	return 0;
+}
+
+static int tape_close_container(struct tape_parser *tp, int end_tag)
+{
+	struct json_tape *tape = tp->tape;
+	size_t start = tp->open - 1;
+	uint64_t word = tape->words[start];
+
+	if (tape_push(tp, TAPE_WORD(end_tag, start)) < 0)
+		return -1;
+	tp->open = TAPE_INDEX(word);
+	tape->words[start] = (word & ~(uint64_t)TAPE_INDEX_MASK) | tape->nwords;
+	tp->depth--;
+	tp->p++;
+	return 0;
+}
+
+static int tape_parse_document(struct tape_parser *tp)
+{
+	int tag;
+
+value:
+	tape_skip_ws(tp);
+	if (tp->p == tp->end)
+	{
+		tp->err = json_tokener_error_parse_eof;
+		return -1;
+	}
+	switch (*tp->p)
+	{
+	case '{':
+		if (tape_open_container(tp, TAPE_OBJECT) < 0)
+			return -1;
+		tape_skip_ws(tp);
+		if (tp->p < tp->end && *tp->p == '}')
+		{
+			if (tape_close_container(tp, TAPE_OBJECT_END) < 0)
+				return -1;
+			break;
+		}
+		goto key;
+	case '[':
+		if (tape_open_container(tp, TAPE_ARRAY) < 0)
+			return -1;
+		tape_skip_ws(tp);
+		if (tp->p < tp->end && *tp->p == ']')
+		{
+			if (tape_close_container(tp, TAPE_ARRAY_END) < 0)
+				return -1;
+			break;
+		}
+		goto value;
+	case '"':
+		tp->p++;
+		if (tape_parse_string(tp, TAPE_STRING) < 0)
+			return -1;
+		break;
+	case 't':
+		if (tape_parse_literal(tp, "true", 4, TAPE_TRUE,
+		                       json_tokener_error_parse_boolean) < 0)
+			return -1;
+		break;
+	case 'f':
+		if (tape_parse_literal(tp, "false", 5, TAPE_FALSE,
+		                       json_tokener_error_parse_boolean) < 0)
+			return -1;
+		break;
+	case 'n':
+		if (tape_parse_literal(tp, "null", 4, TAPE_NULL, json_tokener_error_parse_null) < 0)
+			return -1;
+		break;
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9':
+		if (tape_parse_number(tp) < 0)
+			return -1;
+		break;
+	default: tp->err = json_tokener_error_parse_unexpected; return -1;
+	}
+
+after_value:
+	if (tp->open == 0)
+		return 0;
+	{
+		/* Count the value we just finished in the enclosing container */
+		uint64_t *word = &tp->tape->words[tp->open - 1];
+		if (TAPE_COUNT(*word) < TAPE_COUNT_MAX)
+			*word += (uint64_t)1 << TAPE_COUNT_SHIFT;
+		tag = TAPE_TAG(*word);
+	}
+	tape_skip_ws(tp);
+	if (tp->p == tp->end)
+	{
+		tp->err = json_tokener_error_parse_eof;
+		return -1;
+	}
+	if (*tp->p == ',')
+	{
+		tp->p++;
+		if (tag == TAPE_OBJECT)
+			goto key;
+		goto value;
+	}
+	if (tag == TAPE_ARRAY && *tp->p == ']')
+	{
+		if (tape_close_container(tp, TAPE_ARRAY_END) < 0)
+			return -1;
+		goto after_value;
+	}
+	if (tag == TAPE_OBJECT && *tp->p == '}')
+	{
+		if (tape_close_container(tp, TAPE_OBJECT_END) < 0)
+			return -1;
+		goto after_value;
+	}
+	tp->err = (tag == TAPE_ARRAY) ? json_tokener_error_parse_array
+	                              : json_tokener_error_parse_object_value_sep;
+	return -1;
+
+key:
+	tape_skip_ws(tp);
+	if (tp->p == tp->end)
+	{
+		tp->err = json_tokener_error_parse_eof;
+		return -1;
+	}
+	if (*tp->p != '"')
+	{
+		tp->err = json_tokener_error_parse_object_key_name;
+		return -1;
+	}
+	tp->p++;
+	if (tape_parse_string(tp, TAPE_KEY) < 0)
+		return -1;
+	tape_skip_ws(tp);
+	if (tp->p == tp->end)
+	{
+		tp->err = json_tokener_error_parse_eof;
+		return -1;
+	}
+	if (*tp->p != ':')
+	{
+		tp->err = json_tokener_error_parse_object_key_sep;
+		return -1;
+	}
+	tp->p++;
+	goto value;
+}
+
+struct json_tape *json_tape_parse(const char *str, size_t len, int depth,
+                                  enum json_tokener_error *err)
+{
+	struct tape_parser tp;
+	struct json_tape *tape;
+#ifdef HAVE_USELOCALE
+	locale_t oldlocale = uselocale(NULL);
+	locale_t newloc;
+#elif defined(HAVE_SETLOCALE)
+	char *oldlocale = NULL;
+#endif
+
+	memset(&tp, 0, sizeof(tp));
+	tp.p = str;
+	tp.end = str + len;
+	tp.max_depth = depth > 0 ? depth : JSON_TOKENER_DEFAULT_DEPTH;
+	tp.err = json_tokener_success;
+
+	tape = json_c_calloc(1, sizeof(*tape));
+	if (tape == NULL)
+	{
+		if (err)
+			*err = json_tokener_error_memory;
+		return NULL;
+	}
+	tp.tape = tape;
+
+	/*
+	 * Most documents need about one word per 4 bytes of input, and
+	 * well under one byte of strings per byte of input.
+	 */
+	tape->words_size = len / 4 + 4;
+	tape->strings_size = len / 2 + 16;
+	tape->words = json_c_malloc(tape->words_size * sizeof(uint64_t));
+	tape->strings = json_c_malloc(tape->strings_size);
+	if (tape->words == NULL || tape->strings == NULL)
+	{
+		json_tape_free(tape);
+		if (err)
+			*err = json_tokener_error_memory;
+		return NULL;
+	}
+
+	/* strtod() must see a '.' as the decimal point, regardless of the locale */
+#ifdef HAVE_USELOCALE
+	{
+#ifdef HAVE_DUPLOCALE
+		locale_t duploc = duplocale(oldlocale);
+		if (duploc == NULL && errno == ENOMEM)
+		{
+			json_tape_free(tape);
+			if (err)
+				*err = json_tokener_error_memory;
+			return NULL;
+		}
+		newloc = newlocale(LC_NUMERIC_MASK, "C", duploc);
+#else
+		newloc = newlocale(LC_NUMERIC_MASK, "C", oldlocale);
+#endif
+		if (newloc == NULL)
+		{
+#ifdef HAVE_DUPLOCALE
+			freelocale(duploc);
+#endif
+			json_tape_free(tape);
+			if (err)
+				*err = json_tokener_error_memory;
+			return NULL;
+		}
+#ifdef NEWLOCALE_NEEDS_FREELOCALE
+#ifdef HAVE_DUPLOCALE
+		freelocale(duploc);
+#endif
+#endif
+		uselocale(newloc);
+	}
+#elif defined(HAVE_SETLOCALE)
+	{
+		char *tmplocale = setlocale(LC_NUMERIC, NULL);
+		if (tmplocale)
+		{
+			oldlocale = json_c_strdup(tmplocale);
+			if (oldlocale == NULL)
+			{
+				json_tape_free(tape);
+				if (err)
+					*err = json_tokener_error_memory;
+				return NULL;
+			}
+		}
+		setlocale(LC_NUMERIC, "C");
+	}
+#endif
+
+	if (tape_parse_document(&tp) == 0)
+	{
+		tape_skip_ws(&tp);
+		if (tp.p != tp.end)
+			tp.err = json_tokener_error_parse_unexpected;
+	}
+
+#ifdef HAVE_USELOCALE
+	uselocale(oldlocale);
+	freelocale(newloc);
+#elif defined(HAVE_SETLOCALE)
+	setlocale(LC_NUMERIC, oldlocale);
+	json_c_free(oldlocale);
+#endif
+
+	if (err)
+		*err = tp.err;
+	if (tp.err != json_tokener_success)
+	{
+		json_tape_free(tape);
+		return NULL;
+	}
+	return tape;
+}
+
+void json_tape_free(struct json_tape *tape)
+{
+	if (tape == NULL)
+		return;
+	json_c_free(tape->words);
+	json_c_free(tape->strings);
+	json_c_free(tape);
+}
+
+/*
+ * Accessors
+ */
+
+static int tape_tag_at(const struct json_tape *tape, json_tape_ref ref)
+{
+	if (tape == NULL || ref >= tape->nwords)
+		return 0;
+	return TAPE_TAG(tape->words[ref]);
+}
+
+/* Return the index of the word following the value at ref */
+static size_t tape_skip(const struct json_tape *tape, json_tape_ref ref)
+{
+	switch (TAPE_TAG(tape->words[ref]))
+	{
+	case TAPE_INT64:
+	case TAPE_UINT64:
+	case TAPE_DOUBLE: return ref + 2;
+	case TAPE_ARRAY:
+	case TAPE_OBJECT: return TAPE_INDEX(tape->words[ref]);
+	default: return ref + 1;
+	}
+}
+
+json_tape_ref json_tape_root(const struct json_tape *tape)
+{
+	return (tape != NULL && tape->nwords > 0) ? 0 : JSON_TAPE_REF_NONE;
+}
+
+enum json_type json_tape_get_type(const struct json_tape *tape, json_tape_ref ref)
+{
+	switch (tape_tag_at(tape, ref))
+	{
+	case TAPE_TRUE:
+	case TAPE_FALSE: return json_type_boolean;
+	case TAPE_INT64:
+	case TAPE_UINT64: return json_type_int;
+	case TAPE_DOUBLE: return json_type_double;
+	case TAPE_STRING:
+	case TAPE_KEY: return json_type_string;
+	case TAPE_ARRAY: return json_type_array;
+	case TAPE_OBJECT: return json_type_object;
+	default: return json_type_null;
+	}
+}
+
+json_bool json_tape_get_boolean(const struct json_tape *tape, json_tape_ref ref)
+{
+	return tape_tag_at(tape, ref) == TAPE_TRUE;
+}
+
+static double tape_double_at(const struct json_tape *tape, json_tape_ref ref)
+{
+	double d;
+
+	memcpy(&d, &tape->words[ref + 1], sizeof(d));
+	return d;
+}
+
+int64_t json_tape_get_int64(const struct json_tape *tape, json_tape_ref ref)
+{
+	double d;
+
+	switch (tape_tag_at(tape, ref))
+	{
+	case TAPE_INT64: return (int64_t)tape->words[ref + 1];
+	case TAPE_UINT64: return INT64_MAX; /* Only used for values > INT64_MAX */
+	case TAPE_DOUBLE:
+		d = tape_double_at(tape, ref);
+		if (d > (double)INT64_MAX)
+			return INT64_MAX;
+		if (d < (double)INT64_MIN || isnan(d))
+			return INT64_MIN;
+		return (int64_t)d;
+	default: return 0;
+	}
+}
+
+uint64_t json_tape_get_uint64(const struct json_tape *tape, json_tape_ref ref)
+{
+	double d;
+
+	switch (tape_tag_at(tape, ref))
+	{
+	case TAPE_INT64:
+		return (int64_t)tape->words[ref + 1] < 0 ? 0 : tape->words[ref + 1];
+	case TAPE_UINT64: return tape->words[ref + 1];
+	case TAPE_DOUBLE:
+		d = tape_double_at(tape, ref);
+		if (d > (double)UINT64_MAX)
+			return UINT64_MAX;
+		if (d < 0 || isnan(d))
+			return 0;
+		return (uint64_t)d;
+	default: return 0;
+	}
+}
+
+double json_tape_get_double(const struct json_tape *tape, json_tape_ref ref)
+{
+	switch (tape_tag_at(tape, ref))
+	{
+	case TAPE_INT64: return (double)(int64_t)tape->words[ref + 1];
+	case TAPE_UINT64: return (double)tape->words[ref + 1];
+	case TAPE_DOUBLE: return tape_double_at(tape, ref);
+	default: return 0.0;
+	}
+}
+
+static const char *tape_string_at(const struct json_tape *tape, uint64_t word, size_t *len)
+{
+	const char *s = tape->strings + TAPE_PAYLOAD(word);
+	uint32_t len32;
+
+	memcpy(&len32, s, sizeof(len32));
+	if (len)
+		*len = len32;
+	return s + sizeof(len32);
+}
+
+const char *json_tape_get_string(const struct json_tape *tape, json_tape_ref ref, size_t *len)
+{
+	int tag = tape_tag_at(tape, ref);
+
+	if (tag != TAPE_STRING && tag != TAPE_KEY)
+	{
+		if (len)
+			*len = 0;
+		return NULL;
+	}
+	return tape_string_at(tape, tape->words[ref], len);
+}
+
+json_tape_ref json_tape_first(const struct json_tape *tape, json_tape_ref ref)
+{
+	int tag = tape_tag_at(tape, ref);
+
+	if (tag != TAPE_ARRAY && tag != TAPE_OBJECT)
+		return JSON_TAPE_REF_NONE;
+	if (TAPE_COUNT(tape->words[ref]) == 0)
+		return JSON_TAPE_REF_NONE;
+	return ref + 1;
+}
+
+json_tape_ref json_tape_next(const struct json_tape *tape, json_tape_ref ref)
+{
+	size_t next;
+	int tag = tape_tag_at(tape, ref);
+
+	if (tag == 0)
+		return JSON_TAPE_REF_NONE;
+	next = (tag == TAPE_KEY) ? tape_skip(tape, ref + 1) : tape_skip(tape, ref);
+	tag = tape_tag_at(tape, next);
+	if (tag == 0 || tag == TAPE_ARRAY_END || tag == TAPE_OBJECT_END)
+		return JSON_TAPE_REF_NONE;
+	return next;
+}
+
+json_tape_ref json_tape_member_value(const struct json_tape *tape, json_tape_ref ref)
+{
+	if (tape_tag_at(tape, ref) != TAPE_KEY)
+		return JSON_TAPE_REF_NONE;
+	return ref + 1;
+}
+
+size_t json_tape_length(const struct json_tape *tape, json_tape_ref ref)
+{
+	size_t count;
+	json_tape_ref it;
+
+	if (json_tape_first(tape, ref) == JSON_TAPE_REF_NONE)
+		return 0;
+	count = TAPE_COUNT(tape->words[ref]);
+	if (count < TAPE_COUNT_MAX)
+		return count;
+	for (count = 0, it = json_tape_first(tape, ref); it != JSON_TAPE_REF_NONE;
+	     it = json_tape_next(tape, it))
+		count++;
+	return count;
+}
+
+json_tape_ref json_tape_array_get_idx(const struct json_tape *tape, json_tape_ref ref, size_t idx)
+{
+	json_tape_ref it;
+
+	if (tape_tag_at(tape, ref) != TAPE_ARRAY)
+		return JSON_TAPE_REF_NONE;
+	if (idx >= TAPE_COUNT(tape->words[ref]) && TAPE_COUNT(tape->words[ref]) < TAPE_COUNT_MAX)
+		return JSON_TAPE_REF_NONE;
+	for (it = json_tape_first(tape, ref); it != JSON_TAPE_REF_NONE && idx > 0; idx--)
+		it = json_tape_next(tape, it);
+	return it;
+}
+
+json_bool json_tape_object_get_ex(const struct json_tape *tape, json_tape_ref ref, const char *key,
+                                  json_tape_ref *value)
+{
+	size_t keylen;
+	json_tape_ref it;
+
+	if (value)
+		*value = JSON_TAPE_REF_NONE;
+	if (tape_tag_at(tape, ref) != TAPE_OBJECT || key == NULL)
+		return 0;
+	keylen = strlen(key);
+	for (it = json_tape_first(tape, ref); it != JSON_TAPE_REF_NONE;
+	     it = json_tape_next(tape, it))
+	{
+		size_t len;
+		const char *s = tape_string_at(tape, tape->words[it], &len);
+
+		if (len == keylen && memcmp(s, key, len) == 0)
+		{
+			if (value)
+				*value = it + 1;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Create the json_object for the value at ref, with arrays and objects
+ * left empty for json_tape_to_json_object() to fill in.
+ */
+static struct json_object *tape_new_value(const struct json_tape *tape, json_tape_ref ref)
+{
+	const char *str;
+	size_t len;
+
+	switch (tape_tag_at(tape, ref))
+	{
+	case TAPE_TRUE:
+	case TAPE_FALSE: return json_object_new_boolean(json_tape_get_boolean(tape, ref));
+	case TAPE_INT64: return json_object_new_int64(json_tape_get_int64(tape, ref));
+	case TAPE_UINT64: return json_object_new_uint64(json_tape_get_uint64(tape, ref));
+	case TAPE_DOUBLE:
+		str = tape_string_at(tape, tape->words[ref], NULL);
+		return json_object_new_double_s(tape_double_at(tape, ref), str);
+	case TAPE_STRING:
+	case TAPE_KEY:
+		str = tape_string_at(tape, tape->words[ref], &len);
+		return json_object_new_string_len(str, (int)len);
+	case TAPE_ARRAY:
+		len = json_tape_length(tape, ref);
+		return json_object_new_array_ext(len > INT_MAX ? INT_MAX : (int)len);
+	case TAPE_OBJECT: return json_object_new_object();
+	default: return NULL;
+	}
+}
+
+struct json_object *json_tape_to_json_object(const struct json_tape *tape, json_tape_ref ref)
+{
+	struct array_list *stack;
+	struct json_object *root;
+	const char *key = NULL;
+	size_t pos, end;
+	int tag = tape_tag_at(tape, ref);
+
+	if (tag != TAPE_ARRAY && tag != TAPE_OBJECT)
+		return tape_new_value(tape, ref);
+
+	/*
+	 * Walk the words of the container in order, with an explicit stack of
+	 * the arrays and objects being filled in, so that deeply nested input
+	 * can't overflow the real one.
+	 */
+	if ((root = tape_new_value(tape, ref)) == NULL)
+		return NULL;
+	if ((stack = array_list_new2(NULL, 64)) == NULL || array_list_add(stack, root) != 0)
+		goto fail;
+	end = tape_skip(tape, ref);
+	pos = ref + 1;
+	while (pos < end)
+	{
+		struct json_object *parent, *val = NULL;
+		int rc;
+
+		tag = TAPE_TAG(tape->words[pos]);
+		if (tag == TAPE_ARRAY_END || tag == TAPE_OBJECT_END)
+		{
+			stack->length--;
+			pos++;
+			continue;
+		}
+		if (tag == TAPE_KEY)
+		{
+			key = tape_string_at(tape, tape->words[pos], NULL);
+			pos++;
+			continue;
+		}
+		if (tag != TAPE_NULL && (val = tape_new_value(tape, pos)) == NULL)
+			goto fail;
+		parent = (struct json_object *)stack->array[stack->length - 1];
+		if (json_object_is_type(parent, json_type_array))
+			rc = json_object_array_add(parent, val);
+		/* Later duplicates replace earlier ones, as in json_tokener_parse() */
+		else
+			rc = json_object_object_add(parent, key, val);
+		if (rc < 0)
+		{
+			json_object_put(val);
+			goto fail;
+		}
+		if (tag == TAPE_ARRAY || tag == TAPE_OBJECT)
+		{
+			/* Its contents come next */
+			if (array_list_add(stack, val) != 0)
+				goto fail;
+			pos++;
+		}
+		else
+		{
+			pos = tape_skip(tape, pos);
+		}
+	}
+	array_list_free(stack);
+	return root;
+fail:
+	if (stack != NULL)
+		array_list_free(stack);
+	json_object_put(root);
+	return NULL;
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/**
+ * @file
+ * @brief A compact, read-only parse result for documents that are only
+ *        read once.
+ */
+#ifndef _json_tape_h_
+#define _json_tape_h_
+
+#include "json_inttypes.h"
+#include "json_object.h"
+#include "json_tokener.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * An opaque, immutable parse result created by json_tape_parse().
+ *
+ * Instead of a json_object for each value, a tape holds the whole
+ * document in one array of 64-bit words, laid out in document order,
+ * plus one buffer for the contents of all strings.  Parsing a document
+ * into a tape therefore takes a handful of allocations no matter how many
+ * values it has, and json_tape_free() releases it all at once.
+ */
+struct json_tape;
+
+/**
+ * A reference to a value within a tape, only meaningful together with the
+ * tape it came from.
+ */
+typedef size_t json_tape_ref;
+
+/**
+ * The reference returned by the navigation functions when there is no
+ * such value, e.g. for a missing key or an index past the end of an array.
+ * All getters accept it, and treat it like a null value.
+ */
+#define JSON_TAPE_REF_NONE ((json_tape_ref)-1)
+
+/**
+ * Parse a complete JSON document into a tape.
+ *
+ * Only standard (RFC 8259) JSON is accepted, as with JSON_TOKENER_STRICT:
+ * no comments, single quoted strings, trailing commas, NaN or Infinity.
+ * Strings are not checked for valid UTF-8.
+ * Anything other than whitespace after the document is an error.
+ *
+ * @param str the document, which does not need to be nul terminated
+ * @param len the length of str
+ * @param depth the maximum nesting depth of arrays and objects, or 0
+ *              for JSON_TOKENER_DEFAULT_DEPTH
+ * @param err if not NULL, set to the reason for a failure, or to
+ *            json_tokener_success.  See json_tokener_error_desc().
+ * @return a new tape, to be released with json_tape_free(), or NULL on error
+ */
+JSON_EXPORT struct json_tape *json_tape_parse(const char *str, size_t len, int depth,
+                                              enum json_tokener_error *err);
+
+/**
+ * Release a tape, invalidating all references and strings obtained from it.
+ */
+JSON_EXPORT void json_tape_free(struct json_tape *tape);
+
+/**
+ * Return the reference to the top level value of the document.
+ */
+JSON_EXPORT json_tape_ref json_tape_root(const struct json_tape *tape);
+
+/**
+ * Return the type of the value at ref.
+ * Object keys, as returned by json_tape_first() and json_tape_next(),
+ * are json_type_string.
+ */
+JSON_EXPORT enum json_type json_tape_get_type(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the value of a json_type_boolean value, or 0 for other types.
+ */
+JSON_EXPORT json_bool json_tape_get_boolean(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the value of a json_type_int value as an int64_t, with the same
+ * clamping as json_object_get_int64().  Doubles are truncated, other types
+ * return 0.
+ */
+JSON_EXPORT int64_t json_tape_get_int64(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the value of a json_type_int value as a uint64_t, with the same
+ * clamping as json_object_get_uint64().  Doubles are truncated, other types
+ * return 0.
+ */
+JSON_EXPORT uint64_t json_tape_get_uint64(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the value of a json_type_double or json_type_int value as a double,
+ * or 0.0 for other types.
+ */
+JSON_EXPORT double json_tape_get_double(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the (nul terminated, unescaped) contents of a string value or
+ * object key.  The string is owned by the tape.
+ *
+ * @param len if not NULL, set to the length of the string, which might
+ *            contain embedded nul bytes.
+ * @return the string, or NULL if ref is not a string
+ */
+JSON_EXPORT const char *json_tape_get_string(const struct json_tape *tape, json_tape_ref ref,
+                                             size_t *len);
+
+/**
+ * Return the number of elements of an array or members of an object,
+ * or 0 for other types.
+ *
+ * This is O(1), except for containers with more than 16 million
+ * entries, which have to be walked.
+ */
+JSON_EXPORT size_t json_tape_length(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the element at index idx of an array, or JSON_TAPE_REF_NONE
+ * if ref is not an array or idx is out of range.
+ *
+ * Elements are found by skipping over the preceding ones, which is cheap
+ * (one step per element, regardless of its size), but O(idx).  Use
+ * json_tape_first() and json_tape_next() to visit every element.
+ */
+JSON_EXPORT json_tape_ref json_tape_array_get_idx(const struct json_tape *tape,
+                                                  json_tape_ref ref, size_t idx);
+
+/**
+ * Look up a member of an object by key.
+ *
+ * This is a linear scan of the object's keys, which is faster than building
+ * a hash table for the handful of lookups that tapes are intended for.
+ * If the key occurs more than once, the first one is returned.
+ *
+ * @param value if not NULL, set to the member's value, or to
+ *              JSON_TAPE_REF_NONE if it was not found
+ * @return 1 if the key was found, 0 otherwise
+ */
+JSON_EXPORT json_bool json_tape_object_get_ex(const struct json_tape *tape, json_tape_ref ref,
+                                              const char *key, json_tape_ref *value);
+
+/**
+ * Return the first element of an array, or the key of the first member of
+ * an object, or JSON_TAPE_REF_NONE if it is empty or not a container.
+ *
+ * Together with json_tape_next(), this visits each entry in document order:
+ * @code
+for (json_tape_ref it = json_tape_first(tape, obj); it != JSON_TAPE_REF_NONE;
+     it = json_tape_next(tape, it))
+	printf("%s: %s\n", json_tape_get_string(tape, it, NULL),
+	       json_type_to_name(json_tape_get_type(tape, json_tape_member_value(tape, it))));
+ * @endcode
+ */
+JSON_EXPORT json_tape_ref json_tape_first(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the array element or object member following the one at ref,
+ * or JSON_TAPE_REF_NONE if ref was the last one.
+ * @see json_tape_first()
+ */
+JSON_EXPORT json_tape_ref json_tape_next(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Return the value of the object member whose key is at ref (as returned by
+ * json_tape_first() or json_tape_next()), or JSON_TAPE_REF_NONE if
+ * ref is not an object key.
+ */
+JSON_EXPORT json_tape_ref json_tape_member_value(const struct json_tape *tape, json_tape_ref ref);
+
+/**
+ * Convert the value at ref, and everything below it, to a regular tree of
+ * json_object values which the caller owns and must release with json_object_put().
+ * Doubles keep their original text, as with json_tokener_parse().
+ *
+ * @return the new json_object, or NULL for null values and if memory could
+ *         not be allocated.
+ */
+JSON_EXPORT struct json_object *json_tape_to_json_object(const struct json_tape *tape,
+                                                         json_tape_ref ref);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
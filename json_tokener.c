@@ -24,13 +24,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef ENABLE_TOKENER_PROFILE
+#include <time.h>
+#endif
 
+#include "arraylist.h"
 #include "debug.h"
+#include "json_alloc_private.h"
 #include "json_inttypes.h"
 #include "json_object.h"
 #include "json_object_private.h"
+#include "json_probes_private.h"
 #include "json_tokener.h"
+#include "json_utf8_private.h"
 #include "json_util.h"
+#include "linkhash.h"
 #include "printbuf.h"
 #include "strdup_compat.h"
 
@@ -53,6 +61,17 @@
 #error You do not have strncasecmp on your system.
 #endif /* HAVE_STRNCASECMP */
 
+#ifndef HAVE_STRNLEN
+static size_t strnlen(const char *s, size_t maxlen)
+{
+	size_t len = 0;
+
+	while (len < maxlen && s[len] != '\0')
+		len++;
+	return len;
+}
+#endif /* HAVE_STRNLEN */
+
 #if defined(_MSC_VER) && (_MSC_VER <= 1800)
 /* VS2013 doesn't know about "inline" */
 #define inline __inline
@@ -60,6 +79,75 @@
 #define inline
 #endif
 
+/* For json_tokener_parse_flags() to be specialized for each call site's flags */
+#if defined(__GNUC__)
+#define JSON_TOKENER_ALWAYS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define JSON_TOKENER_ALWAYS_INLINE __forceinline
+#else
+#define JSON_TOKENER_ALWAYS_INLINE inline
+#endif
+
+/*
+ * Character classes, so the tokener can test a char for what it's looking
+ * for with one lookup instead of a chain of comparisons.  A char is in:
+ *   JT_CC_WS     if it's whitespace
+ *   JT_CC_DIGIT  if it's 0-9
+ *   JT_CC_HEX    if it's a hex digit
+ *   JT_CC_NUM    if it's part of a number other than a digit: . e E + -
+ *   JT_CC_END    if it may follow a number in an array or object, before
+ *                json_tokener_state_number looks at it more closely
+ *   JT_CC_STR    if json_tokener_state_string can't just copy it: a quote,
+ *                a backslash or a control char
+ */
+#define JT_CC_WS 0x01
+#define JT_CC_DIGIT 0x02
+#define JT_CC_HEX 0x04
+#define JT_CC_NUM 0x08
+#define JT_CC_END 0x10
+#define JT_CC_STR 0x20
+
+/* clang-format off */
+#define no 0
+#define sp (JT_CC_WS | JT_CC_END)
+#define cw (JT_CC_WS | JT_CC_END | JT_CC_STR)
+#define st JT_CC_STR
+#define dg (JT_CC_DIGIT | JT_CC_HEX)
+#define hx JT_CC_HEX
+#define nm JT_CC_NUM
+#define ex (JT_CC_NUM | JT_CC_HEX)
+#define en JT_CC_END
+static const unsigned char json_tokener_char_class[256] = {
+	st, st, st, st, st, st, st, st, st, cw, cw, st, st, cw, st, st, /* 00 */
+	st, st, st, st, st, st, st, st, st, st, st, st, st, st, st, st, /* 10 */
+	sp, no, st, no, no, no, no, st, no, no, no, nm, en, nm, nm, en, /* 20 */
+	dg, dg, dg, dg, dg, dg, dg, dg, dg, dg, no, no, no, no, no, no, /* 30 */
+	no, hx, hx, hx, hx, ex, hx, no, no, en, no, no, no, no, no, no, /* 40 */
+	no, no, no, no, no, no, no, no, no, no, no, no, st, en, no, no, /* 50 */
+	no, hx, hx, hx, hx, ex, hx, no, no, en, no, no, no, no, no, no, /* 60 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, en, no, no, /* 70 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* 80 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* 90 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* a0 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* b0 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* c0 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* d0 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* e0 */
+	no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, no, /* f0 */
+};
+#undef no
+#undef sp
+#undef cw
+#undef st
+#undef dg
+#undef hx
+#undef nm
+#undef ex
+#undef en
+/* clang-format on */
+
+#define JT_CC(c, cls) (json_tokener_char_class[(unsigned char)(c)] & (cls))
+
 /* The following helper functions are used to speed up parsing. They
  * are faster than their ctype counterparts because they assume that
  * the input is in ASCII and that the locale is set to "C". The
@@ -68,17 +156,12 @@
  */
 static inline int is_ws_char(char c)
 {
-	return c == ' '
-	    || c == '\t'
-	    || c == '\n'
-	    || c == '\r';
+	return JT_CC(c, JT_CC_WS);
 }
 
 static inline int is_hex_char(char c)
 {
-	return (c >= '0' && c <= '9')
-	    || (c >= 'A' && c <= 'F')
-	    || (c >= 'a' && c <= 'f');
+	return JT_CC(c, JT_CC_HEX);
 }
 
 /* Use C99 NAN by default; if not available, nan("") should work too. */
@@ -87,18 +170,33 @@ static inline int is_hex_char(char c)
 #endif /* !NAN */
 
 static const char json_null_str[] = "null";
+static const char json_null_str_invert[] = "NULL";
 static const int json_null_str_len = sizeof(json_null_str) - 1;
 static const char json_inf_str[] = "Infinity";
 /* Swapped case "Infinity" to avoid need to call tolower() on input chars: */
 static const char json_inf_str_invert[] = "iNFINITY";
 static const unsigned int json_inf_str_len = sizeof(json_inf_str) - 1;
 static const char json_nan_str[] = "NaN";
+static const char json_nan_str_invert[] = "nAn";
 static const int json_nan_str_len = sizeof(json_nan_str) - 1;
 static const char json_true_str[] = "true";
+static const char json_true_str_invert[] = "TRUE";
 static const int json_true_str_len = sizeof(json_true_str) - 1;
 static const char json_false_str[] = "false";
+static const char json_false_str_invert[] = "FALSE";
 static const int json_false_str_len = sizeof(json_false_str) - 1;
 
+/*
+ * Bits of tok->st_flags: what's been seen of the number or literal being
+ * read, so that one split across calls carries on from where it was
+ * without looking back at the part of it in tok->pb.
+ */
+#define JT_ST_EXPONENT 0x01 /* A number's exponent has started */
+#define JT_ST_NEG_OK 0x02   /* A number may go on with a '-' */
+#define JT_ST_POS_OK 0x04   /* A number may go on with a '+' */
+#define JT_ST_FALSE 0x08    /* json_tokener_state_boolean is reading "false" */
+#define JT_ST_NAN 0x10      /* json_tokener_state_null is reading "NaN" */
+
 /* clang-format off */
 static const char *json_tokener_errors[] = {
 	"success",
@@ -117,15 +215,41 @@ static const char *json_tokener_errors[] = {
 	"expected comment",
 	"invalid utf-8 string",
 	"buffer size overflow",
-	"out of memory"
+	"out of memory",
+	"duplicate object key",
+	"document needs too much memory",
+	"too many values in document",
+	"string too long",
+	"too many object members",
+	"array too long"
 };
 /* clang-format on */
 
-/**
- * validete the utf-8 string in strict model.
- * if not utf-8 format, return err.
+/*
+ * UTF-8 validation, for JSON_TOKENER_VALIDATE_UTF8.
+ *
+ * Rather than checking each byte as it's parsed, json_tokener_parse_ex()
+ * validates its input ahead of the parser, a window at a time, and
+ * PEEK_CHAR() only calls json_tokener_validate_utf8() when it gets to the
+ * end of what has been validated.  ASCII is checked eight bytes at a time.
+ * Windows start small and double, so that little is validated past the end
+ * of a document when more documents follow it in the same input.
+ *
+ * A sequence split across json_tokener_parse_ex() calls is carried over in
+ * tok->utf8_state: the continuation bytes still expected, in the low bits,
+ * and the range that the next one must be in, as made by UTF8_STATE().
+ *
+ * This follows table 3-7 of the Unicode standard, so overlong encodings,
+ * surrogates and code points above U+10FFFF are rejected.
+ *
+ * Returns 0 if the byte at str, the current one, is invalid, and otherwise
+ * moves *utf8_end forward, up to the next invalid byte at most.
  */
-static json_bool json_tokener_validate_utf8(const char c, unsigned int *nBytes);
+#define UTF8_WINDOW_MIN 64
+#define UTF8_WINDOW_MAX (64 * 1024)
+#define UTF8_STATE(need, lo, hi) ((need) | ((lo) << 8) | ((hi) << 16))
+static int json_tokener_validate_utf8(struct json_tokener *tok, const char *str, int len,
+                                      int *utf8_end, int *utf8_window);
 
 static int json_tokener_parse_double(const char *buf, int len, double *retval);
 
@@ -144,11 +268,288 @@ enum json_tokener_error json_tokener_get_error(struct json_tokener *tok)
 	return tok->err;
 }
 
-/* Stuff for decoding unicode sequences */
-#define IS_HIGH_SURROGATE(uc) (((uc)&0xFC00) == 0xD800)
-#define IS_LOW_SURROGATE(uc) (((uc)&0xFC00) == 0xDC00)
-#define DECODE_SURROGATE_PAIR(hi, lo) ((((hi)&0x3FF) << 10) + ((lo)&0x3FF) + 0x10000)
-static unsigned char utf8_replacement_char[3] = {0xEF, 0xBF, 0xBD};
+/*
+ * Read the four hex digits at str into *ucs, without looking at more than
+ * avail bytes.  Returns 0 if they aren't all there, or aren't all hex.
+ */
+static int json_tokener_get_hex4(const char *str, int avail, unsigned int *ucs)
+{
+	unsigned int v = 0;
+	int ii;
+
+	if (avail < 4)
+		return 0;
+	for (ii = 0; ii < 4; ii++)
+	{
+		if (!is_hex_char(str[ii]))
+			return 0;
+		v = (v << 4) | (unsigned int)jt_hexdigit(str[ii]);
+	}
+	*ucs = v;
+	return 1;
+}
+
+/*
+ * Decode one \uXXXX escape, whose "\u" has already been seen, from the hex
+ * digits at str, along with the \uXXXX after it if it's a high surrogate,
+ * without looking at more than avail bytes.  Like the escape_unicode states
+ * do, a high surrogate that isn't followed by a low one is replaced.
+ *
+ * Returns the number of bytes used, 4 or 10, after storing at most 4 bytes
+ * of UTF-8 in out and their number in *out_len, or 0 if the escape is cut
+ * short by avail, or isn't valid, to leave it to the escape_unicode states.
+ */
+static int json_tokener_decode_escape(const char *str, int avail, unsigned char *out,
+                                      int *out_len)
+{
+	unsigned int ucs, low;
+
+	if (!json_tokener_get_hex4(str, avail, &ucs))
+		return 0;
+	if (!IS_HIGH_SURROGATE(ucs))
+	{
+		*out_len = json_utf8_put(ucs, out);
+		return 4;
+	}
+	/* Whether a low surrogate follows has to be known before going on */
+	if (avail < 5 || (str[4] == '\\' && avail < 6) ||
+	    (str[4] == '\\' && str[5] == 'u' && !json_tokener_get_hex4(str + 6, avail - 6, &low)))
+		return 0;
+	if (str[4] == '\\' && str[5] == 'u' && IS_LOW_SURROGATE(low))
+	{
+		*out_len = json_utf8_put(DECODE_SURROGATE_PAIR(ucs, low), out);
+		return 10;
+	}
+	memcpy(out, JSON_UTF8_REPLACEMENT_CHAR, 3);
+	*out_len = 3;
+	return 4;
+}
+
+/* Stats */
+
+/* What json_tokener_parse_ex() needs to keep to collect tok->stats */
+struct json_tokener_stats_state
+{
+	struct json_tokener_stats stats; /* Must be first */
+	int escaped;                     /* The current string has an escape */
+#ifdef ENABLE_TOKENER_PROFILE
+	enum json_tokener_state timed_state;
+	uint64_t timed_since;
+#endif
+};
+
+#define stats_state(tok) ((struct json_tokener_stats_state *)(tok)->stats)
+
+int json_tokener_enable_stats(struct json_tokener *tok, int enable)
+{
+	if (!enable)
+	{
+		json_c_free(tok->stats);
+		tok->stats = NULL;
+		return 0;
+	}
+	if (tok->stats == NULL)
+	{
+		tok->stats = (struct json_tokener_stats *)json_c_malloc(
+		    sizeof(struct json_tokener_stats_state));
+		if (tok->stats == NULL)
+			return -1;
+	}
+	memset(tok->stats, 0, sizeof(struct json_tokener_stats_state));
+	return 0;
+}
+
+const struct json_tokener_stats *json_tokener_get_stats(const struct json_tokener *tok)
+{
+	return tok->stats;
+}
+
+/*
+ * Note a value at the current depth.  Arrays and objects are noted as soon
+ * as they're opened, so that a parse that fails for nesting too deeply
+ * still shows how deep it got.
+ */
+static void json_tokener_stats_depth(struct json_tokener *tok)
+{
+	if (tok->depth + 1 > tok->stats->max_depth)
+		tok->stats->max_depth = tok->depth + 1;
+}
+
+static void json_tokener_stats_value(struct json_tokener *tok, struct json_object *jso)
+{
+	tok->stats->values[json_object_get_type(jso)]++;
+	/* null is the only value that isn't allocated */
+	if (jso != NULL)
+		tok->stats->allocs++;
+	json_tokener_stats_depth(tok);
+}
+
+static void json_tokener_stats_string(struct json_tokener *tok, int is_key)
+{
+	if (stats_state(tok)->escaped)
+		tok->stats->strings_escaped++;
+	else
+		tok->stats->strings_clean++;
+	stats_state(tok)->escaped = 0;
+	if (is_key)
+	{
+		tok->stats->keys++;
+		tok->stats->allocs++;
+	}
+}
+
+/* The number of elements, or hash table slots, that jso has room for */
+static size_t json_tokener_container_size(struct json_object *jso)
+{
+	if (json_object_get_type(jso) == json_type_array)
+		return json_object_get_array(jso)->size;
+	return json_object_get_object(jso)->size;
+}
+
+static void json_tokener_stats_resize(struct json_tokener *tok, struct json_object *jso,
+                                      size_t old_size)
+{
+	if (json_tokener_container_size(jso) != old_size)
+	{
+		tok->stats->container_resizes++;
+		tok->stats->allocs++;
+	}
+}
+
+#ifdef ENABLE_TOKENER_PROFILE
+/* Charge the time since the last call to the state that was current then */
+static void json_tokener_stats_time(struct json_tokener *tok, enum json_tokener_state next)
+{
+	struct json_tokener_stats_state *st = stats_state(tok);
+	struct timespec ts;
+	uint64_t now;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+	if (st->timed_since != 0)
+		st->stats.state_ns[st->timed_state] += now - st->timed_since;
+	st->timed_state = next;
+	st->timed_since = now;
+}
+#endif
+
+/* Limits */
+
+/* What json_tokener_parse_ex() counts against tok->limits */
+struct json_tokener_limits_state
+{
+	struct json_tokener_limits limits; /* Must be first */
+	size_t bytes;                      /* Charged to the current document */
+	size_t nodes;                      /* Values in the current document */
+};
+
+#define limits_state(tok) ((struct json_tokener_limits_state *)(tok)->limits)
+
+int json_tokener_set_limits(struct json_tokener *tok, const struct json_tokener_limits *limits)
+{
+	if (limits == NULL)
+	{
+		json_c_free(tok->limits);
+		tok->limits = NULL;
+		return 0;
+	}
+	if (tok->limits == NULL)
+	{
+		tok->limits = (struct json_tokener_limits *)json_c_calloc(
+		    1, sizeof(struct json_tokener_limits_state));
+		if (tok->limits == NULL)
+			return -1;
+	}
+	*tok->limits = *limits;
+	return 0;
+}
+
+/* Charge n more bytes to the current document */
+static int json_tokener_limit_bytes(struct json_tokener *tok, size_t n)
+{
+	struct json_tokener_limits_state *ls = limits_state(tok);
+
+	ls->bytes += n;
+	if (ls->limits.max_bytes != 0 && ls->bytes > ls->limits.max_bytes)
+	{
+		tok->err = json_tokener_error_limit_bytes;
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Count jso, a value that's just been parsed, and what it takes up.
+ * An array's or object's slots are charged as its elements are added,
+ * and its keys as they're parsed.
+ */
+static int json_tokener_limit_value(struct json_tokener *tok, struct json_object *jso)
+{
+	struct json_tokener_limits_state *ls = limits_state(tok);
+	size_t n = 0;
+
+	ls->nodes++;
+	if (ls->limits.max_nodes != 0 && ls->nodes > ls->limits.max_nodes)
+	{
+		tok->err = json_tokener_error_limit_nodes;
+		return -1;
+	}
+	switch (json_object_get_type(jso))
+	{
+	case json_type_null: break;
+	case json_type_boolean: n = sizeof(struct json_object_boolean); break;
+	case json_type_double:
+		n = sizeof(struct json_object_double);
+		/* The text it was parsed from, see json_object_new_double_s() */
+		if (jso->_userdata != NULL)
+			n += strlen((const char *)jso->_userdata) + 1;
+		break;
+	case json_type_int: n = sizeof(struct json_object_int); break;
+	case json_type_string:
+		n = sizeof(struct json_object_string) + (size_t)json_object_get_string_len(jso);
+		break;
+	case json_type_array:
+		n = sizeof(struct json_object_array) + sizeof(struct array_list);
+		break;
+	case json_type_object:
+		n = sizeof(struct json_object_object) + sizeof(struct lh_table);
+		break;
+	}
+	return json_tokener_limit_bytes(tok, n);
+}
+
+/* Check the length of a string or key */
+static int json_tokener_limit_string(struct json_tokener *tok, size_t len)
+{
+	if (tok->limits->max_string_len != 0 && len > tok->limits->max_string_len)
+	{
+		tok->err = json_tokener_error_limit_string;
+		return -1;
+	}
+	return 0;
+}
+
+/* Check the length of jso, an array or object that's just had a value added */
+static int json_tokener_limit_add(struct json_tokener *tok, struct json_object *jso)
+{
+	if (json_object_get_type(jso) == json_type_array)
+	{
+		if (tok->limits->max_array_len != 0 &&
+		    json_object_array_length(jso) > tok->limits->max_array_len)
+		{
+			tok->err = json_tokener_error_limit_array;
+			return -1;
+		}
+		return json_tokener_limit_bytes(tok, sizeof(void *));
+	}
+	if (tok->limits->max_object_members != 0 &&
+	    (size_t)json_object_object_length(jso) > tok->limits->max_object_members)
+	{
+		tok->err = json_tokener_error_limit_members;
+		return -1;
+	}
+	return json_tokener_limit_bytes(tok, sizeof(struct lh_entry));
+}
 
 struct json_tokener *json_tokener_new_ex(int depth)
 {
@@ -157,20 +558,21 @@ struct json_tokener *json_tokener_new_ex(int depth)
 	if (depth < 1)
 		return NULL;
 
-	tok = (struct json_tokener *)calloc(1, sizeof(struct json_tokener));
+	tok = (struct json_tokener *)json_c_calloc(1, sizeof(struct json_tokener));
 	if (!tok)
 		return NULL;
-	tok->stack = (struct json_tokener_srec *)calloc(depth, sizeof(struct json_tokener_srec));
+	tok->stack =
+	    (struct json_tokener_srec *)json_c_calloc(depth, sizeof(struct json_tokener_srec));
 	if (!tok->stack)
 	{
-		free(tok);
+		json_c_free(tok);
 		return NULL;
 	}
 	tok->pb = printbuf_new();
 	if (!tok->pb)
 	{
-		free(tok->stack);
-		free(tok);
+		json_c_free(tok->stack);
+		json_c_free(tok);
 		return NULL;
 	}
 	tok->max_depth = depth;
@@ -190,8 +592,10 @@ void json_tokener_free(struct json_tokener *tok)
 	json_tokener_reset(tok);
 	if (tok->pb)
 		printbuf_free(tok->pb);
-	free(tok->stack);
-	free(tok);
+	json_c_free(tok->stats);
+	json_c_free(tok->limits);
+	json_c_free(tok->stack);
+	json_c_free(tok);
 }
 
 static void json_tokener_reset_level(struct json_tokener *tok, int depth)
@@ -200,7 +604,7 @@ static void json_tokener_reset_level(struct json_tokener *tok, int depth)
 	tok->stack[depth].saved_state = json_tokener_state_start;
 	json_object_put(tok->stack[depth].current);
 	tok->stack[depth].current = NULL;
-	free(tok->stack[depth].obj_field_name);
+	json_c_free(tok->stack[depth].obj_field_name);
 	tok->stack[depth].obj_field_name = NULL;
 }
 
@@ -214,6 +618,11 @@ void json_tokener_reset(struct json_tokener *tok)
 		json_tokener_reset_level(tok, i);
 	tok->depth = 0;
 	tok->err = json_tokener_success;
+	tok->utf8_state = 0;
+	if (tok->stats != NULL)
+		stats_state(tok)->escaped = 0;
+	if (tok->limits != NULL)
+		limits_state(tok)->bytes = limits_state(tok)->nodes = 0;
 }
 
 struct json_object *json_tokener_parse(const char *str)
@@ -279,17 +688,17 @@ struct json_object *json_tokener_parse_verbose(const char *str, enum json_tokene
 /* PEEK_CHAR(dest, tok) macro:
  *   Peeks at the current char and stores it in dest.
  *   Returns 1 on success, sets tok->err and returns 0 if no more chars.
- *   Implicit inputs:  str, len, nBytesp vars
+ *   Implicit inputs:  str, len, flags, utf8_len, utf8_end, utf8_window vars
  */
-#define PEEK_CHAR(dest, tok)                                                 \
-	(((tok)->char_offset == len)                                         \
-	     ? (((tok)->depth == 0 && state == json_tokener_state_eatws &&   \
-	         saved_state == json_tokener_state_finish)                   \
-	            ? (((tok)->err = json_tokener_success), 0)               \
-	            : (((tok)->err = json_tokener_continue), 0))             \
-	     : (((tok->flags & JSON_TOKENER_VALIDATE_UTF8) &&                \
-	         (!json_tokener_validate_utf8(*str, nBytesp)))               \
-	            ? ((tok->err = json_tokener_error_parse_utf8_string), 0) \
+#define PEEK_CHAR(dest, tok)                                                               \
+	(((tok)->char_offset == len)                                                       \
+	     ? (((tok)->depth == 0 && state == json_tokener_state_eatws &&                 \
+	         saved_state == json_tokener_state_finish)                                 \
+	            ? (((tok)->err = json_tokener_success), 0)                             \
+	            : (((tok)->err = json_tokener_continue), 0))                           \
+	     : (((flags & JSON_TOKENER_VALIDATE_UTF8) && (tok)->char_offset == utf8_end && \
+	         !json_tokener_validate_utf8(tok, str, utf8_len, &utf8_end, &utf8_window)) \
+	            ? ((tok->err = json_tokener_error_parse_utf8_string), 0)               \
 	            : (((dest) = *str), 1)))
 
 /* ADVANCE_CHAR() macro:
@@ -299,27 +708,73 @@ struct json_object *json_tokener_parse_verbose(const char *str, enum json_tokene
  */
 #define ADVANCE_CHAR(str, tok) (++(str), ((tok)->char_offset)++, c)
 
+/* LITERAL_CHAR(ch, lit, pos) macro:
+ *   Whether ch may be the char at pos of the literal lit, or, other than in
+ *   strict mode, of lit_invert, the same literal with its case swapped.
+ *   Implicit inputs:  flags var
+ */
+#define LITERAL_CHAR(ch, lit, pos) \
+	((ch) == lit[pos] || (!(flags & JSON_TOKENER_STRICT) && (ch) == lit##_invert[pos]))
+
 /* printbuf_memappend_checked(p, s, l) macro:
  *   Add string s of length l to printbuffer p.
  *   If operation fails abort parse operation with memory error.
+ *   Counts the growth of p in tok->stats, see printbuf_memappend().
+ */
+#define printbuf_memappend_checked(p, s, l)                                            \
+	do {                                                                           \
+		if (tok->stats != NULL && (p)->size <= (p)->bpos + (int)(l) + 1)       \
+		{                                                                      \
+			tok->stats->printbuf_grows++;                                  \
+			tok->stats->allocs++;                                          \
+		}                                                                      \
+		if (printbuf_memappend((p), (s), (l)) < 0)                             \
+		{                                                                      \
+			tok->err = json_tokener_error_memory;                          \
+			goto out;                                                      \
+		}                                                                      \
+	} while (0)
+
+/* printbuf_memappend_limited(p, s, l) macro:
+ *   printbuf_memappend_checked(), for a string or object key, failing the
+ *   parse instead if it would make the string longer than tok->limits allow.
  */
-#define printbuf_memappend_checked(p, s, l)                   \
-	do {                                                  \
-		if (printbuf_memappend((p), (s), (l)) < 0)    \
-		{                                             \
-			tok->err = json_tokener_error_memory; \
-			goto out;                             \
-		}                                             \
+#define printbuf_memappend_limited(p, s, l)                                            \
+	do {                                                                           \
+		if (tok->limits != NULL &&                                             \
+		    json_tokener_limit_string(tok, (size_t)(p)->bpos + (size_t)(l)) != 0)\
+			goto out;                                                      \
+		printbuf_memappend_checked(p, s, l);                                   \
+                                                                                       \
+	} while (0)
+
+/* STATS_RESIZE(stmt) macro:
+ *   Run stmt, which may resize the current container, and count it in tok->stats.
+ */
+#define STATS_RESIZE(stmt)                                                         \
+	do {                                                                       \
+		size_t old_size =                                                  \
+		    tok->stats != NULL ? json_tokener_container_size(current) : 0; \
+		stmt;                                                              \
+		if (tok->stats != NULL)                                            \
+			json_tokener_stats_resize(tok, current, old_size);         \
 	} while (0)
 
 /* End optimization macro defs */
 
-struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *str, int len)
+/*
+ * The parser proper.  It's always inlined, and flags is a constant at each
+ * call, in json_tokener_parse_ex(), so the compiler generates a copy of the
+ * parser for each of the flags it's called with, with the tests for what
+ * those flags don't turn on folded away.
+ */
+static JSON_TOKENER_ALWAYS_INLINE struct json_object *
+json_tokener_parse_flags(struct json_tokener *tok, const char *str, int len, const int flags)
 {
 	struct json_object *obj = NULL;
 	char c = '\1';
-	unsigned int nBytes = 0;
-	unsigned int *nBytesp = &nBytes;
+	/* With JSON_TOKENER_VALIDATE_UTF8, str is valid up to utf8_end */
+	int utf8_len = len, utf8_end = -1, utf8_window = UTF8_WINDOW_MIN;
 
 #ifdef HAVE_USELOCALE
 	locale_t oldlocale = uselocale(NULL);
@@ -342,6 +797,15 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		tok->err = json_tokener_error_size;
 		return NULL;
 	}
+	JSON_C_PROBE2(parse__start, tok, len);
+
+	if (flags & JSON_TOKENER_VALIDATE_UTF8)
+	{
+		utf8_end = 0;
+		/* Including the terminating nul, which ends a split sequence too early */
+		if (len == -1)
+			utf8_len = (int)strlen(str) + 1;
+	}
 
 #ifdef HAVE_USELOCALE
 	{
@@ -350,6 +814,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		if (duploc == NULL && errno == ENOMEM)
 		{
 			tok->err = json_tokener_error_memory;
+			JSON_C_PROBE3(parse__done, tok, 0, tok->err);
 			return NULL;
 		}
 		newloc = newlocale(LC_NUMERIC_MASK, "C", duploc);
@@ -362,6 +827,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 #ifdef HAVE_DUPLOCALE
 			freelocale(duploc);
 #endif
+			JSON_C_PROBE3(parse__done, tok, 0, tok->err);
 			return NULL;
 		}
 #ifdef NEWLOCALE_NEEDS_FREELOCALE
@@ -379,10 +845,11 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		tmplocale = setlocale(LC_NUMERIC, NULL);
 		if (tmplocale)
 		{
-			oldlocale = strdup(tmplocale);
+			oldlocale = json_c_strdup(tmplocale);
 			if (oldlocale == NULL)
 			{
 				tok->err = json_tokener_error_memory;
+				JSON_C_PROBE3(parse__done, tok, 0, tok->err);
 				return NULL;
 			}
 		}
@@ -394,6 +861,10 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 	{
 
 	redo_char:
+#ifdef ENABLE_TOKENER_PROFILE
+		if (tok->stats != NULL)
+			json_tokener_stats_time(tok, state);
+#endif
 		switch (state)
 		{
 
@@ -404,7 +875,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				if ((!ADVANCE_CHAR(str, tok)) || (!PEEK_CHAR(c, tok)))
 					goto out;
 			}
-			if (c == '/' && !(tok->flags & JSON_TOKENER_STRICT))
+			if (c == '/' && !(flags & JSON_TOKENER_STRICT))
 			{
 				printbuf_reset(tok->pb);
 				printbuf_memappend_checked(tok->pb, &c, 1);
@@ -429,6 +900,8 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					tok->err = json_tokener_error_memory;
 					goto out;
 				}
+				if (tok->stats != NULL)
+					json_tokener_stats_depth(tok);
 				break;
 			case '[':
 				state = json_tokener_state_eatws;
@@ -439,6 +912,8 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					tok->err = json_tokener_error_memory;
 					goto out;
 				}
+				if (tok->stats != NULL)
+					json_tokener_stats_depth(tok);
 				break;
 			case 'I':
 			case 'i':
@@ -453,7 +928,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				tok->st_pos = 0;
 				goto redo_char;
 			case '\'':
-				if (tok->flags & JSON_TOKENER_STRICT)
+				if (flags & JSON_TOKENER_STRICT)
 				{
 					/* in STRICT mode only double-quote are allowed */
 					tok->err = json_tokener_error_parse_unexpected;
@@ -495,6 +970,10 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		case json_tokener_state_finish:
 			if (tok->depth == 0)
 				goto out;
+			if (tok->stats != NULL)
+				json_tokener_stats_value(tok, current);
+			if (tok->limits != NULL && json_tokener_limit_value(tok, current) != 0)
+				goto out;
 			obj = json_object_get(current);
 			json_tokener_reset_level(tok, tok->depth);
 			tok->depth--;
@@ -516,7 +995,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			{
 				char inf_char = *str;
 				if (inf_char != json_inf_str[tok->st_pos] &&
-				    ((tok->flags & JSON_TOKENER_STRICT) ||
+				    ((flags & JSON_TOKENER_STRICT) ||
 				      inf_char != json_inf_str_invert[tok->st_pos])
 				   )
 				{
@@ -551,15 +1030,18 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		}
 		break;
 		case json_tokener_state_null: /* aka starts with 'n' */
-		{
-			int size;
-			int size_nan;
-			printbuf_memappend_checked(tok->pb, &c, 1);
-			size = json_min(tok->st_pos + 1, json_null_str_len);
-			size_nan = json_min(tok->st_pos + 1, json_nan_str_len);
-			if ((!(tok->flags & JSON_TOKENER_STRICT) &&
-			     strncasecmp(json_null_str, tok->pb->buf, size) == 0) ||
-			    (strncmp(json_null_str, tok->pb->buf, size) == 0))
+			/*
+			 * In strict mode the first char settles which of "null" and
+			 * "NaN" this is.  Otherwise either may be in any case, so it
+			 * takes until the second.
+			 */
+			if (tok->st_pos == 0)
+				tok->st_flags =
+				    ((flags & JSON_TOKENER_STRICT) && c == 'N') ? JT_ST_NAN : 0;
+			else if (tok->st_pos == 1 && !(flags & JSON_TOKENER_STRICT) &&
+			         (c == 'a' || c == 'A'))
+				tok->st_flags = JT_ST_NAN;
+			if (!(tok->st_flags & JT_ST_NAN))
 			{
 				if (tok->st_pos == json_null_str_len)
 				{
@@ -568,10 +1050,13 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					state = json_tokener_state_eatws;
 					goto redo_char;
 				}
+				if (!LITERAL_CHAR(c, json_null_str, tok->st_pos))
+				{
+					tok->err = json_tokener_error_parse_null;
+					goto out;
+				}
 			}
-			else if ((!(tok->flags & JSON_TOKENER_STRICT) &&
-			          strncasecmp(json_nan_str, tok->pb->buf, size_nan) == 0) ||
-			         (strncmp(json_nan_str, tok->pb->buf, size_nan) == 0))
+			else
 			{
 				if (tok->st_pos == json_nan_str_len)
 				{
@@ -585,15 +1070,14 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					state = json_tokener_state_eatws;
 					goto redo_char;
 				}
-			}
-			else
-			{
-				tok->err = json_tokener_error_parse_null;
-				goto out;
+				if (!LITERAL_CHAR(c, json_nan_str, tok->st_pos))
+				{
+					tok->err = json_tokener_error_parse_null;
+					goto out;
+				}
 			}
 			tok->st_pos++;
-		}
-		break;
+			break;
 
 		case json_tokener_state_comment_start:
 			if (c == '*')
@@ -668,10 +1152,23 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			const char *case_start = str;
 			while (1)
 			{
+				/* Most chars are copied as they are, so check for those first */
+				if (!JT_CC(c, JT_CC_STR))
+				{
+					if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok))
+					{
+						printbuf_memappend_limited(tok->pb, case_start,
+						                           str - case_start);
+						goto out;
+					}
+					continue;
+				}
 				if (c == tok->quote_char)
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
+					if (tok->stats != NULL)
+						json_tokener_stats_string(tok, 0);
 					current =
 					    json_object_new_string_len(tok->pb->buf, tok->pb->bpos);
 					if (current == NULL)
@@ -685,13 +1182,13 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				}
 				else if (c == '\\')
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
 					saved_state = json_tokener_state_string;
 					state = json_tokener_state_string_escape;
 					break;
 				}
-				else if ((tok->flags & JSON_TOKENER_STRICT) && (unsigned char)c <= 0x1f)
+				else if ((flags & JSON_TOKENER_STRICT) && (unsigned char)c <= 0x1f)
 				{
 					// Disallow control characters in strict mode
 					tok->err = json_tokener_error_parse_string;
@@ -699,7 +1196,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				}
 				if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok))
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
 					goto out;
 				}
@@ -708,12 +1205,14 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 		break;
 
 		case json_tokener_state_string_escape:
+			if (tok->stats != NULL)
+				stats_state(tok)->escaped = 1;
 			switch (c)
 			{
 			case '"':
 			case '\\':
 			case '/':
-				printbuf_memappend_checked(tok->pb, &c, 1);
+				printbuf_memappend_limited(tok->pb, &c, 1);
 				state = saved_state;
 				break;
 			case 'b':
@@ -722,22 +1221,66 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			case 't':
 			case 'f':
 				if (c == 'b')
-					printbuf_memappend_checked(tok->pb, "\b", 1);
+					printbuf_memappend_limited(tok->pb, "\b", 1);
 				else if (c == 'n')
-					printbuf_memappend_checked(tok->pb, "\n", 1);
+					printbuf_memappend_limited(tok->pb, "\n", 1);
 				else if (c == 'r')
-					printbuf_memappend_checked(tok->pb, "\r", 1);
+					printbuf_memappend_limited(tok->pb, "\r", 1);
 				else if (c == 't')
-					printbuf_memappend_checked(tok->pb, "\t", 1);
+					printbuf_memappend_limited(tok->pb, "\t", 1);
 				else if (c == 'f')
-					printbuf_memappend_checked(tok->pb, "\f", 1);
+					printbuf_memappend_limited(tok->pb, "\f", 1);
 				state = saved_state;
 				break;
 			case 'u':
-				tok->ucs_char = 0;
-				tok->st_pos = 0;
-				state = json_tokener_state_escape_unicode;
-				break;
+			{
+				/*
+				 * Decode a whole run of \uXXXX escapes here when they're
+				 * all in the input, and leave the escape_unicode states
+				 * to deal with one that's cut off by the end of it.
+				 * Don't go past what's been checked for UTF-8, either.
+				 */
+				unsigned char utf[128];
+				int limit = (flags & JSON_TOKENER_VALIDATE_UTF8) ? utf8_end : len;
+				int avail = (limit < 0) ? INT_MAX : limit - tok->char_offset - 1;
+				const char *p = str + 1;
+				int n = 0, used, ulen;
+
+				while (1)
+				{
+					used = json_tokener_decode_escape(p, avail, utf + n, &ulen);
+					if (!used)
+						break;
+					p += used;
+					avail -= used;
+					n += ulen;
+					if (n > (int)sizeof(utf) - 4)
+					{
+						printbuf_memappend_limited(tok->pb, (char *)utf, n);
+						n = 0;
+					}
+					if (avail < 2 || p[0] != '\\' || p[1] != 'u')
+						break;
+					p += 2;
+					avail -= 2;
+				}
+				printbuf_memappend_limited(tok->pb, (char *)utf, n);
+				/* Leave str on the last byte used, which the loop steps over */
+				tok->char_offset += (int)(p - 1 - str);
+				str = p - 1;
+				c = *str;
+				if (used > 0)
+				{
+					state = saved_state;
+				}
+				else
+				{
+					tok->ucs_char = 0;
+					tok->st_pos = 0;
+					state = json_tokener_state_escape_unicode;
+				}
+			}
+			break;
 			default: tok->err = json_tokener_error_parse_string; goto out;
 			}
 			break;
@@ -790,26 +1333,13 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					/* High surrogate was not followed by a low surrogate
 					 * Replace the high and process the rest normally
 					 */
-					printbuf_memappend_checked(tok->pb,
-					                           (char *)utf8_replacement_char, 3);
+					printbuf_memappend_limited(tok->pb,
+					                           JSON_UTF8_REPLACEMENT_CHAR, 3);
 				}
 				tok->high_surrogate = 0;
 			}
 
-			if (tok->ucs_char < 0x80)
-			{
-				unsigned char unescaped_utf[1];
-				unescaped_utf[0] = tok->ucs_char;
-				printbuf_memappend_checked(tok->pb, (char *)unescaped_utf, 1);
-			}
-			else if (tok->ucs_char < 0x800)
-			{
-				unsigned char unescaped_utf[2];
-				unescaped_utf[0] = 0xc0 | (tok->ucs_char >> 6);
-				unescaped_utf[1] = 0x80 | (tok->ucs_char & 0x3f);
-				printbuf_memappend_checked(tok->pb, (char *)unescaped_utf, 2);
-			}
-			else if (IS_HIGH_SURROGATE(tok->ucs_char))
+			if (IS_HIGH_SURROGATE(tok->ucs_char))
 			{
 				/*
 				 * The next two characters should be \u, HOWEVER,
@@ -830,32 +1360,11 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				state = json_tokener_state_escape_unicode_need_escape;
 				break;
 			}
-			else if (IS_LOW_SURROGATE(tok->ucs_char))
-			{
-				/* Got a low surrogate not preceded by a high */
-				printbuf_memappend_checked(tok->pb, (char *)utf8_replacement_char, 3);
-			}
-			else if (tok->ucs_char < 0x10000)
-			{
-				unsigned char unescaped_utf[3];
-				unescaped_utf[0] = 0xe0 | (tok->ucs_char >> 12);
-				unescaped_utf[1] = 0x80 | ((tok->ucs_char >> 6) & 0x3f);
-				unescaped_utf[2] = 0x80 | (tok->ucs_char & 0x3f);
-				printbuf_memappend_checked(tok->pb, (char *)unescaped_utf, 3);
-			}
-			else if (tok->ucs_char < 0x110000)
-			{
-				unsigned char unescaped_utf[4];
-				unescaped_utf[0] = 0xf0 | ((tok->ucs_char >> 18) & 0x07);
-				unescaped_utf[1] = 0x80 | ((tok->ucs_char >> 12) & 0x3f);
-				unescaped_utf[2] = 0x80 | ((tok->ucs_char >> 6) & 0x3f);
-				unescaped_utf[3] = 0x80 | (tok->ucs_char & 0x3f);
-				printbuf_memappend_checked(tok->pb, (char *)unescaped_utf, 4);
-			}
 			else
 			{
-				/* Don't know what we got--insert the replacement char */
-				printbuf_memappend_checked(tok->pb, (char *)utf8_replacement_char, 3);
+				unsigned char unescaped_utf[4];
+				int n = json_utf8_put(tok->ucs_char, unescaped_utf);
+				printbuf_memappend_limited(tok->pb, (char *)unescaped_utf, n);
 			}
 			state = saved_state; // i.e. _state_string or _state_object_field
 		}
@@ -870,7 +1379,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				 * it.  Put a replacement char in for the high surrogate
 				 * and pop back up to _state_string or _state_object_field.
 				 */
-				printbuf_memappend_checked(tok->pb, (char *)utf8_replacement_char, 3);
+				printbuf_memappend_limited(tok->pb, JSON_UTF8_REPLACEMENT_CHAR, 3);
 				tok->high_surrogate = 0;
 				tok->ucs_char = 0;
 				tok->st_pos = 0;
@@ -889,7 +1398,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				 * Put a replacement char in for the high surrogate
 				 * and handle the escape sequence normally.
 				 */
-				printbuf_memappend_checked(tok->pb, (char *)utf8_replacement_char, 3);
+				printbuf_memappend_limited(tok->pb, JSON_UTF8_REPLACEMENT_CHAR, 3);
 				tok->high_surrogate = 0;
 				tok->ucs_char = 0;
 				tok->st_pos = 0;
@@ -902,14 +1411,10 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			// ===================================================
 
 		case json_tokener_state_boolean:
-		{
-			int size1, size2;
-			printbuf_memappend_checked(tok->pb, &c, 1);
-			size1 = json_min(tok->st_pos + 1, json_true_str_len);
-			size2 = json_min(tok->st_pos + 1, json_false_str_len);
-			if ((!(tok->flags & JSON_TOKENER_STRICT) &&
-			     strncasecmp(json_true_str, tok->pb->buf, size1) == 0) ||
-			    (strncmp(json_true_str, tok->pb->buf, size1) == 0))
+			/* Which of "true" and "false" this is was settled by its first char */
+			if (tok->st_pos == 0)
+				tok->st_flags = (c == 'f' || c == 'F') ? JT_ST_FALSE : 0;
+			if (!(tok->st_flags & JT_ST_FALSE))
 			{
 				if (tok->st_pos == json_true_str_len)
 				{
@@ -923,10 +1428,13 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					state = json_tokener_state_eatws;
 					goto redo_char;
 				}
+				if (!LITERAL_CHAR(c, json_true_str, tok->st_pos))
+				{
+					tok->err = json_tokener_error_parse_boolean;
+					goto out;
+				}
 			}
-			else if ((!(tok->flags & JSON_TOKENER_STRICT) &&
-			          strncasecmp(json_false_str, tok->pb->buf, size2) == 0) ||
-			         (strncmp(json_false_str, tok->pb->buf, size2) == 0))
+			else
 			{
 				if (tok->st_pos == json_false_str_len)
 				{
@@ -940,15 +1448,14 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 					state = json_tokener_state_eatws;
 					goto redo_char;
 				}
-			}
-			else
-			{
-				tok->err = json_tokener_error_parse_boolean;
-				goto out;
+				if (!LITERAL_CHAR(c, json_false_str, tok->st_pos))
+				{
+					tok->err = json_tokener_error_parse_boolean;
+					goto out;
+				}
 			}
 			tok->st_pos++;
-		}
-		break;
+			break;
 
 		case json_tokener_state_number:
 		{
@@ -960,32 +1467,17 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			int pos_sign_ok = 0;
 			if (printbuf_length(tok->pb) > 0)
 			{
-				/* We don't save all state from the previous incremental parse
-				   so we need to re-generate it based on the saved string so far.
-				 */
-				char *e_loc = strchr(tok->pb->buf, 'e');
-				if (!e_loc)
-					e_loc = strchr(tok->pb->buf, 'E');
-				if (e_loc)
-				{
-					char *last_saved_char =
-					    &tok->pb->buf[printbuf_length(tok->pb) - 1];
-					is_exponent = 1;
-					pos_sign_ok = neg_sign_ok = 1;
-					/* If the "e" isn't at the end, we can't start with a '-' */
-					if (e_loc != last_saved_char)
-					{
-						neg_sign_ok = 0;
-						pos_sign_ok = 0;
-					}
-					// else leave it set to 1, i.e. start of the new input
-				}
+				/* Carry on from where the previous call left off */
+				is_exponent = (tok->st_flags & JT_ST_EXPONENT) != 0;
+				neg_sign_ok = (tok->st_flags & JT_ST_NEG_OK) != 0;
+				pos_sign_ok = (tok->st_flags & JT_ST_POS_OK) != 0;
 			}
 
-			while (c && ((c >= '0' && c <= '9') ||
-			             (!is_exponent && (c == 'e' || c == 'E')) ||
-			             (neg_sign_ok && c == '-') || (pos_sign_ok && c == '+') ||
-			             (!tok->is_double && c == '.')))
+			while (JT_CC(c, JT_CC_DIGIT) ||
+			       (JT_CC(c, JT_CC_NUM) && ((!is_exponent && (c == 'e' || c == 'E')) ||
+			                                (neg_sign_ok && c == '-') ||
+			                                (pos_sign_ok && c == '+') ||
+			                                (!tok->is_double && c == '.'))))
 			{
 				pos_sign_ok = neg_sign_ok = 0;
 				++case_len;
@@ -1015,6 +1507,9 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 
 				if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok))
 				{
+					tok->st_flags = (is_exponent ? JT_ST_EXPONENT : 0) |
+					                (neg_sign_ok ? JT_ST_NEG_OK : 0) |
+					                (pos_sign_ok ? JT_ST_POS_OK : 0);
 					printbuf_memappend_checked(tok->pb, case_start, case_len);
 					goto out;
 				}
@@ -1027,8 +1522,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				because c can be part of a new object to parse on the
 				next call to json_tokener_parse().
 			 */
-			if (tok->depth > 0 && c != ',' && c != ']' && c != '}' && c != '/' &&
-			    c != 'I' && c != 'i' && !is_ws_char(c))
+			if (tok->depth > 0 && !JT_CC(c, JT_CC_END))
 			{
 				tok->err = json_tokener_error_parse_number;
 				goto out;
@@ -1043,7 +1537,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				tok->st_pos = 0;
 				goto redo_char;
 			}
-			if (tok->is_double && !(tok->flags & JSON_TOKENER_STRICT))
+			if (tok->is_double && !(flags & JSON_TOKENER_STRICT))
 			{
 				/* Trim some chars off the end, to allow things
 				   like "123e+" to parse ok. */
@@ -1067,7 +1561,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				if (!tok->is_double && tok->pb->buf[0] == '-' &&
 				    json_parse_int64(tok->pb->buf, &num64) == 0)
 				{
-					if (errno == ERANGE && (tok->flags & JSON_TOKENER_STRICT))
+					if (errno == ERANGE && (flags & JSON_TOKENER_STRICT))
 					{
 						tok->err = json_tokener_error_parse_number;
 						goto out;
@@ -1082,13 +1576,13 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				else if (!tok->is_double && tok->pb->buf[0] != '-' &&
 				         json_parse_uint64(tok->pb->buf, &numuint64) == 0)
 				{
-					if (errno == ERANGE && (tok->flags & JSON_TOKENER_STRICT))
+					if (errno == ERANGE && (flags & JSON_TOKENER_STRICT))
 					{
 						tok->err = json_tokener_error_parse_number;
 						goto out;
 					}
 					if (numuint64 && tok->pb->buf[0] == '0' &&
-					    (tok->flags & JSON_TOKENER_STRICT))
+					    (flags & JSON_TOKENER_STRICT))
 					{
 						tok->err = json_tokener_error_parse_number;
 						goto out;
@@ -1140,10 +1634,10 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			if (c == ']')
 			{
 				// Minimize memory usage; assume parsed objs are unlikely to be changed
-				json_object_array_shrink(current, 0);
+				STATS_RESIZE(json_object_array_shrink(current, 0));
 
 				if (state == json_tokener_state_array_after_sep &&
-				    (tok->flags & JSON_TOKENER_STRICT))
+				    (flags & JSON_TOKENER_STRICT))
 				{
 					tok->err = json_tokener_error_parse_unexpected;
 					goto out;
@@ -1166,11 +1660,18 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			break;
 
 		case json_tokener_state_array_add:
-			if (json_object_array_add(current, obj) != 0)
+		{
+			int rc;
+
+			STATS_RESIZE(rc = json_object_array_add(current, obj));
+			if (rc != 0)
 			{
 				tok->err = json_tokener_error_memory;
 				goto out;
 			}
+			if (tok->limits != NULL && json_tokener_limit_add(tok, current) != 0)
+				goto out;
+		}
 			saved_state = json_tokener_state_array_sep;
 			state = json_tokener_state_eatws;
 			goto redo_char;
@@ -1179,7 +1680,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			if (c == ']')
 			{
 				// Minimize memory usage; assume parsed objs are unlikely to be changed
-				json_object_array_shrink(current, 0);
+				STATS_RESIZE(json_object_array_shrink(current, 0));
 
 				saved_state = json_tokener_state_finish;
 				state = json_tokener_state_eatws;
@@ -1201,7 +1702,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			if (c == '}')
 			{
 				if (state == json_tokener_state_object_field_start_after_sep &&
-				    (tok->flags & JSON_TOKENER_STRICT))
+				    (flags & JSON_TOKENER_STRICT))
 				{
 					tok->err = json_tokener_error_parse_unexpected;
 					goto out;
@@ -1228,11 +1729,27 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			const char *case_start = str;
 			while (1)
 			{
+				/* Most chars are copied as they are, so check for those first */
+				if (!JT_CC(c, JT_CC_STR))
+				{
+					if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok))
+					{
+						printbuf_memappend_limited(tok->pb, case_start,
+						                           str - case_start);
+						goto out;
+					}
+					continue;
+				}
 				if (c == tok->quote_char)
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
-					obj_field_name = strdup(tok->pb->buf);
+					if (tok->stats != NULL)
+						json_tokener_stats_string(tok, 1);
+					if (tok->limits != NULL &&
+					    json_tokener_limit_bytes(tok, tok->pb->bpos + 1) != 0)
+						goto out;
+					obj_field_name = json_c_strdup(tok->pb->buf);
 					if (obj_field_name == NULL)
 					{
 						tok->err = json_tokener_error_memory;
@@ -1244,7 +1761,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				}
 				else if (c == '\\')
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
 					saved_state = json_tokener_state_object_field;
 					state = json_tokener_state_string_escape;
@@ -1252,7 +1769,7 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 				}
 				if (!ADVANCE_CHAR(str, tok) || !PEEK_CHAR(c, tok))
 				{
-					printbuf_memappend_checked(tok->pb, case_start,
+					printbuf_memappend_limited(tok->pb, case_start,
 					                           str - case_start);
 					goto out;
 				}
@@ -1285,13 +1802,30 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 			goto redo_char;
 
 		case json_tokener_state_object_value_add:
-			if (json_object_object_add(current, obj_field_name, obj) != 0)
+		{
+			unsigned opts = JSON_C_OBJECT_ADD_TAKE_KEY;
+			int rc;
+
+			if (flags & JSON_TOKENER_UNIQUE_KEYS)
+				opts |= JSON_C_OBJECT_ADD_KEY_IS_NEW;
+			else if (flags & JSON_TOKENER_REJECT_DUPLICATE_KEYS)
+				opts |= JSON_C_OBJECT_ADD_IF_NEW;
+			/* The object takes over the key, even if adding it fails */
+			STATS_RESIZE(rc = json_object_object_add_ex(current, obj_field_name, obj,
+			                                            opts));
+			obj_field_name = NULL;
+			if (rc != 0)
 			{
-				tok->err = json_tokener_error_memory;
+				/* obj wasn't added, so it's still ours */
+				json_object_put(obj);
+				obj = NULL;
+				tok->err = (rc > 0) ? json_tokener_error_duplicate_key
+				                    : json_tokener_error_memory;
 				goto out;
 			}
-			free(obj_field_name);
-			obj_field_name = NULL;
+			if (tok->limits != NULL && json_tokener_limit_add(tok, current) != 0)
+				goto out;
+		}
 			saved_state = json_tokener_state_object_sep;
 			state = json_tokener_state_eatws;
 			goto redo_char;
@@ -1321,12 +1855,20 @@ struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *
 	} /* while(PEEK_CHAR) */
 
 out:
-	if ((tok->flags & JSON_TOKENER_VALIDATE_UTF8) && (nBytes != 0))
+#ifdef ENABLE_TOKENER_PROFILE
+	if (tok->stats != NULL)
 	{
-		tok->err = json_tokener_error_parse_utf8_string;
+		json_tokener_stats_time(tok, state);
+		stats_state(tok)->timed_since = 0;
 	}
+#endif
+	if (tok->stats != NULL)
+		tok->stats->bytes += tok->char_offset;
+	/* Only a sequence split at the end of the input carries over to the next call */
+	if (tok->err != json_tokener_continue)
+		tok->utf8_state = 0;
 	if (c && (state == json_tokener_state_finish) && (tok->depth == 0) &&
-	    (tok->flags & (JSON_TOKENER_STRICT | JSON_TOKENER_ALLOW_TRAILING_CHARS)) ==
+	    (flags & (JSON_TOKENER_STRICT | JSON_TOKENER_ALLOW_TRAILING_CHARS)) ==
 	        JSON_TOKENER_STRICT)
 	{
 		/* unexpected char after JSON data */
@@ -1344,48 +1886,207 @@ out:
 	freelocale(newloc);
 #elif defined(HAVE_SETLOCALE)
 	setlocale(LC_NUMERIC, oldlocale);
-	free(oldlocale);
+	json_c_free(oldlocale);
 #endif
 
-	if (tok->err == json_tokener_success)
+	/* The top level value is only counted against the limits now */
+	if (tok->err == json_tokener_success &&
+	    (tok->limits == NULL || json_tokener_limit_value(tok, current) == 0))
 	{
 		json_object *ret = json_object_get(current);
 		int ii;
 
+		if (tok->stats != NULL)
+			json_tokener_stats_value(tok, ret);
 		/* Partially reset, so we parse additional objects on subsequent calls. */
 		for (ii = tok->depth; ii >= 0; ii--)
 			json_tokener_reset_level(tok, ii);
+		if (tok->limits != NULL)
+			limits_state(tok)->bytes = limits_state(tok)->nodes = 0;
+		JSON_C_PROBE3(parse__done, tok, tok->char_offset, tok->err);
 		return ret;
 	}
 
 	MC_DEBUG("json_tokener_parse_ex: error %s at offset %d\n", json_tokener_errors[tok->err],
 	         tok->char_offset);
+	JSON_C_PROBE3(parse__done, tok, tok->char_offset, tok->err);
 	return NULL;
 }
 
-static json_bool json_tokener_validate_utf8(const char c, unsigned int *nBytes)
+struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *str, int len)
 {
-	unsigned char chr = c;
-	if (*nBytes == 0)
+	/*
+	 * With a budget, stop where it runs out, which looks to the parser
+	 * just like the end of a chunk.  A nul terminated str is counted up
+	 * to and including its nul, which then ends the input as len == -1
+	 * does, as long as it's within the budget.  Only the budget's worth of
+	 * str is looked at for the nul, so each call stays within it, rather
+	 * than each running strlen() over the rest of a long str.
+	 */
+	if (tok->budget > 0 && len >= -1)
 	{
-		if (chr >= 0x80)
+		size_t avail = (len == -1) ? strnlen(str, (size_t)tok->budget) + 1 : (size_t)len;
+		/* Otherwise it's too long, which the parser reports */
+		if (avail <= INT32_MAX)
 		{
-			if ((chr & 0xe0) == 0xc0)
-				*nBytes = 1;
-			else if ((chr & 0xf0) == 0xe0)
-				*nBytes = 2;
-			else if ((chr & 0xf8) == 0xf0)
-				*nBytes = 3;
-			else
-				return 0;
+			if (avail > (size_t)tok->budget)
+				len = tok->budget;
+			else if (len == -1)
+				len = (int)avail;
 		}
 	}
-	else
+
+	/* The common combinations of flags get a parser of their own */
+	switch (tok->flags)
 	{
-		if ((chr & 0xC0) != 0x80)
-			return 0;
-		(*nBytes)--;
+	case 0: return json_tokener_parse_flags(tok, str, len, 0);
+	case JSON_TOKENER_STRICT:
+		return json_tokener_parse_flags(tok, str, len, JSON_TOKENER_STRICT);
+	case JSON_TOKENER_STRICT | JSON_TOKENER_VALIDATE_UTF8:
+		return json_tokener_parse_flags(tok, str, len,
+		                                JSON_TOKENER_STRICT | JSON_TOKENER_VALIDATE_UTF8);
+	default: return json_tokener_parse_flags(tok, str, len, tok->flags);
+	}
+}
+
+int json_tokener_parse_many(struct json_tokener *tok, const char *str, int len,
+                            json_tokener_document_fn *fn, void *userdata)
+{
+	int saved_flags = tok->flags, saved_budget = tok->budget;
+	int pos = 0, count = 0;
+
+	if (len < -1 || (len == -1 && strlen(str) > INT32_MAX))
+	{
+		tok->err = json_tokener_error_size;
+		return -1;
 	}
+	if (len == -1)
+		len = (int)strlen(str);
+
+	json_tokener_reset(tok);
+	/* Each document is followed by another, which is fine even when strict */
+	tok->flags |= JSON_TOKENER_ALLOW_TRAILING_CHARS;
+	/* str holds whole documents, so stopping short would only be an error */
+	tok->budget = 0;
+	while (1)
+	{
+		struct json_object *jso;
+
+		/* Skip the whitespace and RS (0x1e) chars between documents */
+		while (pos < len && (is_ws_char(str[pos]) || str[pos] == '\x1e'))
+			pos++;
+		if (pos == len)
+			break;
+
+		jso = json_tokener_parse_ex(tok, str + pos, len - pos);
+		if (tok->err == json_tokener_continue)
+		{
+			/* A number, say, at the end of str, that has yet to see its end */
+			pos = len;
+			jso = json_tokener_parse_ex(tok, "", 1);
+			tok->char_offset = 0;
+			/* Anything else, "[1," for one, is simply cut off */
+			if (tok->err == json_tokener_continue)
+				tok->err = json_tokener_error_parse_eof;
+		}
+		/* Have json_tokener_get_parse_end() give the offset in str */
+		tok->char_offset += pos;
+		pos = tok->char_offset;
+		if (tok->err != json_tokener_success)
+		{
+			count = -1;
+			break;
+		}
+
+		count++;
+		if (fn == NULL)
+		{
+			if (json_object_array_add((struct json_object *)userdata, jso) != 0)
+			{
+				json_object_put(jso);
+				tok->err = json_tokener_error_memory;
+				count = -1;
+				break;
+			}
+		}
+		else if (fn(jso, userdata) != 0)
+		{
+			break;
+		}
+	}
+	tok->flags = saved_flags;
+	tok->budget = saved_budget;
+	return count;
+}
+
+/* The state after a lead byte b: continuation bytes to come and the range of the next */
+static unsigned int json_tokener_utf8_lead(unsigned int b)
+{
+	if (b >= 0xc2 && b <= 0xdf)
+		return UTF8_STATE(1, 0x80, 0xbf);
+	if (b == 0xe0) /* Not overlong */
+		return UTF8_STATE(2, 0xa0, 0xbf);
+	if (b == 0xed) /* Not a surrogate */
+		return UTF8_STATE(2, 0x80, 0x9f);
+	if (b >= 0xe1 && b <= 0xef)
+		return UTF8_STATE(2, 0x80, 0xbf);
+	if (b == 0xf0) /* Not overlong */
+		return UTF8_STATE(3, 0x90, 0xbf);
+	if (b >= 0xf1 && b <= 0xf3)
+		return UTF8_STATE(3, 0x80, 0xbf);
+	if (b == 0xf4) /* Not above U+10FFFF */
+		return UTF8_STATE(3, 0x80, 0x8f);
+	return 0;
+}
+
+static int json_tokener_validate_utf8(struct json_tokener *tok, const char *str, int len,
+                                      int *utf8_end, int *utf8_window)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	unsigned int pending = tok->utf8_state;
+	int ii = 0, n = len - tok->char_offset;
+
+	if (n > *utf8_window)
+		n = *utf8_window;
+	if (*utf8_window < UTF8_WINDOW_MAX)
+		*utf8_window *= 2;
+
+	while (ii < n)
+	{
+		unsigned int b;
+
+		if (pending == 0)
+		{
+			uint64_t word;
+
+			/* Skip ASCII eight bytes at a time */
+			while (ii + 8 <= n)
+			{
+				memcpy(&word, s + ii, sizeof(word));
+				if (word & 0x8080808080808080ULL)
+					break;
+				ii += 8;
+			}
+			if (ii == n)
+				break;
+			b = s[ii];
+			if (b >= 0x80 && (pending = json_tokener_utf8_lead(b)) == 0)
+				break;
+			ii++;
+			continue;
+		}
+		b = s[ii];
+		if (b < ((pending >> 8) & 0xff) || b > (pending >> 16))
+			break;
+		pending = (pending & 3) == 1 ? 0 : UTF8_STATE((pending & 3) - 1, 0x80, 0xbf);
+		ii++;
+	}
+
+	/* Either way, pending is the state before s[ii] */
+	if (ii < n && ii == 0)
+		return 0;
+	tok->utf8_state = pending;
+	*utf8_end = tok->char_offset + ii;
 	return 1;
 }
 
@@ -1394,6 +2095,17 @@ void json_tokener_set_flags(struct json_tokener *tok, int flags)
 	tok->flags = flags;
 }
 
+int json_tokener_set_budget(struct json_tokener *tok, int budget)
+{
+	if (budget < 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	tok->budget = budget;
+	return 0;
+}
+
 size_t json_tokener_get_parse_end(struct json_tokener *tok)
 {
 	assert(tok->char_offset >= 0); /* Drop this line when char_offset becomes a size_t */
@@ -41,7 +41,13 @@ enum json_tokener_error
 	json_tokener_error_parse_comment,
 	json_tokener_error_parse_utf8_string,
 	json_tokener_error_size,   /* A string longer than INT32_MAX was passed as input */
-	json_tokener_error_memory  /* Failed to allocate memory */
+	json_tokener_error_memory, /* Failed to allocate memory */
+	json_tokener_error_duplicate_key, /* With JSON_TOKENER_REJECT_DUPLICATE_KEYS */
+	json_tokener_error_limit_bytes,   /* Over json_tokener_limits.max_bytes */
+	json_tokener_error_limit_nodes,   /* Over json_tokener_limits.max_nodes */
+	json_tokener_error_limit_string,  /* Over json_tokener_limits.max_string_len */
+	json_tokener_error_limit_members, /* Over json_tokener_limits.max_object_members */
+	json_tokener_error_limit_array    /* Over json_tokener_limits.max_array_len */
 };
 
 /**
@@ -118,6 +124,26 @@ struct json_tokener
 	char quote_char;
 	struct json_tokener_srec *stack;
 	int flags;
+	/**
+	 * @deprecated See json_tokener_get_stats() instead.
+	 */
+	struct json_tokener_stats *stats;
+	/**
+	 * @deprecated A UTF-8 sequence split across calls, see JSON_TOKENER_VALIDATE_UTF8.
+	 */
+	unsigned int utf8_state;
+	/**
+	 * @deprecated What's been seen of a number or literal split across calls.
+	 */
+	unsigned int st_flags;
+	/**
+	 * @deprecated See json_tokener_set_budget() instead.
+	 */
+	int budget;
+	/**
+	 * @deprecated See json_tokener_set_limits() instead.
+	 */
+	struct json_tokener_limits *limits;
 };
 
 /**
@@ -172,12 +198,47 @@ typedef struct json_tokener json_tokener;
  * json_tokener_get_error(tok) will return
  * json_tokener_error_parse_utf8_string
  *
+ * Overlong encodings, surrogates and code points above U+10FFFF are
+ * invalid.  A sequence may be split across json_tokener_parse_ex() calls.
+ *
  * This flag is not set by default.
  *
  * @see json_tokener_set_flags()
  */
 #define JSON_TOKENER_VALIDATE_UTF8 0x10
 
+/**
+ * Trust that no object in the input has the same key twice, and add each
+ * member to its object without first looking for an existing one with the
+ * same key, as with JSON_C_OBJECT_ADD_KEY_IS_NEW.  This saves a hash table
+ * lookup per member.
+ *
+ * If the input does have duplicate keys anyway, the object ends up with
+ * all of them, and which one json_object_object_get_ex() finds, and the
+ * order json_object_to_json_string() writes them in, is unspecified.
+ * Without this flag, the last value for a key replaces the others.
+ *
+ * This flag is not set by default.
+ *
+ * @see json_tokener_set_flags()
+ * @see JSON_TOKENER_REJECT_DUPLICATE_KEYS
+ */
+#define JSON_TOKENER_UNIQUE_KEYS 0x20
+
+/**
+ * Fail with json_tokener_error_duplicate_key when an object in the input
+ * has the same key twice, instead of having the last value for the key
+ * replace the others.  The check is made while looking for a free slot for
+ * the key in the object's hash table, so it costs nothing extra.
+ *
+ * JSON_TOKENER_UNIQUE_KEYS takes precedence if both are set.
+ *
+ * This flag is not set by default.
+ *
+ * @see json_tokener_set_flags()
+ */
+#define JSON_TOKENER_REJECT_DUPLICATE_KEYS 0x40
+
 /**
  * Given an error previously returned by json_tokener_get_error(),
  * return a human readable description of the error.
@@ -244,6 +305,158 @@ JSON_EXPORT struct json_object *json_tokener_parse_verbose(const char *str,
  */
 JSON_EXPORT void json_tokener_set_flags(struct json_tokener *tok, int flags);
 
+/**
+ * Limit how much of its input each call to json_tokener_parse_ex() looks
+ * at, so that parsing a large document can be spread over several calls,
+ * e.g. between other work on an event loop, instead of taking as long as
+ * the whole document takes.
+ *
+ * When a call stops because it has used up its budget, it returns NULL
+ * with json_tokener_get_error() returning json_tokener_continue, just as
+ * if the input had ended there, and json_tokener_get_parse_end() is less
+ * than the length passed in.  The next call should be passed the rest of
+ * the input, starting from there, and carries on where the last one left
+ * off:
+ *
+ * @code
+json_tokener_set_budget(tok, 64 * 1024);
+do {
+	jobj = json_tokener_parse_ex(tok, str, len);
+	// Consumed json_tokener_get_parse_end(tok) bytes of str
+	str += json_tokener_get_parse_end(tok);
+	len -= json_tokener_get_parse_end(tok);
+	// ...let other work run...
+} while (len > 0 && json_tokener_get_error(tok) == json_tokener_continue);
+@endcode
+ *
+ * The time a call takes is then roughly bounded by the budget, since the
+ * tokener does a bounded amount of work per byte.  The budget applies to
+ * json_tokener_parse_ex() only; json_tokener_parse_many() ignores it.
+ *
+ * @param tok the tokener
+ * @param budget the most bytes to look at per call, or 0 for no limit,
+ *        which is the default
+ * @return 0, or -1 if budget is negative
+ */
+JSON_EXPORT int json_tokener_set_budget(struct json_tokener *tok, int budget);
+
+/**
+ * Limits on what a single document may make json_tokener_parse_ex()
+ * allocate, for parsing untrusted input, in addition to the nesting depth
+ * given to json_tokener_new_ex().  A limit of 0 means no limit.
+ *
+ * Each has its own json_tokener_error, which json_tokener_parse_ex() fails
+ * with as soon as the limit is exceeded, without parsing any further.
+ * As with any other error, what had been parsed of the document is freed
+ * by json_tokener_reset() or json_tokener_free().
+ *
+ * @see json_tokener_set_limits()
+ */
+struct json_tokener_limits
+{
+	/**
+	 * Bytes allocated for the values, keys and array and object slots of a
+	 * document, as estimated by the tokener from the sizes of json-c's
+	 * structures; it doesn't see the allocator's own overhead.  Memory
+	 * freed while parsing, e.g. when a duplicate key replaces a value,
+	 * still counts.  Fails with json_tokener_error_limit_bytes.
+	 */
+	size_t max_bytes;
+	/**
+	 * Values in a document, counting arrays, objects and nulls as well as
+	 * what's in them.  Fails with json_tokener_error_limit_nodes.
+	 */
+	size_t max_nodes;
+	/**
+	 * Length in bytes, once unescaped, of a string or object key.  It's
+	 * checked before each piece of the string is copied into the tokener's
+	 * buffer, so a longer one, even if split across calls, never is.
+	 * Fails with json_tokener_error_limit_string.
+	 */
+	size_t max_string_len;
+	/** Members of an object.  Fails with json_tokener_error_limit_members. */
+	size_t max_object_members;
+	/** Elements of an array.  Fails with json_tokener_error_limit_array. */
+	size_t max_array_len;
+};
+
+/**
+ * Set the limits on each document that tok parses, replacing any set
+ * before, or remove them if limits is NULL.  What's already been parsed of
+ * the current document counts towards the new limits.
+ *
+ * Without limits, which is the default, parsing doesn't check for them at
+ * all; with them, it costs a few comparisons per value.
+ *
+ * @see struct json_tokener_limits
+ * @return 0, or -1 if memory for the limits couldn't be allocated
+ */
+JSON_EXPORT int json_tokener_set_limits(struct json_tokener *tok,
+                                        const struct json_tokener_limits *limits);
+
+/**
+ * Counters collected by json_tokener_parse_ex() once
+ * json_tokener_enable_stats() has been called.
+ *
+ * They accumulate over every call to json_tokener_parse_ex(), across
+ * documents and across json_tokener_reset(), until stats are enabled again.
+ */
+struct json_tokener_stats
+{
+	/** Bytes of input consumed */
+	size_t bytes;
+	/** Values parsed, by type, including those in arrays and objects */
+	size_t values[json_type_string + 1];
+	/** Strings and object keys without, and with, escape sequences */
+	size_t strings_clean;
+	size_t strings_escaped;
+	/** Object keys */
+	size_t keys;
+	/**
+	 * The deepest nesting seen, i.e. the smallest depth that
+	 * json_tokener_new_ex() could have been given for the input.
+	 * Arrays and objects count from when they're opened, so after
+	 * json_tokener_error_depth this is the depth that was reached.
+	 */
+	int max_depth;
+	/** Times the buffer that tokens are gathered in had to grow */
+	size_t printbuf_grows;
+	/** Times an array or object was reallocated to grow or shrink it */
+	size_t container_resizes;
+	/**
+	 * A lower bound on the number of allocations made: one for each non-null value,
+	 * key, buffer growth and container resize.  Objects and arrays also
+	 * allocate their hash table or element list.
+	 */
+	size_t allocs;
+	/**
+	 * Nanoseconds spent in each json_tokener_state.  Only collected when
+	 * json-c is built with ENABLE_TOKENER_PROFILE, which reads the clock
+	 * on every state transition and so slows parsing down considerably;
+	 * otherwise all zero.
+	 */
+	uint64_t state_ns[json_tokener_state_inf + 1];
+};
+
+/**
+ * Start collecting statistics about what tok parses, see
+ * struct json_tokener_stats.  If they are already being collected,
+ * the counters are cleared.  Passing enable=0 stops collecting them.
+ *
+ * Collecting stats costs little, so it can be left on in production to
+ * attribute parsing costs to the shapes of the documents being parsed.
+ *
+ * @return 0 on success, or -1 if memory for the counters couldn't be allocated
+ */
+JSON_EXPORT int json_tokener_enable_stats(struct json_tokener *tok, int enable);
+
+/**
+ * Return the statistics collected for tok, or NULL if they aren't enabled.
+ *
+ * @see json_tokener_enable_stats()
+ */
+JSON_EXPORT const struct json_tokener_stats *json_tokener_get_stats(const struct json_tokener *tok);
+
 /**
  * Parse a string and return a non-NULL json_object if a valid JSON value
  * is found.  The string does not need to be a JSON object or array;
@@ -323,6 +536,43 @@ if (json_tokener_get_parse_end(tok) < stringlen)
 JSON_EXPORT struct json_object *json_tokener_parse_ex(struct json_tokener *tok, const char *str,
                                                       int len);
 
+/**
+ * Called by json_tokener_parse_many() with each document parsed, which
+ * belongs to the callback, and is NULL for a document that's just null.
+ *
+ * @return 0 to go on to the next document, or anything else to stop
+ */
+typedef int(json_tokener_document_fn)(struct json_object *jso, void *userdata);
+
+/**
+ * Parse every JSON text in str, a buffer that holds several of them one
+ * after the other, such as newline delimited JSON, whitespace separated
+ * values, or an RFC 7464 JSON text sequence, whose record separators are
+ * skipped like whitespace.
+ *
+ * This does what a loop around json_tokener_parse_ex() with
+ * JSON_TOKENER_ALLOW_TRAILING_CHARS would, without resetting the tokener
+ * between documents, so that its buffers are reused for all of them.
+ * str must hold whole documents: a document cut off by the end of str is
+ * an error, not json_tokener_continue.
+ *
+ * If fn is NULL, userdata must be an array, and each document is added to
+ * it in turn.  Freeing the array then frees them all at once.
+ *
+ * @param tok a json_tokener, with any flags set, whose state is reset first
+ * @param str the buffer to parse
+ * @param len the length of str, or -1 if it's nul terminated
+ * @param fn called with each document, or NULL
+ * @param userdata passed to fn, or the array to add documents to
+ * @return the number of documents parsed, including the one that fn
+ *         stopped after, if it did; or -1 if there was an error, with
+ *         json_tokener_get_error() saying what it was and
+ *         json_tokener_get_parse_end() where in str it was found, and with
+ *         fn having been called with the documents before it
+ */
+JSON_EXPORT int json_tokener_parse_many(struct json_tokener *tok, const char *str, int len,
+                                        json_tokener_document_fn *fn, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif
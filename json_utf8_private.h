@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026 the json-c authors
+ *
+ * This is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ */
+
+/**
+ * @file
+ * @brief Do not use, json-c internal, may be changed or removed at any time.
+ */
+#ifndef _json_utf8_private_h_
+#define _json_utf8_private_h_
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stuff for decoding \uXXXX escapes, shared by json_tokener.c and json_tape.c */
+#define IS_HIGH_SURROGATE(uc) (((uc)&0xFC00) == 0xD800)
+#define IS_LOW_SURROGATE(uc) (((uc)&0xFC00) == 0xDC00)
+#define DECODE_SURROGATE_PAIR(hi, lo) ((((hi)&0x3FF) << 10) + ((lo)&0x3FF) + 0x10000)
+
+/* U+FFFD, which stands in for anything that can't be decoded */
+#define JSON_UTF8_REPLACEMENT_CHAR "\xEF\xBF\xBD"
+
+/*
+ * Store the UTF-8 for ucs in out.  Surrogates, which only make sense as
+ * a pair, and values past U+10FFFF get the replacement char.
+ * Returns the number of bytes stored, at most 4.
+ */
+static inline int json_utf8_put(unsigned int ucs, unsigned char *out)
+{
+	if (ucs < 0x80)
+	{
+		out[0] = ucs;
+		return 1;
+	}
+	if (ucs < 0x800)
+	{
+		out[0] = 0xc0 | (ucs >> 6);
+		out[1] = 0x80 | (ucs & 0x3f);
+		return 2;
+	}
+	if (IS_HIGH_SURROGATE(ucs) || IS_LOW_SURROGATE(ucs) || ucs >= 0x110000)
+	{
+		memcpy(out, JSON_UTF8_REPLACEMENT_CHAR, 3);
+		return 3;
+	}
+	if (ucs < 0x10000)
+	{
+		out[0] = 0xe0 | (ucs >> 12);
+		out[1] = 0x80 | ((ucs >> 6) & 0x3f);
+		out[2] = 0x80 | (ucs & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | ((ucs >> 18) & 0x07);
+	out[1] = 0x80 | ((ucs >> 12) & 0x3f);
+	out[2] = 0x80 | ((ucs >> 6) & 0x3f);
+	out[3] = 0x80 | (ucs & 0x3f);
+	return 4;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,6 +31,9 @@
 #include <windows.h> /* Get InterlockedCompareExchange */
 #endif
 
+#include "json_alloc_private.h"
+#include "json_object_private.h"
+#include "json_probes_private.h"
 #include "linkhash.h"
 #include "random_seed.h"
 
@@ -504,16 +507,16 @@ struct lh_table *lh_table_new(int size, lh_entry_free_fn *free_fn, lh_hash_fn *h
 
 	/* Allocate space for elements to avoid divisions by zero. */
 	assert(size > 0);
-	t = (struct lh_table *)calloc(1, sizeof(struct lh_table));
+	t = (struct lh_table *)json_c_calloc(1, sizeof(struct lh_table));
 	if (!t)
 		return NULL;
 
 	t->count = 0;
 	t->size = size;
-	t->table = (struct lh_entry *)calloc(size, sizeof(struct lh_entry));
+	t->table = (struct lh_entry *)json_c_calloc(size, sizeof(struct lh_entry));
 	if (!t->table)
 	{
-		free(t);
+		json_c_free(t);
 		return NULL;
 	}
 	t->free_fn = free_fn;
@@ -539,9 +542,13 @@ int lh_table_resize(struct lh_table *t, int new_size)
 	struct lh_table *new_t;
 	struct lh_entry *ent;
 
+	JSON_C_PROBE4(table__resize__start, t, t->count, t->size, new_size);
 	new_t = lh_table_new(new_size, NULL, t->hash_fn, t->equal_fn);
 	if (new_t == NULL)
+	{
+		JSON_C_PROBE3(table__resize__done, t, new_size, 0);
 		return -1;
+	}
 
 	for (ent = t->head; ent != NULL; ent = ent->next)
 	{
@@ -552,16 +559,18 @@ int lh_table_resize(struct lh_table *t, int new_size)
 		if (lh_table_insert_w_hash(new_t, ent->k, ent->v, h, opts) != 0)
 		{
 			lh_table_free(new_t);
+			JSON_C_PROBE3(table__resize__done, t, new_size, 0);
 			return -1;
 		}
 	}
-	free(t->table);
+	json_c_free(t->table);
 	t->table = new_t->table;
 	t->size = new_size;
 	t->head = new_t->head;
 	t->tail = new_t->tail;
-	free(new_t);
+	json_c_free(new_t);
 
+	JSON_C_PROBE3(table__resize__done, t, new_size, 1);
 	return 0;
 }
 
@@ -573,8 +582,8 @@ void lh_table_free(struct lh_table *t)
 		for (c = t->head; c != NULL; c = c->next)
 			t->free_fn(c);
 	}
-	free(t->table);
-	free(t);
+	json_c_free(t->table);
+	json_c_free(t);
 }
 
 int lh_table_insert_w_hash(struct lh_table *t, const void *k, const void *v, const unsigned long h,
@@ -592,12 +601,39 @@ int lh_table_insert_w_hash(struct lh_table *t, const void *k, const void *v, con
 
 	n = h % t->size;
 
-	while (1)
+	if (opts & JSON_C_OBJECT_ADD_IF_NEW)
 	{
-		if (t->table[n].k == LH_EMPTY || t->table[n].k == LH_FREED)
-			break;
-		if ((int)++n == t->size)
-			n = 0;
+		/* Look for k on the way to the end of its run of slots, and
+		 * insert it into the first free one if it's not there. */
+		long slot = -1;
+		int count;
+
+		for (count = 0; count < t->size; count++)
+		{
+			if (t->table[n].k == LH_EMPTY)
+				break;
+			if (t->table[n].k == LH_FREED)
+			{
+				if (slot < 0)
+					slot = (long)n;
+			}
+			else if (t->equal_fn(t->table[n].k, k))
+				return 1;
+			if ((int)++n == t->size)
+				n = 0;
+		}
+		if (slot >= 0)
+			n = (unsigned long)slot;
+	}
+	else
+	{
+		while (1)
+		{
+			if (t->table[n].k == LH_EMPTY || t->table[n].k == LH_FREED)
+				break;
+			if ((int)++n == t->size)
+				n = 0;
+		}
 	}
 
 	t->table[n].k = k;
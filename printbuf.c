@@ -28,6 +28,8 @@
 #endif /* HAVE_STDARG_H */
 
 #include "debug.h"
+#include "json_alloc_private.h"
+#include "json_probes_private.h"
 #include "printbuf.h"
 #include "snprintf_compat.h"
 #include "vasprintf_compat.h"
@@ -38,14 +40,14 @@ struct printbuf *printbuf_new(void)
 {
 	struct printbuf *p;
 
-	p = (struct printbuf *)calloc(1, sizeof(struct printbuf));
+	p = (struct printbuf *)json_c_calloc(1, sizeof(struct printbuf));
 	if (!p)
 		return NULL;
 	p->size = 32;
 	p->bpos = 0;
-	if (!(p->buf = (char *)malloc(p->size)))
+	if (!(p->buf = (char *)json_c_malloc(p->size)))
 	{
-		free(p);
+		json_c_free(p);
 		return NULL;
 	}
 	p->buf[0] = '\0';
@@ -87,7 +89,10 @@ static int printbuf_extend(struct printbuf *p, int min_size)
 	         "bpos=%d min_size=%d old_size=%d new_size=%d\n",
 	         p->bpos, min_size, p->size, new_size);
 #endif /* PRINTBUF_DEBUG */
-	if (!(t = (char *)realloc(p->buf, new_size)))
+	JSON_C_PROBE4(printbuf__extend__start, p, p->bpos, p->size, new_size);
+	t = (char *)json_c_realloc(p->buf, new_size);
+	JSON_C_PROBE3(printbuf__extend__done, p, new_size, t != NULL);
+	if (!t)
 		return -1;
 	p->size = new_size;
 	p->buf = t;
@@ -167,6 +172,7 @@ int sprintbuf(struct printbuf *p, const char *msg, ...)
 		}
 		va_end(ap);
 		size = printbuf_memappend(p, t, size);
+		/* Allocated by vasprintf(), not json_c_malloc() */
 		free(t);
 	}
 	else
@@ -186,7 +192,7 @@ void printbuf_free(struct printbuf *p)
 {
 	if (p)
 	{
-		free(p->buf);
-		free(p);
+		json_c_free(p->buf);
+		json_c_free(p);
 	}
 }
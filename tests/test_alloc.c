@@ -0,0 +1,144 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "json_alloc.h"
+
+/* Keep the size of each block in front of it, so frees can be accounted for */
+#define HDR 16
+
+static size_t nmalloc, nrealloc, nfree, live_bytes;
+
+static void *count_malloc(size_t size)
+{
+	char *p = malloc(size + HDR);
+
+	if (p == NULL)
+		return NULL;
+	nmalloc++;
+	live_bytes += size;
+	memcpy(p, &size, sizeof(size));
+	return p + HDR;
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	char *p;
+	size_t old;
+
+	if (ptr == NULL)
+		return count_malloc(size);
+	p = (char *)ptr - HDR;
+	memcpy(&old, p, sizeof(old));
+	p = realloc(p, size + HDR);
+	if (p == NULL)
+		return NULL;
+	nrealloc++;
+	live_bytes += size - old;
+	memcpy(p, &size, sizeof(size));
+	return p + HDR;
+}
+
+static void count_free(void *ptr)
+{
+	size_t size;
+
+	if (ptr == NULL)
+		return;
+	memcpy(&size, (char *)ptr - HDR, sizeof(size));
+	nfree++;
+	live_bytes -= size;
+	free((char *)ptr - HDR);
+}
+
+static void report(const char *what)
+{
+	printf("%s: mallocs %d, reallocs %d, all freed: %d\n", what, nmalloc > 0, nrealloc > 0,
+	       nmalloc == nfree && live_bytes == 0);
+	nmalloc = nrealloc = nfree = 0;
+}
+
+int main(void)
+{
+	json_c_malloc_fn *m;
+	json_c_free_fn *f;
+	struct json_object *jso, *copy;
+	json_tokener *tok;
+	char key[16];
+	int ii;
+
+	errno = 0;
+	printf("partial set fails: %d", json_c_set_alloc_funcs(count_malloc, NULL, count_free));
+	printf(" EINVAL: %d\n", errno == EINVAL);
+	assert(json_c_set_alloc_funcs(count_malloc, count_realloc, count_free) == 0);
+	json_c_get_alloc_funcs(&m, NULL, &f);
+	printf("get returns the new functions: %d\n", m == count_malloc && f == count_free);
+
+	tok = json_tokener_new();
+	jso = json_tokener_parse_ex(tok, "{ \"a\": [1, 2.50, \"three\"], \"b\": { \"c\": null } }",
+	                            -1);
+	json_tokener_free(tok);
+	assert(jso != NULL);
+	for (ii = 0; ii < 100; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_add(jso, key, json_object_new_string("not a short value"));
+	}
+	printf("serialized length: %d\n", (int)strlen(json_object_to_json_string(jso)));
+	json_object_set_string(json_object_object_get(jso, "key0"),
+	                       "grown well past its original length");
+	json_object_deep_copy(jso, &copy, NULL);
+	json_object_put(jso);
+	json_object_put(copy);
+	report("parse, serialize, copy and free");
+
+	/* The tokener hands its copy of each key to the object, instead of copying it again */
+	{
+		struct printbuf *obj_pb = printbuf_new(), *arr_pb = printbuf_new();
+		size_t start, obj_mallocs;
+
+		printbuf_strappend(obj_pb, "{");
+		printbuf_strappend(arr_pb, "[");
+		for (ii = 0; ii < 100; ii++)
+		{
+			sprintbuf(obj_pb, "%s\"key%d\": %d", ii ? "," : "", ii, ii);
+			sprintbuf(arr_pb, "%s%d", ii ? "," : "", ii);
+		}
+		printbuf_strappend(obj_pb, "}");
+		printbuf_strappend(arr_pb, "]");
+		start = nmalloc;
+		json_object_put(json_tokener_parse(obj_pb->buf));
+		obj_mallocs = nmalloc - start;
+		start = nmalloc;
+		json_object_put(json_tokener_parse(arr_pb->buf));
+		/* Beyond the keys, only the hash table's resizes */
+		printf("at most one malloc per key: %d\n",
+		       obj_mallocs - (nmalloc - start) <= 100 + 16);
+		printbuf_free(obj_pb);
+		printbuf_free(arr_pb);
+		report("keys");
+	}
+
+	/* Userdata for json_object_free_userdata() comes from the same allocator */
+	jso = json_object_new_int(42);
+	json_object_set_serializer(jso, json_object_userdata_to_json_string,
+	                           strcpy(m(sizeof("forty-two")), "forty-two"),
+	                           json_object_free_userdata);
+	printf("custom serializer: %s\n", json_object_to_json_string(jso));
+	json_object_put(jso);
+	report("userdata");
+
+	assert(json_c_set_alloc_funcs(NULL, NULL, NULL) == 0);
+	json_c_get_alloc_funcs(&m, NULL, NULL);
+	printf("defaults restored: %d\n", m == malloc);
+	jso = json_tokener_parse("[1, 2, 3]");
+	json_object_put(jso);
+	printf("unused after reset: %d\n", nmalloc == 0 && nfree == 0);
+	return 0;
+}
@@ -0,0 +1,155 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+static void print_layout(const char *name, struct json_object *jso)
+{
+	switch (json_object_get_type(jso))
+	{
+	case json_type_object:
+		printf("%s: %d members in a table of %d\n", name, json_object_object_length(jso),
+		       json_object_get_object(jso)->size);
+		break;
+	case json_type_array:
+		printf("%s: %d elements in an array of %d\n", name,
+		       (int)json_object_array_length(jso), (int)json_object_get_array(jso)->size);
+		break;
+	default: break;
+	}
+}
+
+static void test_edited_tree(void)
+{
+	struct json_object *root = json_tokener_parse("{ \"pi\": 3.140, \"config\": {} }");
+	struct json_object *config, *list, *shared, *str;
+	char *before;
+	char key[32];
+	int ii;
+
+	config = json_object_object_get(root, "config");
+	list = json_object_new_array_ext(100);
+	json_object_object_add(config, "list", list);
+	for (ii = 0; ii < 10; ii++)
+		json_object_array_add(list, json_object_new_int(ii));
+
+	/* Leave plenty of LH_FREED slots behind */
+	for (ii = 0; ii < 200; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_add(config, key, json_object_new_int(ii));
+	}
+	for (ii = 0; ii < 200; ii++)
+	{
+		if (ii % 50 == 0)
+			continue;
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_del(config, key);
+	}
+	json_object_object_add_ex(config, "constant", json_object_new_boolean(1),
+	                          JSON_C_OBJECT_ADD_CONSTANT_KEY);
+
+	/* A string that json_object_set_string() moved out of line */
+	str = json_object_new_string("short");
+	json_object_set_string(str, "a much longer string than the original one");
+	json_object_array_add(list, str);
+
+	/* A shared object must stay where it is */
+	shared = json_object_new_string("shared");
+	json_object_object_add(root, "shared", json_object_get(shared));
+
+	/* Cached serializations are dropped */
+	json_object_to_json_string(config);
+
+	before = strdup(json_object_to_json_string(root));
+	print_layout("before: config", config);
+	print_layout("before: list", list);
+
+	assert(json_object_compact(root) == 0);
+
+	printf("unchanged: %d\n", strcmp(before, json_object_to_json_string(root)) == 0);
+	printf("%s\n", json_object_to_json_string(root));
+	config = json_object_object_get(root, "config");
+	list = json_object_object_get(config, "list");
+	print_layout("after: root", root);
+	print_layout("after: config", config);
+	print_layout("after: list", list);
+	printf("shared object not moved: %d\n", json_object_object_get(root, "shared") == shared);
+	printf("moved string: %s\n", json_object_get_string(json_object_array_get_idx(list, 10)));
+
+	/* The compacted tree must still be fully usable */
+	json_object_object_add(config, "added", json_object_new_string("after compacting"));
+	json_object_array_add(list, json_object_new_null());
+	json_object_set_string(json_object_array_get_idx(list, 10), "x");
+	printf("modified: %s\n", json_object_to_json_string(config));
+
+	free(before);
+	json_object_put(shared);
+	json_object_put(root);
+}
+
+static void test_special_cases(void)
+{
+	struct json_object *jso;
+
+	printf("compact(NULL): %d\n", json_object_compact(NULL));
+
+	jso = json_object_new_string("scalar root");
+	printf("compact(string): %d", json_object_compact(jso));
+	printf(" %s\n", json_object_to_json_string(jso));
+	json_object_put(jso);
+
+	jso = json_tokener_parse("[[], {}, [[[1.0e2]]], {\"a\": {\"b\": null}}]");
+	printf("compact(nested): %d", json_object_compact(jso));
+	printf(" %s\n", json_object_to_json_string(jso));
+	print_layout("empty array", json_object_array_get_idx(jso, 0));
+	print_layout("empty object", json_object_array_get_idx(jso, 1));
+	json_object_put(jso);
+}
+
+/* Deep enough to overflow the stack if compacting recursed */
+#define DEPTH 200000
+
+static void test_deep_tree(void)
+{
+	struct json_tokener *tok = json_tokener_new_ex(DEPTH + 1);
+	struct printbuf *pb = printbuf_new();
+	struct json_object *jso, *it;
+	int ii, levels = 0;
+
+	for (ii = 0; ii < DEPTH; ii++)
+		printbuf_memappend(pb, (ii % 2) ? "{\"a\":" : "[0,", (ii % 2) ? 5 : 3);
+	printbuf_strappend(pb, "\"bottom\"");
+	for (ii = DEPTH - 1; ii >= 0; ii--)
+		printbuf_memappend(pb, (ii % 2) ? "}" : "]", 1);
+	jso = json_tokener_parse_ex(tok, pb->buf, printbuf_length(pb));
+	assert(jso != NULL);
+
+	printf("compact(deep): %d\n", json_object_compact(jso));
+	for (it = jso; json_object_is_type(it, json_type_array) ||
+	               json_object_is_type(it, json_type_object);
+	     levels++)
+	{
+		if (json_object_is_type(it, json_type_array))
+			it = json_object_array_get_idx(it, 1);
+		else
+			it = json_object_object_get(it, "a");
+	}
+	printf("deep tree: %d levels, then %s\n", levels, json_object_get_string(it));
+	json_object_put(jso);
+	printbuf_free(pb);
+	json_tokener_free(tok);
+}
+
+int main(void)
+{
+	test_edited_tree();
+	test_special_cases();
+	test_deep_tree();
+	return 0;
+}
@@ -0,0 +1,123 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+/* Deep enough to overflow the stack if freeing recursed */
+#define DEPTH 200000
+
+static int user_deletes;
+
+static void count_delete(struct json_object *jso, void *userdata)
+{
+	user_deletes++;
+}
+
+static struct json_object *make_deep_array(int depth)
+{
+	struct json_object *root = json_object_new_array_ext(1);
+	struct json_object *cur = root;
+	int ii;
+
+	for (ii = 1; ii < depth; ii++)
+	{
+		struct json_object *next = json_object_new_array_ext(1);
+
+		json_object_array_add(cur, next);
+		cur = next;
+	}
+	json_object_array_add(cur, json_object_new_string("bottom"));
+	return root;
+}
+
+static struct json_object *make_deep_object(int depth)
+{
+	struct json_object *root = json_object_new_object();
+	struct json_object *cur = root;
+	int ii;
+
+	for (ii = 1; ii < depth; ii++)
+	{
+		struct json_object *next = json_object_new_object();
+
+		json_object_object_add(cur, "a", json_object_new_int(ii));
+		json_object_object_add(cur, "next", next);
+		cur = next;
+	}
+	return root;
+}
+
+static void test_deep_put(void)
+{
+	struct json_object *jso;
+
+	jso = make_deep_array(DEPTH);
+	printf("put deep array: %d\n", json_object_put(jso));
+	jso = make_deep_object(DEPTH);
+	printf("put deep object: %d\n", json_object_put(jso));
+}
+
+static void test_shared_and_userdata(void)
+{
+	struct json_object *root = json_tokener_parse("{ \"list\": [ 1, [ 2 ], { \"x\": 3 } ] }");
+	struct json_object *list = json_object_object_get(root, "list");
+	struct json_object *inner = json_object_array_get_idx(list, 2);
+
+	/* A member that is still referenced elsewhere must survive */
+	json_object_get(list);
+	json_object_set_userdata(inner, NULL, count_delete);
+	json_object_set_userdata(json_object_object_get(inner, "x"), NULL, count_delete);
+	printf("put root: %d\n", json_object_put(root));
+	printf("list survives: %s\n", json_object_to_json_string(list));
+	printf("user deletes before: %d\n", user_deletes);
+	printf("put list: %d\n", json_object_put(list));
+	printf("user deletes after: %d\n", user_deletes);
+}
+
+static void test_deferred(void)
+{
+	struct json_object *shared = json_object_new_string("shared");
+	struct json_object *jso;
+	size_t total, batch;
+	int batches = 0;
+
+	printf("reclaim with nothing queued: %d\n", (int)json_c_reclaim_deferred(0));
+	printf("put_deferred(NULL): %d\n", json_object_put_deferred(NULL));
+	printf("put_deferred(shared ref): %d\n",
+	       json_object_put_deferred(json_object_get(shared)));
+	printf("shared object still usable: %s\n", json_object_get_string(shared));
+
+	jso = json_object_new_array();
+	json_object_set_userdata(jso, NULL, count_delete);
+	user_deletes = 0;
+	printf("put_deferred(array): %d\n", json_object_put_deferred(jso));
+	printf("user delete called immediately: %d\n", user_deletes);
+	printf("put_deferred(shared): %d\n", json_object_put_deferred(shared));
+	printf("reclaim all: %d\n", (int)json_c_reclaim_deferred(0));
+
+	/* A deep tree, freed in bounded batches */
+	json_object_put_deferred(make_deep_array(1000));
+	json_object_put_deferred(make_deep_object(10));
+	total = 0;
+	while ((batch = json_c_reclaim_deferred(300)) > 0)
+	{
+		assert(batch <= 300);
+		total += batch;
+		batches++;
+	}
+	/* 1000 arrays plus a string, 10 objects plus 9 ints */
+	printf("reclaimed %d objects in %d batches\n", (int)total, batches);
+}
+
+int main(void)
+{
+	test_deep_put();
+	test_shared_and_userdata();
+	test_deferred();
+	return 0;
+}
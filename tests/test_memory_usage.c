@@ -0,0 +1,127 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+/*
+ * Byte counts depend on the platform, so only print the counts, and
+ * check the byte counts against each other.
+ */
+static void print_counts(const char *name, const struct json_object_memory_stats *st)
+{
+	int ii;
+
+	printf("%s:", name);
+	for (ii = json_type_boolean; ii <= json_type_string; ii++)
+		printf(" %s=%d", json_type_to_name((enum json_type)ii), (int)st->count[ii]);
+	printf("\n");
+}
+
+static int total_is_consistent(const struct json_object_memory_stats *st)
+{
+	size_t total = st->table_bytes + st->array_bytes + st->key_bytes + st->string_bytes +
+	               st->printbuf_bytes;
+	int ii;
+
+	for (ii = 0; ii <= json_type_string; ii++)
+		total += st->node_bytes[ii];
+	return total == st->total_bytes && st->table_unused_bytes <= st->table_bytes &&
+	       st->array_unused_bytes <= st->array_bytes && st->compact_savings <= total;
+}
+
+static void test_document(void)
+{
+	struct json_object *root = json_tokener_parse(
+	    "{ \"name\": \"memory\", \"pi\": 3.140, \"ok\": true, \"list\": [ 1, 2, \"three\" ],"
+	    "  \"nested\": { \"a\": null, \"b\": [] } }");
+	struct json_object_memory_stats st, st2;
+	char key[32];
+	int ii;
+
+	assert(json_object_memory_usage(root, &st) == 0);
+	print_counts("parsed", &st);
+	printf("consistent: %d\n", total_is_consistent(&st));
+	printf("has keys: %d, has double text: %d, no printbufs: %d\n", st.key_bytes > 0,
+	       st.string_bytes > 0, st.printbuf_bytes == 0);
+
+	json_object_to_json_string(root);
+	assert(json_object_memory_usage(root, &st2) == 0);
+	printf("printbuf counted: %d\n",
+	       st2.printbuf_bytes > 0 && st2.total_bytes == st.total_bytes + st2.printbuf_bytes);
+
+	/* Grow, then mostly empty, the nested object */
+	for (ii = 0; ii < 100; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_add(json_object_object_get(root, "nested"), key,
+		                       json_object_new_int(ii));
+	}
+	for (ii = 0; ii < 100; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_del(json_object_object_get(root, "nested"), key);
+	}
+	json_object_set_string(json_object_object_get(root, "name"),
+	                       "a much longer name than before");
+	assert(json_object_memory_usage(root, &st) == 0);
+	print_counts("edited", &st);
+	printf("consistent: %d\n", total_is_consistent(&st));
+	printf("unused table slots grew: %d\n", st.table_unused_bytes > st2.table_unused_bytes);
+	printf("compaction would save: %d\n", st.compact_savings > 0);
+
+	assert(json_object_compact(root) == 0);
+	assert(json_object_memory_usage(root, &st2) == 0);
+	print_counts("compacted", &st2);
+	printf("consistent: %d\n", total_is_consistent(&st2));
+	printf("saved as estimated: %d\n", st.total_bytes - st2.total_bytes == st.compact_savings);
+	printf("nothing more to save: %d\n", st2.compact_savings == 0);
+
+	json_object_put(root);
+}
+
+static void test_special_cases(void)
+{
+	struct json_object_memory_stats st;
+	struct json_object *arr, *shared;
+	int ii;
+
+	printf("NULL: %d", json_object_memory_usage(NULL, &st));
+	printf(" total=%d\n", (int)st.total_bytes);
+
+	/* An object referenced from several places is counted once */
+	arr = json_object_new_array();
+	shared = json_object_new_string("shared");
+	for (ii = 0; ii < 5; ii++)
+		json_object_array_add(arr, json_object_get(shared));
+	json_object_array_add(arr, json_object_new_int(ii));
+	assert(json_object_memory_usage(arr, &st) == 0);
+	print_counts("shared", &st);
+	json_object_put(shared);
+	json_object_put(arr);
+
+	/* Deep nesting doesn't use the stack */
+	arr = json_object_new_array_ext(1);
+	shared = arr;
+	for (ii = 0; ii < 200000; ii++)
+	{
+		struct json_object *next = json_object_new_array_ext(1);
+		json_object_array_add(shared, next);
+		shared = next;
+	}
+	assert(json_object_memory_usage(arr, &st) == 0);
+	print_counts("deep", &st);
+	printf("consistent: %d\n", total_is_consistent(&st));
+	json_object_put(arr);
+}
+
+int main(void)
+{
+	test_document();
+	test_special_cases();
+	return 0;
+}
@@ -2,6 +2,7 @@
 #undef NDEBUG
 #endif
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +16,7 @@ static void test_basic_parse(void);
 static void test_utf8_parse(void);
 static void test_verbose_parse(void);
 static void test_incremental_parse(void);
+static void test_budget_parse(void);
 
 int main(void)
 {
@@ -29,6 +31,8 @@ int main(void)
 	puts(separator);
 	test_incremental_parse();
 	puts(separator);
+	test_budget_parse();
+	puts(separator);
 
 	return 0;
 }
@@ -111,6 +115,16 @@ static void test_basic_parse(void)
 	single_basic_parse("\"\\ud840\\u4e16\"", 0);
 	single_basic_parse("\"\\ud840\"", 0);
 	single_basic_parse("\"\\udd27\"", 0);
+	// A high surrogate followed by an escape that's not a low surrogate
+	single_basic_parse("\"\\ud840\\n\\ud840\\u0041\\ud840\\ud840\\udd1e\"", 0);
+	// A run of escapes too long to be decoded in one go
+	single_basic_parse("\"\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00"
+	                   "\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00"
+	                   "\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00"
+	                   "\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00"
+	                   "\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00"
+	                   "\\u4e16\\u754c\\ud83d\\ude00\\u4e16\\u754c\\ud83d\\ude00\"",
+	                   0);
 	// Test with a "short" high surrogate
 	single_basic_parse("[9,'\\uDAD", 0);
 	single_basic_parse("null", 0);
@@ -322,12 +336,30 @@ struct incremental_step
 	 */
     {"\"fff \\ud83d\\ude", -1, -1, json_tokener_continue, 0, 0},
     {"00 bar\"", -1, -1, json_tokener_success, 1, 0},
+    /* a run of escapes cut off in the middle of a pair */
+    {"\"\\u4e16\\u754c\\ud83d\\ude", -1, -1, json_tokener_continue, 0, 0},
+    {"00\\u00df\"", -1, -1, json_tokener_success, 1, 0},
+    {"\"\\u4e16\\u754c\\ud83d", -1, -1, json_tokener_continue, 0, 0},
+    {"\\ude00\\u00df\"", -1, -1, json_tokener_success, 1, 0},
+    {"\"\\u4e16\\u754c\\u00d", -1, -1, json_tokener_continue, 0, 0},
+    {"f\\u00dg\"", -1, 6, json_tokener_error_parse_string, 1, 0},
 
     /* Check a utf-8 char (a+umlaut) that has bytes that look negative when
        char are signed (see also control char check below) */
     {"\"\xc3\xa4\"", -1, -1, json_tokener_success, 1, 0},
     {"\"\xc3\xa4\"", -1, -1, json_tokener_success, 1, JSON_TOKENER_STRICT},
 
+    /* Duplicate keys replace, are kept, or are rejected */
+    {"{\"a\":1,\"a\":2}", -1, -1, json_tokener_success, 1, 0},
+    {"{\"a\":1,\"a\":2}", -1, -1, json_tokener_success, 1, JSON_TOKENER_UNIQUE_KEYS},
+    {"{\"a\":1,\"b\":2}", -1, -1, json_tokener_success, 1, JSON_TOKENER_REJECT_DUPLICATE_KEYS},
+    {"{\"a\":1,\"a\":2}", -1, 12, json_tokener_error_duplicate_key, 1,
+     JSON_TOKENER_REJECT_DUPLICATE_KEYS},
+    {"{\"a\":{\"b\":1},\"b\":{\"b\":2,", -1, -1, json_tokener_continue, 0,
+     JSON_TOKENER_REJECT_DUPLICATE_KEYS},
+    {"\"b\":[3]}}", -1, 7, json_tokener_error_duplicate_key, 1,
+     JSON_TOKENER_REJECT_DUPLICATE_KEYS},
+
     /* Check that json_tokener_reset actually resets */
     {"{ \"foo", -1, -1, json_tokener_continue, 1, 0},
     {": \"bar\"}", -1, 0, json_tokener_error_parse_unexpected, 1, 0},
@@ -432,6 +464,30 @@ struct incremental_step
     {"-i", 2, 2, json_tokener_continue, 0, 0},
     {"nfinity", 8, 7, json_tokener_success, 1, 0},
 
+    /* Literals and numbers split across calls carry on where they left off */
+    {"[n", -1, -1, json_tokener_continue, 0, 0},
+    {"A", -1, -1, json_tokener_continue, 0, 0},
+    {"n, NU", -1, -1, json_tokener_continue, 0, 0},
+    {"lL, fA", -1, -1, json_tokener_continue, 0, 0},
+    {"lse, T", -1, -1, json_tokener_continue, 0, 0},
+    {"rue]", -1, -1, json_tokener_success, 1, 0},
+    {"[Na", -1, -1, json_tokener_continue, 0, 0},
+    {"ll]", -1, 0, json_tokener_error_parse_null, 1, 0},
+    {"[nu", -1, -1, json_tokener_continue, 0, 0},
+    {"N]", -1, 0, json_tokener_error_parse_null, 1, 0},
+    {"[tr", -1, -1, json_tokener_continue, 0, 0},
+    {"UE]", -1, 0, json_tokener_error_parse_boolean, 1, JSON_TOKENER_STRICT},
+    {"[1.5e", -1, -1, json_tokener_continue, 0, 0},
+    {"-3, 2", -1, -1, json_tokener_continue, 0, 0},
+    {"5e", -1, -1, json_tokener_continue, 0, 0},
+    {"+", -1, -1, json_tokener_continue, 0, 0},
+    {"1]", -1, -1, json_tokener_success, 1, 0},
+    {"[12", -1, -1, json_tokener_continue, 0, 0},
+    {"-3]", -1, 0, json_tokener_error_parse_number, 1, 0},
+    {"[12-3]", -1, 3, json_tokener_error_parse_number, 1, 0},
+    {"[1e5", -1, -1, json_tokener_continue, 0, 0},
+    {"e]", -1, 0, json_tokener_error_parse_number, 1, 0},
+
     {"InfinityX", 10, 8, json_tokener_success, 0, 0},
     {"X", 1, 0, json_tokener_error_parse_unexpected, 1, 0},
 
@@ -487,6 +543,25 @@ struct incremental_step
     {"track", 6, 2, json_tokener_error_parse_boolean, 1, 0},
     {"fail", 5, 2, json_tokener_error_parse_boolean, 1, 0},
 
+    /* In strict mode "null" and "NaN" must be just so, otherwise in any case */
+    {"NaN", 4, 3, json_tokener_success, 1, JSON_TOKENER_STRICT},
+    {"null", 5, 4, json_tokener_success, 1, JSON_TOKENER_STRICT},
+    {"naN", 4, 1, json_tokener_error_parse_null, 1, JSON_TOKENER_STRICT},
+    {"nan", 4, 1, json_tokener_error_parse_null, 1, JSON_TOKENER_STRICT},
+    {"Null", 5, 1, json_tokener_error_parse_null, 1, JSON_TOKENER_STRICT},
+    {"NAN", 4, 1, json_tokener_error_parse_null, 1, JSON_TOKENER_STRICT},
+    {"naN", 4, 3, json_tokener_success, 1, 0},
+    {"nAn", 4, 3, json_tokener_success, 1, 0},
+    {"[NuLl]", 7, 6, json_tokener_success, 1, 0},
+    {"N", 1, 1, json_tokener_continue, 0, JSON_TOKENER_STRICT},
+    {"a", 1, 1, json_tokener_continue, 0, JSON_TOKENER_STRICT},
+    {"N", 2, 1, json_tokener_success, 1, JSON_TOKENER_STRICT},
+    {"n", 1, 1, json_tokener_continue, 0, JSON_TOKENER_STRICT},
+    {"a", 1, 0, json_tokener_error_parse_null, 1, JSON_TOKENER_STRICT},
+    {"n", 1, 1, json_tokener_continue, 0, 0},
+    {"A", 1, 1, json_tokener_continue, 0, 0},
+    {"n", 2, 1, json_tokener_success, 1, 0},
+
     /* Although they may initially look like they should fail,
 	 * the next few tests check that parsing multiple sequential
 	 * json objects in the input works as expected
@@ -568,9 +643,14 @@ struct incremental_step
     // utf-8 encoding
     {"\x22\xe4\xb8\x96\xe7\x95\x8c\x22", -1, -1, json_tokener_success, 1,
      JSON_TOKENER_VALIDATE_UTF8},
-    {"\x22\xe4\xb8", -1, 3, json_tokener_error_parse_utf8_string, 0, JSON_TOKENER_VALIDATE_UTF8},
-    {"\x96\xe7\x95\x8c\x22", -1, 0, json_tokener_error_parse_utf8_string, 1,
-     JSON_TOKENER_VALIDATE_UTF8},
+    // a sequence split across calls
+    {"\x22\xe4\xb8", -1, 3, json_tokener_continue, 0, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x96\xe7\x95\x8c\x22", -1, -1, json_tokener_success, 1, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xf0", -1, 2, json_tokener_continue, 0, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x9f\x98", -1, 2, json_tokener_continue, 0, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x80\x22", -1, -1, json_tokener_success, 1, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xe4", -1, 2, json_tokener_continue, 0, JSON_TOKENER_VALIDATE_UTF8},
+    {"\x41\x22", -1, 0, json_tokener_error_parse_utf8_string, 1, JSON_TOKENER_VALIDATE_UTF8},
     {"\x22\xe4\xb8\x96\xe7\x95\x8c\x22", -1, -1, json_tokener_success, 1, 0},
     {"\x22\xcf\x80\xcf\x86\x22", -1, -1, json_tokener_success, 1, JSON_TOKENER_VALIDATE_UTF8},
     {"\x22\xf0\xa5\x91\x95\x22", -1, -1, json_tokener_success, 1, JSON_TOKENER_VALIDATE_UTF8},
@@ -579,7 +659,7 @@ struct incremental_step
      JSON_TOKENER_VALIDATE_UTF8},
     {"\x22\xe6\x9d\x4e\x22", -1, 5, json_tokener_success, 1, 0},
     // GBK encoding
-    {"\x22\xc0\xee\xc5\xf4\x22", -1, 2, json_tokener_error_parse_utf8_string, 1,
+    {"\x22\xc0\xee\xc5\xf4\x22", -1, 1, json_tokener_error_parse_utf8_string, 1,
      JSON_TOKENER_VALIDATE_UTF8},
     {"\x22\xc0\xee\xc5\xf4\x22", -1, 6, json_tokener_success, 1, 0},
     // char after space
@@ -595,9 +675,9 @@ struct incremental_step
     // char in escape unicode
     {"\x22\x5c\x75\x64\x38\x35\x35\x5c\x75\x64\x63\x35\x35\x22", 15, 14, json_tokener_success, 1,
      JSON_TOKENER_VALIDATE_UTF8},
-    {"\x22\x5c\x75\x64\x38\x35\x35\xc0\x75\x64\x63\x35\x35\x22", -1, 8,
+    {"\x22\x5c\x75\x64\x38\x35\x35\xc0\x75\x64\x63\x35\x35\x22", -1, 7,
      json_tokener_error_parse_utf8_string, 1, JSON_TOKENER_VALIDATE_UTF8},
-    {"\x22\x5c\x75\x64\x30\x30\x33\x31\xc0\x22", -1, 9, json_tokener_error_parse_utf8_string, 1,
+    {"\x22\x5c\x75\x64\x30\x30\x33\x31\xc0\x22", -1, 8, json_tokener_error_parse_utf8_string, 1,
      JSON_TOKENER_VALIDATE_UTF8},
     // char in number
     {"\x31\x31\x81\x31\x31", -1, 2, json_tokener_error_parse_utf8_string, 1,
@@ -605,6 +685,27 @@ struct incremental_step
     // char in object
     {"\x7b\x22\x31\x81\x22\x3a\x31\x7d", -1, 3, json_tokener_error_parse_utf8_string, 1,
      JSON_TOKENER_VALIDATE_UTF8},
+    // overlong, a surrogate, above U+10FFFF and never valid
+    {"\x22\xc1\xbf\x22", -1, 1, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xe0\x80\xaf\x22", -1, 2, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xf0\x8f\xbf\xbf\x22", -1, 2, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xed\xa0\x80\x22", -1, 2, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xf4\x90\x80\x80\x22", -1, 2, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xf5\x80\x80\x80\x22", -1, 1, json_tokener_error_parse_utf8_string, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    {"\x22\xef\xbf\xbf\xf4\x8f\xbf\xbf\xed\x9f\xbf\x22", -1, -1, json_tokener_success, 1,
+     JSON_TOKENER_VALIDATE_UTF8},
+    // a run of escapes past the first window validated
+    {"\"\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\\u4e16\xff\"",
+     -1, 73, json_tokener_error_parse_utf8_string, 1, JSON_TOKENER_VALIDATE_UTF8},
+    // past the first window validated
+    {"\"0123456789012345678901234567890123456789012345678901234567890123456789012345\xff\"", -1,
+     77, json_tokener_error_parse_utf8_string, 1, JSON_TOKENER_VALIDATE_UTF8},
 
     // Note, current asciiz APIs can't parse \x00, skip it
     { "\"0\x01\x02\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f" \
@@ -744,3 +845,75 @@ static void test_incremental_parse(void)
 
 	printf("End Incremental Tests OK=%d ERROR=%d\n", num_ok, num_error);
 }
+
+static void budget_parse(const char *input, int len, int budget)
+{
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *obj, *expected = json_tokener_parse(input);
+	enum json_tokener_error jerr;
+	int calls = 0, over = 0, remaining = len;
+
+	assert(json_tokener_set_budget(tok, budget) == 0);
+	do
+	{
+		obj = json_tokener_parse_ex(tok, input, remaining);
+		jerr = json_tokener_get_error(tok);
+		/* A budget of 0 means no limit */
+		if (budget > 0 && json_tokener_get_parse_end(tok) > (size_t)budget)
+			over = 1;
+		input += json_tokener_get_parse_end(tok);
+		if (remaining != -1)
+			remaining -= (int)json_tokener_get_parse_end(tok);
+		calls++;
+	} while (jerr == json_tokener_continue);
+
+	printf("budget %d, length %d: %d calls, within budget: %d, same result: %d\n", budget,
+	       len, calls, !over, json_object_equal(obj, expected));
+	json_object_put(obj);
+	json_object_put(expected);
+	json_tokener_free(tok);
+}
+
+static void test_budget_parse(void)
+{
+	static const char doc[] = "{ \"foo\": [1, 2.5, -3e2, true, null], \"bar\": \"a\\u00e9b\" }";
+	struct json_tokener *tok = json_tokener_new();
+
+	errno = 0;
+	printf("negative budget fails: %d\n",
+	       json_tokener_set_budget(tok, -1) == -1 && errno == EINVAL);
+	json_tokener_free(tok);
+
+	budget_parse(doc, -1, 1);
+	budget_parse(doc, -1, 7);
+	budget_parse(doc, -1, 64);
+	budget_parse(doc, (int)strlen(doc), 1);
+	budget_parse(doc, (int)strlen(doc), 7);
+	budget_parse(doc, (int)strlen(doc), 64);
+	budget_parse(doc, -1, 0);
+
+	/*
+	 * With len == -1, no more than the budget is looked at for the nul,
+	 * so a call mustn't read past the end of a buffer that's only as big
+	 * as the budget, even without one.
+	 */
+	{
+		char *buf = malloc(4);
+		struct json_object *obj;
+
+		tok = json_tokener_new();
+		assert(json_tokener_set_budget(tok, 4) == 0);
+		memcpy(buf, "[1, ", 4);
+		obj = json_tokener_parse_ex(tok, buf, -1);
+		printf("unterminated buffer: %s after %d bytes\n",
+		       json_tokener_error_desc(json_tokener_get_error(tok)),
+		       (int)json_tokener_get_parse_end(tok));
+		obj = json_tokener_parse_ex(tok, "2]", -1);
+		printf("rest: %s\n", json_object_to_json_string(obj));
+		json_object_put(obj);
+		json_tokener_free(tok);
+		free(buf);
+	}
+
+	puts("budgeted parse OK");
+}
@@ -0,0 +1,86 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+static int print_document(struct json_object *jso, void *userdata)
+{
+	int *limit = (int *)userdata;
+
+	printf("  %s\n", json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PLAIN));
+	json_object_put(jso);
+	return limit != NULL && --*limit == 0;
+}
+
+static void parse_many(const char *name, const char *input, int len, int flags)
+{
+	struct json_tokener *tok = json_tokener_new();
+	int count;
+
+	json_tokener_set_flags(tok, flags);
+	printf("%s:\n", name);
+	count = json_tokener_parse_many(tok, input, len, print_document, NULL);
+	if (count < 0)
+		printf("  error: %s at %d\n", json_tokener_error_desc(json_tokener_get_error(tok)),
+		       (int)json_tokener_get_parse_end(tok));
+	else
+		printf("  documents: %d\n", count);
+	/* The flags are left as they were */
+	assert(tok->flags == flags);
+	json_tokener_free(tok);
+}
+
+int main(void)
+{
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *arr;
+	int limit, count;
+
+	parse_many("lines", "{\"a\":1}\n[2,3]\n\"four\"\n5\n", -1, 0);
+	parse_many("no separators", "{\"a\":1}[2]\"three\"true", -1, 0);
+	parse_many("numbers and literals", " 1 2.5 -3 null NaN false 6", -1, 0);
+	parse_many("json text sequence", "\x1e{\"a\":1}\n\x1e[2]\n\x1e"
+	                                 "3\n",
+	           -1, JSON_TOKENER_STRICT);
+	parse_many("strict", "{\"a\":1} [2] 3", -1, JSON_TOKENER_STRICT);
+	parse_many("length", "[1] [2] [3]", 7, 0);
+	parse_many("empty", "", -1, 0);
+	parse_many("whitespace", " \n\t\x1e ", -1, 0);
+	parse_many("error", "[1] [2,] [3]", -1, JSON_TOKENER_STRICT);
+	parse_many("cut off", "[1] {\"a\":", -1, 0);
+	parse_many("cut off number", "[1] 12e", -1, JSON_TOKENER_STRICT);
+	parse_many("cut off array", "[1] [1,", -1, 0);
+	parse_many("cut off string", "[1] \"abc", -1, 0);
+	parse_many("cut off literal", "[1] tru", -1, JSON_TOKENER_STRICT);
+
+	/* The callback can stop early */
+	limit = 2;
+	printf("stopped:\n");
+	count = json_tokener_parse_many(tok, "1 2 3 4", -1, print_document, &limit);
+	printf("  documents: %d\n", count);
+
+	/* Without a callback, documents are added to an array */
+	arr = json_object_new_array();
+	count = json_tokener_parse_many(tok, "{\"a\":1}\n{\"b\":2}\n{\"c\":3}\n", -1, NULL, arr);
+	printf("array: %d %s\n", count,
+	       json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PLAIN));
+	json_object_put(arr);
+
+	/* The tokener is reset first, whatever it was doing */
+	assert(json_tokener_parse_ex(tok, "[1, 2", 5) == NULL);
+	arr = json_object_new_array();
+	count = json_tokener_parse_many(tok, "[3]", -1, NULL, arr);
+	printf("after partial parse: %d %s\n", count,
+	       json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PLAIN));
+	json_object_put(arr);
+
+	json_tokener_free(tok);
+	return 0;
+}
@@ -0,0 +1,525 @@
+/*
+ * Performance regression checks, run by ctest with the "perf" label.
+ *
+ * Each scenario runs at a base size and at SCALE times that size, and
+ * counts the mallocs, reallocs, frees, bytes reallocated and hash table probes
+ * that its operation takes.  Two kinds of checks are made:
+ *  - every count has to grow at most linearly between the two sizes, which
+ *    catches quadratic behaviour in the tokener, linkhash or serializer
+ *    whatever the constant factors are
+ *  - mallocs, reallocs and frees at the base size have to stay within a
+ *    tolerance of those stored in test_perf.baseline
+ * Counts don't depend on the machine or its load, unlike timings.  With
+ * JSON_C_PERF_TIMING=1, the time each scenario takes has to grow at most
+ * linearly as well, within a factor of JSON_C_PERF_TIMING_SLACK (2 by
+ * default); that is only meaningful on a quiet machine.
+ *
+ * Usage: test_perf <baseline file>   check, printing one line per scenario
+ *        test_perf -u                print a new baseline on stdout
+ *
+ * JSON_C_PERF_TOLERANCE sets the allowed increase over the baseline, as a
+ * fraction, 0.1 by default.
+ */
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "corpus.h"
+#include "json.h"
+#include "json_alloc.h"
+#include "json_visit.h"
+
+#define SCALE 4
+/* Allowed growth of a count between the two sizes, beyond SCALE times */
+#define SCALING_SLACK 1.25
+/* Fixed costs, e.g. a tokener, don't grow with the input */
+#define SCALING_CONSTANT 64
+
+struct counts
+{
+	uint64_t mallocs;
+	uint64_t reallocs;
+	uint64_t frees;
+	uint64_t realloc_bytes;
+	uint64_t probes;
+	uint64_t ns;
+};
+
+static struct counts counting;
+static uint64_t started_ns;
+
+static void *count_malloc(size_t size)
+{
+	counting.mallocs++;
+	return malloc(size);
+}
+
+static void *count_realloc(void *ptr, size_t size)
+{
+	counting.reallocs++;
+	counting.realloc_bytes += size;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *ptr)
+{
+	if (ptr != NULL)
+		counting.frees++;
+	free(ptr);
+}
+
+static uint64_t now_ns(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* Start counting the work of an operation */
+static void begin(void)
+{
+	memset(&counting, 0, sizeof(counting));
+	started_ns = now_ns();
+}
+
+/* Stop counting, and save the counts in c */
+static void end(struct counts *c)
+{
+	uint64_t ns = now_ns() - started_ns;
+
+	*c = counting;
+	c->ns = ns;
+}
+
+/*
+ * Inputs
+ */
+
+static struct printbuf *corpus(int records, int string_share_pct, int depth)
+{
+	struct corpus_shape shape;
+	struct printbuf *pb = printbuf_new();
+
+	corpus_shape_init(&shape);
+	shape.records = records;
+	shape.string_share = string_share_pct / 100.0;
+	shape.depth = depth;
+	if (string_share_pct == 100)
+	{
+		shape.string_len = 64;
+		shape.escape_share = 0.1;
+		shape.unicode_share = 0.1;
+	}
+	assert(pb != NULL && corpus_generate(&shape, pb) == 0);
+	return pb;
+}
+
+static json_object *parse_or_die(const struct printbuf *pb)
+{
+	json_object *jso = json_tokener_parse(pb->buf);
+
+	assert(jso != NULL);
+	return jso;
+}
+
+/* An object with n members, all named differently */
+static json_object *wide_object(int n)
+{
+	json_object *jso = json_object_new_object();
+	char key[32];
+	int ii;
+
+	for (ii = 0; ii < n; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_add(jso, key, json_object_new_int(ii));
+	}
+	return jso;
+}
+
+/*
+ * Hash table probes: the slots looked at to find every key of every object,
+ * and to not find a missing one
+ */
+
+static uint64_t probe_length(struct lh_table *t, const void *key)
+{
+	unsigned long n = lh_get_hash(t, key) % t->size;
+	uint64_t probes = 1;
+
+	while (t->table[n].k != LH_EMPTY && probes < (uint64_t)t->size)
+	{
+		if (t->table[n].k != LH_FREED && t->equal_fn(t->table[n].k, key))
+			break;
+		if ((int)++n == t->size)
+			n = 0;
+		probes++;
+	}
+	return probes;
+}
+
+static int count_probes(json_object *jso, int flags, json_object *parent_jso,
+                        const char *jso_key, size_t *jso_index, void *userarg)
+{
+	struct lh_table *t;
+	struct lh_entry *ent;
+	uint64_t *probes = (uint64_t *)userarg;
+
+	if ((flags & JSON_C_VISIT_SECOND) || !json_object_is_type(jso, json_type_object))
+		return JSON_C_VISIT_RETURN_CONTINUE;
+	t = json_object_get_object(jso);
+	for (ent = t->head; ent != NULL; ent = ent->next)
+		*probes += probe_length(t, ent->k);
+	*probes += probe_length(t, "not a key");
+	return JSON_C_VISIT_RETURN_CONTINUE;
+}
+
+static uint64_t probes_of(json_object *jso)
+{
+	uint64_t probes = 0;
+
+	json_c_visit(jso, 0, count_probes, &probes);
+	return probes;
+}
+
+/*
+ * Scenarios, each run with a size factor of 1 and SCALE
+ */
+
+static void parse_corpus(int factor, int string_share_pct, int depth, struct counts *c)
+{
+	struct printbuf *pb = corpus(100 * factor, string_share_pct, depth);
+	json_tokener *tok = json_tokener_new();
+	json_object *jso;
+
+	begin();
+	jso = json_tokener_parse_ex(tok, pb->buf, printbuf_length(pb));
+	end(c);
+	assert(jso != NULL);
+	c->probes = probes_of(jso);
+	json_object_put(jso);
+	json_tokener_free(tok);
+	printbuf_free(pb);
+}
+
+static void parse_records(int factor, struct counts *c)
+{
+	parse_corpus(factor, 50, 2, c);
+}
+
+static void parse_strings(int factor, struct counts *c)
+{
+	parse_corpus(factor, 100, 2, c);
+}
+
+static void parse_numbers(int factor, struct counts *c)
+{
+	parse_corpus(factor, 0, 2, c);
+}
+
+static void parse_nested(int factor, struct counts *c)
+{
+	parse_corpus(factor, 50, 12, c);
+}
+
+static void parse_chunked(int factor, struct counts *c)
+{
+	/* Every token and every escape gets split across calls */
+	struct printbuf *pb = corpus(100 * factor, 50, 2);
+	json_tokener *tok = json_tokener_new();
+	json_object *jso = NULL;
+	int ii;
+
+	begin();
+	for (ii = 0; ii < printbuf_length(pb) && jso == NULL; ii++)
+		jso = json_tokener_parse_ex(tok, pb->buf + ii, 1);
+	end(c);
+	assert(jso != NULL);
+	json_object_put(jso);
+	json_tokener_free(tok);
+	printbuf_free(pb);
+}
+
+static void parse_long_number(int factor, struct counts *c)
+{
+	/* A single number, split into small chunks */
+	json_tokener *tok = json_tokener_new();
+	json_object *jso = NULL;
+	int ii, len = 10000 * factor;
+
+	begin();
+	for (ii = 0; ii < len; ii += 7)
+		jso = json_tokener_parse_ex(tok, "1111111", 7);
+	jso = json_tokener_parse_ex(tok, "", 1);
+	end(c);
+	assert(jso != NULL);
+	json_object_put(jso);
+	json_tokener_free(tok);
+}
+
+static void parse_wide_object(int factor, struct counts *c)
+{
+	json_object *jso = wide_object(2000 * factor);
+	const char *str = json_object_to_json_string(jso);
+	json_object *parsed;
+
+	begin();
+	parsed = json_tokener_parse(str);
+	end(c);
+	assert(parsed != NULL);
+	c->probes = probes_of(parsed);
+	json_object_put(parsed);
+	json_object_put(jso);
+}
+
+static void serialize(int factor, int flags, struct counts *c)
+{
+	struct printbuf *pb = corpus(100 * factor, 50, 2);
+	json_object *jso = parse_or_die(pb);
+
+	begin();
+	(void)json_object_to_json_string_ext(jso, flags);
+	end(c);
+	json_object_put(jso);
+	printbuf_free(pb);
+}
+
+static void serialize_plain(int factor, struct counts *c)
+{
+	serialize(factor, JSON_C_TO_STRING_PLAIN, c);
+}
+
+static void serialize_pretty(int factor, struct counts *c)
+{
+	serialize(factor, JSON_C_TO_STRING_PRETTY, c);
+}
+
+static void deep_copy(int factor, struct counts *c)
+{
+	struct printbuf *pb = corpus(100 * factor, 50, 2);
+	json_object *jso = parse_or_die(pb);
+	json_object *copy = NULL;
+
+	begin();
+	assert(json_object_deep_copy(jso, &copy, NULL) == 0);
+	end(c);
+	assert(json_object_equal(jso, copy));
+	c->probes = probes_of(copy);
+	json_object_put(copy);
+	json_object_put(jso);
+	printbuf_free(pb);
+}
+
+static void object_churn(int factor, struct counts *c)
+{
+	/* Replace every member, which leaves a tombstone for each in the table */
+	int ii, n = 2000 * factor;
+	json_object *jso = wide_object(n);
+	char key[32];
+
+	begin();
+	for (ii = 0; ii < n; ii++)
+	{
+		snprintf(key, sizeof(key), "key%d", ii);
+		json_object_object_del(jso, key);
+		snprintf(key, sizeof(key), "new%d", ii);
+		json_object_object_add(jso, key, json_object_new_int(ii));
+	}
+	end(c);
+	c->probes = probes_of(jso);
+	json_object_put(jso);
+}
+
+static void free_records(int factor, struct counts *c)
+{
+	struct printbuf *pb = corpus(100 * factor, 50, 2);
+	json_object *jso = parse_or_die(pb);
+
+	begin();
+	json_object_put(jso);
+	end(c);
+	printbuf_free(pb);
+}
+
+static const struct scenario
+{
+	const char *name;
+	void (*run)(int factor, struct counts *c);
+} scenarios[] = {
+    {"parse/records", parse_records},
+    {"parse/strings", parse_strings},
+    {"parse/numbers", parse_numbers},
+    {"parse/nested", parse_nested},
+    {"parse/chunked", parse_chunked},
+    {"parse/long_number", parse_long_number},
+    {"parse/wide_object", parse_wide_object},
+    {"serialize/plain", serialize_plain},
+    {"serialize/pretty", serialize_pretty},
+    {"copy/records", deep_copy},
+    {"object/churn", object_churn},
+    {"free/records", free_records},
+};
+#define NSCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/*
+ * Checks
+ */
+
+/* The baseline's value for a scenario's metric, or -1 if it has none */
+static long long baseline_value(FILE *fp, const char *name, const char *metric)
+{
+	char line[256], bname[128], bmetric[64];
+	long long value;
+
+	rewind(fp);
+	while (fgets(line, sizeof(line), fp) != NULL)
+	{
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%127s %63s %lld", bname, bmetric, &value) == 3 &&
+		    strcmp(bname, name) == 0 && strcmp(bmetric, metric) == 0)
+			return value;
+	}
+	return -1;
+}
+
+static int check_baseline(FILE *fp, const char *name, const char *metric, uint64_t value,
+                          double tolerance)
+{
+	long long base = baseline_value(fp, name, metric);
+
+	if (base < 0)
+	{
+		printf("%s: no baseline for %s, %llu now\n", name, metric,
+		       (unsigned long long)value);
+		return 1;
+	}
+	if (value > base * (1 + tolerance) + 2)
+	{
+		printf("%s: %s went up from %lld to %llu\n", name, metric, base,
+		       (unsigned long long)value);
+		return 1;
+	}
+	if (value < base * (1 - tolerance))
+		fprintf(stderr, "%s: %s went down from %lld to %llu, update the baseline\n", name,
+		        metric, base, (unsigned long long)value);
+	return 0;
+}
+
+static int check_scaling(const char *name, const char *metric, uint64_t small, uint64_t large,
+                         double slack)
+{
+	if (large <= small * SCALE * slack + SCALING_CONSTANT)
+		return 0;
+	printf("%s: %s grew from %llu to %llu for %d times the input\n", name, metric,
+	       (unsigned long long)small, (unsigned long long)large, SCALE);
+	return 1;
+}
+
+/* The lowest time of a few runs, to filter out some noise */
+static void run_timed(const struct scenario *sc, int factor, struct counts *c)
+{
+	struct counts run;
+	int ii;
+
+	sc->run(factor, c);
+	for (ii = 0; ii < 4; ii++)
+	{
+		sc->run(factor, &run);
+		if (run.ns < c->ns)
+			c->ns = run.ns;
+	}
+}
+
+static double env_double(const char *name, double def)
+{
+	const char *value = getenv(name);
+
+	return (value != NULL && atof(value) > 0) ? atof(value) : def;
+}
+
+int main(int argc, char **argv)
+{
+	int update = (argc == 2 && strcmp(argv[1], "-u") == 0);
+	int timing = (getenv("JSON_C_PERF_TIMING") != NULL &&
+	              strcmp(getenv("JSON_C_PERF_TIMING"), "0") != 0);
+	double tolerance = env_double("JSON_C_PERF_TOLERANCE", 0.1);
+	double timing_slack = env_double("JSON_C_PERF_TIMING_SLACK", 2);
+	FILE *fp = NULL;
+	size_t ii;
+	int failed = 0;
+
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: %s <baseline file> | -u\n", argv[0]);
+		return 1;
+	}
+	if (!update && (fp = fopen(argv[1], "r")) == NULL)
+	{
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		return 1;
+	}
+	assert(json_c_set_alloc_funcs(count_malloc, count_realloc, count_free) == 0);
+
+	if (update)
+		printf("# scenario metric count, written by test_perf -u\n");
+	for (ii = 0; ii < NSCENARIOS; ii++)
+	{
+		const struct scenario *sc = &scenarios[ii];
+		struct counts small, large;
+		int f = 0;
+
+		if (timing)
+		{
+			run_timed(sc, 1, &small);
+			run_timed(sc, SCALE, &large);
+		}
+		else
+		{
+			sc->run(1, &small);
+			sc->run(SCALE, &large);
+		}
+
+		if (update)
+		{
+			printf("%s mallocs %llu\n", sc->name, (unsigned long long)small.mallocs);
+			printf("%s reallocs %llu\n", sc->name, (unsigned long long)small.reallocs);
+			printf("%s frees %llu\n", sc->name, (unsigned long long)small.frees);
+			continue;
+		}
+
+		f |= check_scaling(sc->name, "mallocs", small.mallocs, large.mallocs,
+		                   SCALING_SLACK);
+		f |= check_scaling(sc->name, "reallocs", small.reallocs, large.reallocs,
+		                   SCALING_SLACK);
+		f |= check_scaling(sc->name, "frees", small.frees, large.frees, SCALING_SLACK);
+		f |= check_scaling(sc->name, "realloc bytes", small.realloc_bytes,
+		                   large.realloc_bytes, SCALING_SLACK);
+		f |= check_scaling(sc->name, "hash probes", small.probes, large.probes,
+		                   SCALING_SLACK);
+		if (timing)
+			f |= check_scaling(sc->name, "time", small.ns, large.ns, timing_slack);
+		f |= check_baseline(fp, sc->name, "mallocs", small.mallocs, tolerance);
+		f |= check_baseline(fp, sc->name, "reallocs", small.reallocs, tolerance);
+		f |= check_baseline(fp, sc->name, "frees", small.frees, tolerance);
+		if (!f)
+			printf("%s: ok\n", sc->name);
+		failed |= f;
+	}
+	if (fp != NULL)
+		fclose(fp);
+	return failed;
+}
@@ -0,0 +1,294 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "json_snapshot.h"
+
+static const char *input = "{ \"name\": \"snap\", \"count\": 3, \"big\": 18446744073709551615,"
+                           "  \"neg\": -42, \"pi\": 3.5, \"ok\": true, \"none\": null,"
+                           "  \"list\": [ 1, \"two\", [ false ], { \"name\": \"inner\" }, null ],"
+                           "  \"embedded\": \"a\\u0000b\", \"empty\": {}, \"zero\": [] }";
+
+static void dump(const struct json_snapshot *snap, json_snapshot_ref ref, int indent)
+{
+	size_t ii, len;
+	const char *str;
+
+	switch (json_snapshot_get_type(snap, ref))
+	{
+	case json_type_null: printf("null"); break;
+	case json_type_boolean:
+		printf("%s", json_snapshot_get_boolean(snap, ref) ? "true" : "false");
+		break;
+	case json_type_int:
+		printf("%lld/%llu", (long long)json_snapshot_get_int64(snap, ref),
+		       (unsigned long long)json_snapshot_get_uint64(snap, ref));
+		break;
+	case json_type_double: printf("%g", json_snapshot_get_double(snap, ref)); break;
+	case json_type_string:
+		str = json_snapshot_get_string(snap, ref, &len);
+		printf("\"%s\" (len=%d)", str, (int)len);
+		break;
+	case json_type_array:
+		printf("[\n");
+		for (ii = 0; ii < json_snapshot_length(snap, ref); ii++)
+		{
+			printf("%*s", indent + 2, "");
+			dump(snap, json_snapshot_array_get_idx(snap, ref, ii), indent + 2);
+			printf("\n");
+		}
+		printf("%*s]", indent, "");
+		break;
+	case json_type_object:
+		printf("{\n");
+		for (ii = 0; ii < json_snapshot_length(snap, ref); ii++)
+		{
+			const char *key = json_snapshot_object_key_at(snap, ref, ii);
+
+			printf("%*s%s: ", indent + 2, "", key);
+			dump(snap, json_snapshot_object_value_at(snap, ref, ii), indent + 2);
+			printf("\n");
+		}
+		printf("%*s}", indent, "");
+		break;
+	}
+}
+
+static void test_lookup(const struct json_snapshot *snap, const char *key)
+{
+	json_snapshot_ref ref;
+	json_bool found = json_snapshot_object_get_ex(snap, json_snapshot_root(snap), key, &ref);
+
+	printf("get_ex(%s)=%d type=%s\n", key, found,
+	       json_type_to_name(json_snapshot_get_type(snap, ref)));
+}
+
+static void test_roundtrip(void)
+{
+	struct json_object *jso = json_tokener_parse(input);
+	struct json_object *copy;
+	struct printbuf *pb = printbuf_new();
+	const struct json_snapshot *snap;
+	json_snapshot_ref list;
+	void *buf;
+	int size;
+
+	assert(jso != NULL);
+	assert(json_object_to_snapshot(jso, pb) == 0);
+	size = printbuf_length(pb);
+	printf("snapshot size is a multiple of 8: %d\n", size % 8 == 0);
+
+	/* Work on a private copy to show that the snapshot has no pointers in it */
+	buf = malloc(size);
+	memcpy(buf, pb->buf, size);
+	printbuf_free(pb);
+
+	snap = json_snapshot_open(buf, size);
+	assert(snap != NULL);
+	dump(snap, json_snapshot_root(snap), 0);
+	printf("\n");
+
+	test_lookup(snap, "name");
+	test_lookup(snap, "big");
+	test_lookup(snap, "none");
+	test_lookup(snap, "zero");
+	test_lookup(snap, "missing");
+	test_lookup(snap, "");
+
+	json_snapshot_object_get_ex(snap, json_snapshot_root(snap), "list", &list);
+	printf("list[3] type=%s\n",
+	       json_type_to_name(
+	           json_snapshot_get_type(snap, json_snapshot_array_get_idx(snap, list, 3))));
+	printf("list[99] type=%s\n",
+	       json_type_to_name(
+	           json_snapshot_get_type(snap, json_snapshot_array_get_idx(snap, list, 99))));
+	printf("get_string on an array is NULL: %d\n",
+	       json_snapshot_get_string(snap, list, NULL) == NULL);
+
+	copy = json_snapshot_to_json_object(snap, json_snapshot_root(snap));
+	printf("converted: %s\n", json_object_to_json_string(copy));
+	printf("equal to the original: %d\n", json_object_equal(jso, copy));
+	json_object_put(copy);
+
+	copy = json_snapshot_to_json_object(snap, list);
+	printf("converted list: %s\n", json_object_to_json_string(copy));
+	json_object_put(copy);
+
+	/* Anything that doesn't fit in the given size must be rejected */
+	printf("open with a short size fails: %d\n", json_snapshot_open(buf, size - 8) == NULL);
+	printf("open misaligned fails: %d\n",
+	       json_snapshot_open((char *)buf + 1, size - 1) == NULL);
+
+	free(buf);
+	json_object_put(jso);
+}
+
+static void test_scalar_root(void)
+{
+	struct json_object *jso = json_object_new_string("just a string");
+	struct printbuf *pb = printbuf_new();
+	const struct json_snapshot *snap;
+
+	assert(json_object_to_snapshot(jso, pb) == 0);
+	snap = json_snapshot_open(pb->buf, printbuf_length(pb));
+	printf("scalar root: %s\n", json_snapshot_get_string(snap, json_snapshot_root(snap), NULL));
+	json_object_put(jso);
+
+	printbuf_reset(pb);
+	assert(json_object_to_snapshot(NULL, pb) == 0);
+	snap = json_snapshot_open(pb->buf, printbuf_length(pb));
+	printf("null root: snap=%d root=%llu\n", snap != NULL,
+	       (unsigned long long)json_snapshot_root(snap));
+	printf("to_json_object of null is NULL: %d\n",
+	       json_snapshot_to_json_object(snap, json_snapshot_root(snap)) == NULL);
+
+	printf("non-empty printbuf: %d\n", json_object_to_snapshot(NULL, pb));
+	printbuf_free(pb);
+}
+
+static void test_corrupt(void)
+{
+	struct json_object *jso = json_tokener_parse("[[1,2],{\"a\":\"b\"}]");
+	struct printbuf *pb = printbuf_new();
+	int size, ii, ok = 1;
+
+	assert(json_object_to_snapshot(jso, pb) == 0);
+	size = printbuf_length(pb);
+
+	/*
+	 * Flip each byte in turn and make sure that walking the snapshot
+	 * neither crashes nor loops.
+	 */
+	for (ii = 0; ii < size; ii++)
+	{
+		char *buf = malloc(size);
+		const struct json_snapshot *snap;
+		struct json_object *copy;
+
+		memcpy(buf, pb->buf, size);
+		buf[ii] ^= 0xff;
+		snap = json_snapshot_open(buf, size);
+		copy = json_snapshot_to_json_object(snap, json_snapshot_root(snap));
+		if (copy != NULL && json_object_to_json_string(copy) == NULL)
+			ok = 0;
+		json_object_put(copy);
+		free(buf);
+	}
+	printf("corrupted snapshots handled: %d\n", ok);
+	printbuf_free(pb);
+	json_object_put(jso);
+}
+
+/* Nest depth arrays, each holding the one inside it and a 1 */
+static struct json_object *nested_arrays(int depth)
+{
+	struct json_object *jso = json_object_new_array();
+	int ii;
+
+	json_object_array_add(jso, json_object_new_int(1));
+	for (ii = 1; ii < depth; ii++)
+	{
+		struct json_object *outer = json_object_new_array();
+
+		json_object_array_add(outer, jso);
+		json_object_array_add(outer, json_object_new_int(1));
+		jso = outer;
+	}
+	return jso;
+}
+
+/*
+ * Check that jso is what nested_arrays(depth) made, without recursing,
+ * since json_object_equal() would overflow the stack on the deepest ones.
+ */
+static int is_nested_arrays(struct json_object *jso, int depth)
+{
+	for (; depth > 1; depth--)
+	{
+		if (json_object_array_length(jso) != 2 ||
+		    json_object_get_int(json_object_array_get_idx(jso, 1)) != 1)
+			return 0;
+		jso = json_object_array_get_idx(jso, 0);
+	}
+	return json_object_array_length(jso) == 1 &&
+	       json_object_get_int(json_object_array_get_idx(jso, 0)) == 1;
+}
+
+static void test_nesting(int depth)
+{
+	struct json_object *jso = nested_arrays(depth);
+	struct printbuf *pb = printbuf_new();
+	const struct json_snapshot *snap;
+	struct json_object *copy;
+
+	printf("nested %d deep: ", depth);
+	if (json_object_to_snapshot(jso, pb) != 0)
+	{
+		printf("not written\n");
+		goto out;
+	}
+	snap = json_snapshot_open(pb->buf, printbuf_length(pb));
+	errno = 0;
+	copy = json_snapshot_to_json_object(snap, json_snapshot_root(snap));
+	printf("%s\n", copy != NULL ? (is_nested_arrays(copy, depth) ? "equal" : "different")
+	                            : (errno == EINVAL ? "EINVAL" : "failed"));
+	json_object_put(copy);
+out:
+	printbuf_free(pb);
+	json_object_put(jso);
+}
+
+static void test_shared_children(void)
+{
+	struct json_object *jso = nested_arrays(24);
+	struct printbuf *pb = printbuf_new();
+	const struct json_snapshot *snap;
+	json_snapshot_ref ref, inner, one;
+	struct json_object *copy;
+
+	assert(json_object_to_snapshot(jso, pb) == 0);
+	snap = json_snapshot_open(pb->buf, printbuf_length(pb));
+
+	/*
+	 * Point the second element of each array at its first, the array
+	 * inside it, so that converting it would produce 2^24 arrays.
+	 */
+	for (ref = json_snapshot_root(snap); json_snapshot_length(snap, ref) == 2; ref = inner)
+	{
+		uint64_t *slot;
+
+		inner = json_snapshot_array_get_idx(snap, ref, 0);
+		one = json_snapshot_array_get_idx(snap, ref, 1);
+		for (slot = (uint64_t *)(pb->buf + ref); *slot != one; slot++)
+			;
+		*slot = inner;
+	}
+	assert(json_snapshot_array_get_idx(snap, json_snapshot_root(snap), 1) ==
+	       json_snapshot_array_get_idx(snap, json_snapshot_root(snap), 0));
+
+	errno = 0;
+	copy = json_snapshot_to_json_object(snap, json_snapshot_root(snap));
+	printf("shared children: %s\n", copy == NULL && errno == EINVAL ? "EINVAL" : "converted");
+	json_object_put(copy);
+	printbuf_free(pb);
+	json_object_put(jso);
+}
+
+int main(void)
+{
+	test_roundtrip();
+	test_scalar_root();
+	test_corrupt();
+	test_nesting(JSON_TOKENER_DEFAULT_DEPTH);
+	test_nesting(JSON_TOKENER_DEFAULT_DEPTH + 1);
+	test_nesting(200000);
+	test_shared_children();
+	return 0;
+}
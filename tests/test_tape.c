@@ -0,0 +1,247 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+#include "json_tape.h"
+
+static const char *input =
+    "{ \"name\": \"tape\", \"count\": 3, \"big\": 18446744073709551615,"
+    "  \"neg\": -42, \"pi\": 3.50, \"exp\": -1e3, \"ok\": true, \"no\": false, \"none\": null,"
+    "  \"list\": [ 1, \"two\", [ false ], { \"name\": \"inner\" }, null ],"
+    "  \"esc\": \"a\\u0000b\\n\\u00e9\\u4e16\\ud83d\\ude00\\ud800x\\\"\","
+    "  \"empty\": {}, \"zero\": [], \"dup\": 1, \"dup\": 2 }";
+
+static void dump(const struct json_tape *tape, json_tape_ref ref, int indent)
+{
+	json_tape_ref it;
+	const char *str;
+	size_t len, ii;
+
+	switch (json_tape_get_type(tape, ref))
+	{
+	case json_type_null: printf("null"); break;
+	case json_type_boolean:
+		printf("%s", json_tape_get_boolean(tape, ref) ? "true" : "false");
+		break;
+	case json_type_int:
+		printf("%lld/%llu", (long long)json_tape_get_int64(tape, ref),
+		       (unsigned long long)json_tape_get_uint64(tape, ref));
+		break;
+	case json_type_double: printf("%g", json_tape_get_double(tape, ref)); break;
+	case json_type_string:
+		str = json_tape_get_string(tape, ref, &len);
+		printf("\"");
+		for (ii = 0; ii < len; ii++)
+		{
+			if ((unsigned char)str[ii] < 0x20 || (unsigned char)str[ii] >= 0x7f)
+				printf("\\x%02x", (unsigned char)str[ii]);
+			else
+				printf("%c", str[ii]);
+		}
+		printf("\" (len=%d)", (int)len);
+		break;
+	case json_type_array:
+		printf("[ (length=%d)\n", (int)json_tape_length(tape, ref));
+		for (it = json_tape_first(tape, ref); it != JSON_TAPE_REF_NONE;
+		     it = json_tape_next(tape, it))
+		{
+			printf("%*s", indent + 2, "");
+			dump(tape, it, indent + 2);
+			printf("\n");
+		}
+		printf("%*s]", indent, "");
+		break;
+	case json_type_object:
+		printf("{ (length=%d)\n", (int)json_tape_length(tape, ref));
+		for (it = json_tape_first(tape, ref); it != JSON_TAPE_REF_NONE;
+		     it = json_tape_next(tape, it))
+		{
+			printf("%*s%s: ", indent + 2, "", json_tape_get_string(tape, it, NULL));
+			dump(tape, json_tape_member_value(tape, it), indent + 2);
+			printf("\n");
+		}
+		printf("%*s}", indent, "");
+		break;
+	}
+}
+
+static void test_lookup(const struct json_tape *tape, const char *key)
+{
+	json_tape_ref ref;
+	json_bool found = json_tape_object_get_ex(tape, json_tape_root(tape), key, &ref);
+
+	printf("get_ex(%s)=%d type=%s\n", key, found,
+	       json_type_to_name(json_tape_get_type(tape, ref)));
+}
+
+static void test_document(void)
+{
+	enum json_tokener_error err;
+	struct json_tape *tape = json_tape_parse(input, strlen(input), 0, &err);
+	struct json_object *jso, *expected;
+	json_tape_ref list;
+
+	printf("parse: %s\n", json_tokener_error_desc(err));
+	assert(tape != NULL);
+	dump(tape, json_tape_root(tape), 0);
+	printf("\n");
+
+	test_lookup(tape, "name");
+	test_lookup(tape, "none");
+	test_lookup(tape, "zero");
+	test_lookup(tape, "missing");
+
+	json_tape_object_get_ex(tape, json_tape_root(tape), "list", &list);
+	printf("list[3] type=%s\n",
+	       json_type_to_name(json_tape_get_type(tape, json_tape_array_get_idx(tape, list, 3))));
+	printf("list[5] type=%s\n",
+	       json_type_to_name(json_tape_get_type(tape, json_tape_array_get_idx(tape, list, 5))));
+	printf("list[-1] is none: %d\n",
+	       json_tape_array_get_idx(tape, list, (size_t)-1) == JSON_TAPE_REF_NONE);
+	printf("get_string on an array is NULL: %d\n",
+	       json_tape_get_string(tape, list, NULL) == NULL);
+	printf("member_value of an array is none: %d\n",
+	       json_tape_member_value(tape, list) == JSON_TAPE_REF_NONE);
+
+	jso = json_tape_to_json_object(tape, json_tape_root(tape));
+	printf("converted: %s\n", json_object_to_json_string(jso));
+	expected = json_tokener_parse(input);
+	printf("equal to json_tokener_parse(): %d\n", json_object_equal(jso, expected));
+	json_object_put(expected);
+	json_object_put(jso);
+
+	json_tape_free(tape);
+}
+
+static void test_scalars(void)
+{
+	static const char *docs[] = {
+	    "0", "  -0  ", "123", "-9223372036854775809", "1.5e300", "\"\"", "true", "null",
+	};
+	size_t ii;
+
+	for (ii = 0; ii < sizeof(docs) / sizeof(docs[0]); ii++)
+	{
+		struct json_tape *tape = json_tape_parse(docs[ii], strlen(docs[ii]), 0, NULL);
+		struct json_object *jso;
+
+		assert(tape != NULL);
+		jso = json_tape_to_json_object(tape, json_tape_root(tape));
+		printf("%s => %s %s\n", docs[ii],
+		       json_type_to_name(json_tape_get_type(tape, json_tape_root(tape))),
+		       json_object_to_json_string(jso));
+		json_object_put(jso);
+		json_tape_free(tape);
+	}
+}
+
+static void test_errors(void)
+{
+	static const char *docs[] = {
+	    "",          "   ",      "[1,2",      "[1,2,]",      "{\"a\" 1}",     "{\"a\":1,}",
+	    "{1:2}",     "[1 2]",    "{\"a\":1 \"b\":2}", "tru",  "trux",         "nul",
+	    "01",        "1.",       "-",         "1e",          "\"abc",         "\"a\\x\"",
+	    "\"\\u12\"", "\"a\tb\"", "[1] x",     "NaN",         "'single'",      "/* c */ 1",
+	    "\"ab\\",    "[\"\\\"",
+	};
+	size_t ii;
+
+	for (ii = 0; ii < sizeof(docs) / sizeof(docs[0]); ii++)
+	{
+		enum json_tokener_error err;
+		struct json_tape *tape = json_tape_parse(docs[ii], strlen(docs[ii]), 0, &err);
+
+		printf("%-20s => %s\n", docs[ii], json_tokener_error_desc(err));
+		assert(tape == NULL);
+	}
+}
+
+static void test_depth(void)
+{
+	char buf[64];
+	enum json_tokener_error err;
+	struct json_tape *tape;
+
+	memset(buf, '[', 10);
+	memset(buf + 10, ']', 10);
+	tape = json_tape_parse(buf, 20, 10, &err);
+	printf("depth 10 at limit 10: %s\n", json_tokener_error_desc(err));
+	json_tape_free(tape);
+	tape = json_tape_parse(buf, 20, 9, &err);
+	printf("depth 10 at limit 9: %s\n", json_tokener_error_desc(err));
+	json_tape_free(tape);
+}
+
+/* Converting a deeply nested tape mustn't use the stack for each level */
+static void test_deep_conversion(void)
+{
+	const int depth = 100000;
+	struct printbuf *pb = printbuf_new();
+	enum json_tokener_error err;
+	struct json_object *jso, *it;
+	struct json_tape *tape;
+	int ii, levels = 0;
+
+	for (ii = 0; ii < depth; ii++)
+		printbuf_memappend(pb, (ii % 2) ? "{\"k\":" : "[1,", (ii % 2) ? 5 : 3);
+	printbuf_strappend(pb, "\"bottom\"");
+	for (ii = depth - 1; ii >= 0; ii--)
+		printbuf_memappend(pb, (ii % 2) ? "}" : "]", 1);
+	tape = json_tape_parse(pb->buf, printbuf_length(pb), depth, &err);
+	printf("deep tape: %s\n", json_tokener_error_desc(err));
+	jso = json_tape_to_json_object(tape, json_tape_root(tape));
+	for (it = jso; json_object_is_type(it, json_type_array) ||
+	               json_object_is_type(it, json_type_object);
+	     levels++)
+	{
+		if (json_object_is_type(it, json_type_array))
+			it = json_object_array_get_idx(it, 1);
+		else
+			it = json_object_object_get(it, "k");
+	}
+	printf("deep conversion: %d levels, then %s\n", levels, json_object_get_string(it));
+	json_object_put(jso);
+	json_tape_free(tape);
+	printbuf_free(pb);
+}
+
+static void test_large(void)
+{
+	/* Grow the tape and string buffer well past their initial estimates */
+	struct printbuf *pb = printbuf_new();
+	struct json_tape *tape;
+	json_tape_ref ref;
+	int ii;
+
+	printbuf_strappend(pb, "[");
+	for (ii = 0; ii < 10000; ii++)
+		sprintbuf(pb, "%s[%d,\"\\u00e9%d\"]", ii ? "," : "", ii, ii);
+	printbuf_strappend(pb, "]");
+
+	tape = json_tape_parse(pb->buf, printbuf_length(pb), 0, NULL);
+	assert(tape != NULL);
+	printf("large length: %d\n", (int)json_tape_length(tape, json_tape_root(tape)));
+	ref = json_tape_array_get_idx(tape, json_tape_root(tape), 9999);
+	printf("large[9999][0]: %lld\n",
+	       (long long)json_tape_get_int64(tape, json_tape_array_get_idx(tape, ref, 0)));
+	printf("large[9999][1]: %s\n",
+	       json_tape_get_string(tape, json_tape_array_get_idx(tape, ref, 1), NULL));
+	json_tape_free(tape);
+	printbuf_free(pb);
+}
+
+int main(void)
+{
+	test_document();
+	test_scalars();
+	test_errors();
+	test_depth();
+	test_deep_conversion();
+	test_large();
+	return 0;
+}
@@ -0,0 +1,150 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+static void parse_limited(const char *name, const char *input,
+                          const struct json_tokener_limits *limits)
+{
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *jso;
+
+	assert(json_tokener_set_limits(tok, limits) == 0);
+	jso = json_tokener_parse_ex(tok, input, -1);
+	if (jso != NULL || json_tokener_get_error(tok) == json_tokener_success)
+		printf("%s: ok: %s\n", name,
+		       json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PLAIN));
+	else
+		printf("%s: %s at %d\n", name, json_tokener_error_desc(json_tokener_get_error(tok)),
+		       (int)json_tokener_get_parse_end(tok));
+	json_object_put(jso);
+	json_tokener_free(tok);
+}
+
+int main(void)
+{
+	struct json_tokener_limits limits;
+	struct json_tokener *tok;
+	struct json_object *jso;
+	char *bomb;
+	int ii;
+
+	memset(&limits, 0, sizeof(limits));
+	parse_limited("no limits", "{\"a\":[1,2,3],\"b\":\"xyz\"}", &limits);
+
+	limits.max_nodes = 4;
+	parse_limited("nodes at limit", "[1,null,3]", &limits);
+	parse_limited("nodes over limit", "[1,null,3,4]", &limits);
+	parse_limited("nodes in objects", "{\"a\":{\"b\":{\"c\":{}}}}", &limits);
+	memset(&limits, 0, sizeof(limits));
+
+	limits.max_array_len = 3;
+	parse_limited("array at limit", "[[1,2,3],[4,5,6]]", &limits);
+	parse_limited("array over limit", "[[1,2,3],[4,5,6,7]]", &limits);
+	memset(&limits, 0, sizeof(limits));
+
+	limits.max_object_members = 2;
+	parse_limited("members at limit", "{\"a\":1,\"b\":{\"c\":2,\"d\":3}}", &limits);
+	parse_limited("members over limit", "{\"a\":1,\"b\":2,\"c\":3}", &limits);
+	/* A duplicate key replaces a member rather than adding one */
+	parse_limited("duplicate keys", "{\"a\":1,\"b\":2,\"a\":3}", &limits);
+	memset(&limits, 0, sizeof(limits));
+
+	limits.max_string_len = 5;
+	parse_limited("string at limit", "[\"abcde\"]", &limits);
+	parse_limited("string over limit", "[\"abcdef\"]", &limits);
+	parse_limited("escaped string at limit", "\"a\\u00e9\\n\\t\"", &limits);
+	parse_limited("key over limit", "{\"abcdef\":1}", &limits);
+	memset(&limits, 0, sizeof(limits));
+
+	limits.max_bytes = 4096;
+	parse_limited("bytes within limit", "{\"a\":[1,2.5,true,null,\"x\"]}", &limits);
+
+	/* Lots of empty arrays take up far more memory than input */
+	bomb = (char *)malloc(2 + 3 * 10000);
+	assert(bomb != NULL);
+	bomb[0] = '[';
+	for (ii = 0; ii < 10000; ii++)
+		memcpy(bomb + 1 + 3 * ii, "[],", 3);
+	bomb[3 * 10000] = ']';
+	bomb[3 * 10000 + 1] = '\0';
+	tok = json_tokener_new();
+	assert(json_tokener_set_limits(tok, &limits) == 0);
+	jso = json_tokener_parse_ex(tok, bomb, -1);
+	printf("bomb: %s, stopped early: %d\n",
+	       json_tokener_error_desc(json_tokener_get_error(tok)),
+	       jso == NULL && json_tokener_get_parse_end(tok) < 3 * 10000 / 10);
+	json_tokener_free(tok);
+	free(bomb);
+
+	/* A string that's split across calls is checked as it goes */
+	memset(&limits, 0, sizeof(limits));
+	limits.max_string_len = 8;
+	tok = json_tokener_new();
+	assert(json_tokener_set_limits(tok, &limits) == 0);
+	assert(json_tokener_parse_ex(tok, "\"abcd", 5) == NULL);
+	printf("split string: %s\n", json_tokener_error_desc(json_tokener_get_error(tok)));
+	assert(json_tokener_parse_ex(tok, "efgh", 4) == NULL);
+	printf("split string: %s\n", json_tokener_error_desc(json_tokener_get_error(tok)));
+	assert(json_tokener_parse_ex(tok, "ijkl", 4) == NULL);
+	printf("split string: %s\n", json_tokener_error_desc(json_tokener_get_error(tok)));
+
+	/*
+	 * A long string is rejected before it's copied, so the tokener's
+	 * buffer never has to grow for it, whether or not it has escapes
+	 */
+	json_tokener_reset(tok);
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	bomb = (char *)malloc(100003);
+	assert(bomb != NULL);
+	bomb[0] = '"';
+	memset(bomb + 1, 'x', 100000);
+	strcpy(bomb + 100001, "\"");
+	assert(json_tokener_parse_ex(tok, bomb, -1) == NULL);
+	printf("long string: %s, buffer grew: %d\n",
+	       json_tokener_error_desc(json_tokener_get_error(tok)),
+	       json_tokener_get_stats(tok)->printbuf_grows > 0);
+	json_tokener_reset(tok);
+	for (ii = 1; ii < 100001; ii += 2)
+		memcpy(bomb + ii, "\\n", 2);
+	assert(json_tokener_parse_ex(tok, bomb, -1) == NULL);
+	printf("escaped string: %s, buffer grew: %d\n",
+	       json_tokener_error_desc(json_tokener_get_error(tok)),
+	       json_tokener_get_stats(tok)->printbuf_grows > 0);
+	free(bomb);
+	assert(json_tokener_enable_stats(tok, 0) == 0);
+
+	/* Limits apply to each document, and can be changed or removed */
+	json_tokener_reset(tok);
+	memset(&limits, 0, sizeof(limits));
+	limits.max_nodes = 3;
+	assert(json_tokener_set_limits(tok, &limits) == 0);
+	for (ii = 0; ii < 3; ii++)
+	{
+		jso = json_tokener_parse_ex(tok, "[1,2] ", 6);
+		printf("document %d: %s\n", ii,
+		       json_tokener_error_desc(json_tokener_get_error(tok)));
+		json_object_put(jso);
+	}
+	jso = json_object_new_array();
+	ii = json_tokener_parse_many(tok, "[1,2] [3,4] [5,6,7] [8]", -1, NULL, jso);
+	printf("parse_many: %d %s, %s\n", ii,
+	       json_object_to_json_string_ext(jso, JSON_C_TO_STRING_PLAIN),
+	       json_tokener_error_desc(json_tokener_get_error(tok)));
+	json_object_put(jso);
+	assert(json_tokener_set_limits(tok, NULL) == 0);
+	json_tokener_reset(tok);
+	jso = json_tokener_parse_ex(tok, "[1,2,3,4,5]", 11);
+	printf("removed: %s\n", json_tokener_error_desc(json_tokener_get_error(tok)));
+	json_object_put(jso);
+	json_tokener_free(tok);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include "config.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+static void print_stats(const char *name, const struct json_tokener_stats *stats)
+{
+	uint64_t total_ns = 0;
+	int ii;
+
+	printf("%s:\n", name);
+	printf("  bytes: %d\n", (int)stats->bytes);
+	printf("  values:");
+	for (ii = json_type_null; ii <= json_type_string; ii++)
+		printf(" %s=%d", json_type_to_name((enum json_type)ii), (int)stats->values[ii]);
+	printf("\n");
+	printf("  strings: clean=%d escaped=%d keys=%d\n", (int)stats->strings_clean,
+	       (int)stats->strings_escaped, (int)stats->keys);
+	printf("  max_depth: %d\n", stats->max_depth);
+	printf("  printbuf_grows>0: %d\n", stats->printbuf_grows > 0);
+	printf("  allocs covers the rest: %d\n",
+	       stats->allocs >= stats->keys + stats->printbuf_grows + stats->container_resizes);
+
+	for (ii = 0; ii <= json_tokener_state_inf; ii++)
+		total_ns += stats->state_ns[ii];
+#ifdef ENABLE_TOKENER_PROFILE
+	printf("  state times: %s\n", total_ns > 0 ? "ok" : "missing");
+#else
+	printf("  state times: %s\n", total_ns == 0 ? "ok" : "unexpected");
+#endif
+}
+
+static void test_document(void)
+{
+	static const char *input =
+	    "{ \"name\": \"stats\", \"esc\": \"a\\nb\", \"k\\u00e9y\": [ 1, -2, 3.5, true, null ],"
+	    "  \"nested\": { \"deeper\": [ [ [] ] ] }, \"big\": 18446744073709551615 }";
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *jso;
+
+	printf("disabled: %d\n", json_tokener_get_stats(tok) == NULL);
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+
+	jso = json_tokener_parse_ex(tok, input, strlen(input));
+	assert(jso != NULL);
+	print_stats("document", json_tokener_get_stats(tok));
+	printf("  bytes match the input: %d\n",
+	       json_tokener_get_stats(tok)->bytes == strlen(input));
+	json_object_put(jso);
+
+	/* Counters accumulate, until stats are enabled again */
+	jso = json_tokener_parse_ex(tok, "[\"x\"]", 5);
+	json_object_put(jso);
+	printf("accumulated: strings=%d arrays=%d\n",
+	       (int)json_tokener_get_stats(tok)->values[json_type_string],
+	       (int)json_tokener_get_stats(tok)->values[json_type_array]);
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	printf("cleared: %d\n", json_tokener_get_stats(tok)->bytes == 0);
+
+	assert(json_tokener_enable_stats(tok, 0) == 0);
+	printf("disabled again: %d\n", json_tokener_get_stats(tok) == NULL);
+	json_tokener_free(tok);
+}
+
+static void test_chunks(void)
+{
+	/* Feed the input one byte at a time, to cross every state boundary */
+	static const char *input = "[ \"\\u4e16\\u754c\", { \"a\": 1e3 }, 12345678901234 ]";
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *jso = NULL;
+	size_t ii;
+
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	for (ii = 0; ii < strlen(input) && jso == NULL; ii++)
+		jso = json_tokener_parse_ex(tok, input + ii, 1);
+	assert(jso != NULL);
+	print_stats("chunks", json_tokener_get_stats(tok));
+	json_object_put(jso);
+	json_tokener_free(tok);
+}
+
+static void test_growth(void)
+{
+	/* Big containers and long strings must be counted as resizes and growths */
+	struct printbuf *pb = printbuf_new();
+	struct json_tokener *tok = json_tokener_new();
+	struct json_object *jso;
+	int ii;
+
+	printbuf_strappend(pb, "[");
+	for (ii = 0; ii < 100; ii++)
+		sprintbuf(pb, "%s{\"key%d\": \"%0*d\"}", ii ? "," : "", ii, ii * 10, ii);
+	printbuf_strappend(pb, "]");
+
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	jso = json_tokener_parse_ex(tok, pb->buf, printbuf_length(pb));
+	assert(jso != NULL);
+	printf("growth: objects=%d strings=%d container_resizes>0: %d printbuf_grows>0: %d\n",
+	       (int)json_tokener_get_stats(tok)->values[json_type_object],
+	       (int)json_tokener_get_stats(tok)->values[json_type_string],
+	       json_tokener_get_stats(tok)->container_resizes > 0,
+	       json_tokener_get_stats(tok)->printbuf_grows > 0);
+	json_object_put(jso);
+	json_tokener_free(tok);
+	printbuf_free(pb);
+}
+
+static void test_nulls(void)
+{
+	struct json_tokener *tok = json_tokener_new();
+	const struct json_tokener_stats *stats;
+
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	json_object_put(json_tokener_parse_ex(tok, "[null,null,null]", 16));
+	stats = json_tokener_get_stats(tok);
+	/* Only the array itself is allocated */
+	printf("nulls: null=%d allocs=%d\n", (int)stats->values[json_type_null],
+	       (int)(stats->allocs - stats->printbuf_grows - stats->container_resizes));
+	json_tokener_free(tok);
+}
+
+static void test_error(void)
+{
+	struct json_tokener *tok = json_tokener_new_ex(3);
+
+	assert(json_tokener_enable_stats(tok, 1) == 0);
+	assert(json_tokener_parse_ex(tok, "[[[1]]]", 7) == NULL);
+	printf("too deep: %s, bytes=%d max_depth=%d\n",
+	       json_tokener_error_desc(json_tokener_get_error(tok)),
+	       (int)json_tokener_get_stats(tok)->bytes, json_tokener_get_stats(tok)->max_depth);
+	json_tokener_reset(tok);
+	json_object_put(json_tokener_parse_ex(tok, "[[1]]", 5));
+	printf("after reset: max_depth=%d\n", json_tokener_get_stats(tok)->max_depth);
+	json_tokener_free(tok);
+}
+
+int main(void)
+{
+	test_document();
+	test_chunks();
+	test_growth();
+	test_nulls();
+	test_error();
+	return 0;
+}